@@ -0,0 +1,64 @@
+#include "miniaudio.h"
+#include "AssetCache.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+namespace AssetCache {
+
+bool GetFileStamp(const std::string& filePath, FileStamp& stamp) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (_stat64(filePath.c_str(), &info) != 0) return false;
+#else
+    struct stat info;
+    if (stat(filePath.c_str(), &info) != 0) return false;
+#endif
+
+    stamp.size = static_cast<ma_uint64>(info.st_size);
+    stamp.modifiedTime = static_cast<ma_int64>(info.st_mtime);
+    return true;
+}
+
+std::string GetCachePath(const std::string& cacheDirectory, const std::string& filePath, const char* extension) {
+    // One flat directory; "ASSETS/SOUND/rain.wav" becomes "ASSETS_SOUND_rain.wav"
+    std::string name = filePath;
+    for (char& c : name) {
+        if (c == '/' || c == '\\' || c == ':') c = '_';
+    }
+
+    if (cacheDirectory.empty()) {
+        return name + extension;
+    }
+    return cacheDirectory + "/" + name + extension;
+}
+
+bool CreateDirectories(const std::string& directory) {
+    if (directory.empty()) return true;
+
+    for (size_t i = 1; i <= directory.size(); i++) {
+        if (i < directory.size() && directory[i] != '/' && directory[i] != '\\') continue;
+
+        // Fails harmlessly for parts that already exist
+        const std::string part = directory.substr(0, i);
+#ifdef _WIN32
+        _mkdir(part.c_str());
+#else
+        mkdir(part.c_str(), 0755);
+#endif
+    }
+
+#ifdef _WIN32
+    struct _stat64 info;
+    return _stat64(directory.c_str(), &info) == 0 && (info.st_mode & _S_IFDIR) != 0;
+#else
+    struct stat info;
+    return stat(directory.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+}
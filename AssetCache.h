@@ -0,0 +1,34 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <string>
+
+// Files derived from source assets (loudness measurements, imports) live in a
+// cache directory rather than next to the sources, so asset folders stay clean and
+// read-only installs still work. A source is identified by its size and
+// modification time, which is a stat rather than a read of the whole file.
+namespace AssetCache {
+
+struct FileStamp {
+    ma_uint64 size = 0;
+    ma_int64 modifiedTime = 0;     // Seconds since the epoch
+
+    bool operator==(const FileStamp& other) const {
+        return size == other.size && modifiedTime == other.modifiedTime;
+    }
+    bool operator!=(const FileStamp& other) const {
+        return !(*this == other);
+    }
+};
+
+// False if the file doesn't exist
+bool GetFileStamp(const std::string& filePath, FileStamp& stamp);
+
+// cacheDirectory/<filePath with separators flattened><extension>
+std::string GetCachePath(const std::string& cacheDirectory, const std::string& filePath, const char* extension);
+
+// Creates the directory and any missing parents; true if it exists afterwards
+bool CreateDirectories(const std::string& directory);
+
+}
@@ -0,0 +1,227 @@
+#include "miniaudio.h"
+#include "AssetImporter.h"
+#include "AssetCache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+// Written in host byte order; imports are built on the machine (or platform family)
+// that plays them
+struct ImportedHeader {
+    char magic[4];
+    ma_uint32 version;
+    ma_uint64 sourceSize;
+    ma_int64 sourceModifiedTime;
+    ma_uint32 channels;
+    ma_uint32 sampleRate;
+    ma_uint64 frameCount;
+};
+
+static const char g_importMagic[4] = { 'M', 'A', 'P', 'C' };
+static const ma_uint32 g_importVersion = 2;
+static const ma_uint32 g_importChunkFrames = 4096;
+
+static bool ReadHeader(std::ifstream& file, ImportedHeader& header) {
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    return file.gcount() == sizeof(header)
+        && std::memcmp(header.magic, g_importMagic, sizeof(g_importMagic)) == 0
+        && header.version == g_importVersion
+        && header.channels > 0;
+}
+
+static bool IsSourceAsset(const std::string& filePath) {
+    const size_t dot = filePath.find_last_of('.');
+    if (dot == std::string::npos) return false;
+
+    std::string extension = filePath.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == "wav" || extension == "mp3" || extension == "flac" || extension == "ogg";
+}
+
+static void FindSourceAssets(const std::string& directory, std::vector<std::string>& files) {
+#ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+    if (find == INVALID_HANDLE_VALUE) return;
+
+    do {
+        const std::string name = entry.cFileName;
+        if (name == "." || name == "..") continue;
+
+        const std::string path = directory + "/" + name;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            FindSourceAssets(path, files);
+        }
+        else if (IsSourceAsset(path)) {
+            files.push_back(path);
+        }
+    } while (FindNextFileA(find, &entry));
+    FindClose(find);
+#else
+    DIR* dir = opendir(directory.c_str());
+    if (!dir) return;
+
+    while (dirent* entry = readdir(dir)) {
+        const std::string name = entry->d_name;
+        if (name == "." || name == "..") continue;
+
+        const std::string path = directory + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0) continue;
+
+        if (S_ISDIR(info.st_mode)) {
+            FindSourceAssets(path, files);
+        }
+        else if (IsSourceAsset(path)) {
+            files.push_back(path);
+        }
+    }
+    closedir(dir);
+#endif
+}
+
+AssetImporter::AssetImporter(const std::string& cacheDirectory, ma_uint32 sampleRate)
+    : cacheDirectory(cacheDirectory)
+    , sampleRate(sampleRate)
+{
+}
+
+std::string AssetImporter::GetImportedPath(const std::string& cacheDirectory, const std::string& filePath) {
+    return AssetCache::GetCachePath(cacheDirectory, filePath, ".pcm");
+}
+
+AssetImporter::Result AssetImporter::Import(const std::string& filePath) {
+    AssetCache::FileStamp stamp;
+    if (sampleRate == 0 || !AssetCache::GetFileStamp(filePath, stamp) || !AssetCache::CreateDirectories(cacheDirectory)) {
+        return Result::Failed;
+    }
+
+    const std::string importedPath = GetImportedPath(cacheDirectory, filePath);
+    {
+        std::ifstream existing(importedPath, std::ios::binary);
+        ImportedHeader header;
+        if (existing && ReadHeader(existing, header) && header.sourceSize == stamp.size
+            && header.sourceModifiedTime == stamp.modifiedTime && header.sampleRate == sampleRate) {
+            return Result::UpToDate;
+        }
+    }
+
+    // Offline, so use the steepest anti-aliasing filter the decoder offers
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, sampleRate);
+    config.resampling.linear.lpfOrder = MA_MAX_FILTER_ORDER;
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filePath.c_str(), &config, &decoder) != MA_SUCCESS) {
+        return Result::Failed;
+    }
+
+    ImportedHeader header;
+    std::memcpy(header.magic, g_importMagic, sizeof(g_importMagic));
+    header.version = g_importVersion;
+    header.sourceSize = stamp.size;
+    header.sourceModifiedTime = stamp.modifiedTime;
+    header.channels = decoder.outputChannels;
+    header.sampleRate = sampleRate;
+    header.frameCount = 0;
+
+    // Written to a temporary file and renamed, so an interrupted import never looks current
+    const std::string tempPath = importedPath + ".tmp";
+    std::ofstream output(tempPath, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        ma_decoder_uninit(&decoder);
+        return Result::Failed;
+    }
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<float> buffer(static_cast<size_t>(g_importChunkFrames) * header.channels);
+    for (;;) {
+        ma_uint64 framesRead = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, buffer.data(), g_importChunkFrames, &framesRead);
+        output.write(reinterpret_cast<const char*>(buffer.data()), sizeof(float) * framesRead * header.channels);
+        header.frameCount += framesRead;
+        if (result != MA_SUCCESS || framesRead == 0) break;
+    }
+    ma_decoder_uninit(&decoder);
+
+    output.seekp(0);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.close();
+    if (!output) {
+        std::remove(tempPath.c_str());
+        return Result::Failed;
+    }
+
+    std::remove(importedPath.c_str());
+    if (std::rename(tempPath.c_str(), importedPath.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return Result::Failed;
+    }
+    return Result::Converted;
+}
+
+AssetImporter::Report AssetImporter::ImportDirectory(const std::string& directory) {
+    std::vector<std::string> files;
+    FindSourceAssets(directory, files);
+    std::sort(files.begin(), files.end());
+
+    Report report;
+    for (const auto& filePath : files) {
+        switch (Import(filePath)) {
+        case Result::Converted:
+            report.converted++;
+            break;
+        case Result::UpToDate:
+            report.upToDate++;
+            break;
+        case Result::Failed:
+            report.failed++;
+            break;
+        }
+    }
+    return report;
+}
+
+bool AssetImporter::LoadImported(const std::string& cacheDirectory, const std::string& filePath, ma_uint32 sampleRate,
+    std::vector<float>& frames, ma_uint32& channels) {
+    std::ifstream file(GetImportedPath(cacheDirectory, filePath), std::ios::binary);
+    ImportedHeader header;
+    if (sampleRate == 0 || !file || !ReadHeader(file, header) || header.sampleRate != sampleRate) {
+        return false;
+    }
+
+    AssetCache::FileStamp stamp;
+    if (AssetCache::GetFileStamp(filePath, stamp)
+        && (stamp.size != header.sourceSize || stamp.modifiedTime != header.sourceModifiedTime)) {
+        return false;
+    }
+
+    const size_t sampleCount = static_cast<size_t>(header.frameCount * header.channels);
+    frames.resize(sampleCount);
+    file.read(reinterpret_cast<char*>(frames.data()), sizeof(float) * sampleCount);
+    if (static_cast<size_t>(file.gcount()) != sizeof(float) * sampleCount) {
+        frames.clear();
+        return false;
+    }
+
+    channels = header.channels;
+    return true;
+}
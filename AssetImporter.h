@@ -0,0 +1,51 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <string>
+#include <vector>
+
+// Offline conversion of source assets (WAV/MP3/FLAC/OGG) to the engine's sample
+// format and rate. Each import is a raw f32 file in the cache directory (see
+// AssetCache.h), so loading it is a single read with no decoding, and sounds that
+// play it unpitched never need a sample-rate conversion. An engine running at
+// another rate treats the import as stale and decodes the source instead.
+//
+// Channel counts are kept as authored: mono emitters stay mono for the spatializer,
+// which produces the output channels while panning anyway.
+//
+// Imports record the size and modification time of their source; a changed source
+// makes its import stale until it is converted again.
+class AssetImporter {
+public:
+    enum class Result {
+        Converted,
+        UpToDate,
+        Failed
+    };
+
+    struct Report {
+        size_t converted = 0;
+        size_t upToDate = 0;
+        size_t failed = 0;
+    };
+
+    AssetImporter(const std::string& cacheDirectory, ma_uint32 sampleRate);
+
+    Result Import(const std::string& filePath);
+
+    // Imports every audio file in the directory and its subdirectories
+    Report ImportDirectory(const std::string& directory);
+
+    static std::string GetImportedPath(const std::string& cacheDirectory, const std::string& filePath);
+
+    // Reads the import of filePath if it is current and at sampleRate. Checking it is a
+    // stat of the source, never a read; when the source is missing (shipped builds may
+    // leave it out) the import is trusted.
+    static bool LoadImported(const std::string& cacheDirectory, const std::string& filePath, ma_uint32 sampleRate,
+        std::vector<float>& frames, ma_uint32& channels);
+
+private:
+    std::string cacheDirectory;
+    ma_uint32 sampleRate;
+};
@@ -0,0 +1,203 @@
+#include "miniaudio.h"
+#include "Attenuation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const size_t AttenuationCurve::TableSize;
+
+// ---------------------------------------------------------------------------
+// AttenuationCurve
+// ---------------------------------------------------------------------------
+
+AttenuationCurve::AttenuationCurve(float minDist, float maxDist, const std::function<float(float distance)>& gainAtDistance)
+    : minDistance(std::max(0.0f, minDist))
+    , maxDistance(std::max(minDistance + 1e-3f, maxDist))
+    , tableScale(0.0f)
+{
+    tableScale = (TableSize - 1) / (maxDistance - minDistance);
+
+    table.resize(TableSize + 1);
+    for (size_t i = 0; i < TableSize; i++) {
+        float distance = minDistance + i / tableScale;
+        float gain = gainAtDistance ? gainAtDistance(distance) : 1.0f;
+        table[i] = std::max(0.0f, std::min(gain, 1.0f));
+    }
+    table[TableSize] = table[TableSize - 1];
+}
+
+std::shared_ptr<AttenuationCurve> AttenuationCurve::CreateLinear(float minDist, float maxDist) {
+    return std::make_shared<AttenuationCurve>(minDist, maxDist, [minDist, maxDist](float distance) {
+        return 1.0f - (distance - minDist) / std::max(maxDist - minDist, 1e-3f);
+    });
+}
+
+std::shared_ptr<AttenuationCurve> AttenuationCurve::CreateLogarithmic(float minDist, float maxDist) {
+    // Log of zero is undefined, so the curve needs a positive starting distance
+    float start = std::max(minDist, 1e-2f);
+    float range = std::log(std::max(maxDist, start * 1.001f) / start);
+
+    return std::make_shared<AttenuationCurve>(minDist, maxDist, [start, range](float distance) {
+        return 1.0f - std::log(std::max(distance, start) / start) / range;
+    });
+}
+
+std::shared_ptr<AttenuationCurve> AttenuationCurve::CreateInverse(float minDist, float maxDist, float rolloff) {
+    float start = std::max(minDist, 1e-2f);
+
+    return std::make_shared<AttenuationCurve>(minDist, maxDist, [start, rolloff](float distance) {
+        return start / (start + rolloff * std::max(distance - start, 0.0f));
+    });
+}
+
+std::shared_ptr<AttenuationCurve> AttenuationCurve::CreateSpline(std::vector<AttenuationPoint> points) {
+    if (points.empty()) {
+        return CreateLinear(0.0f, 1.0f);
+    }
+
+    std::sort(points.begin(), points.end(), [](const AttenuationPoint& a, const AttenuationPoint& b) {
+        return a.distance < b.distance;
+    });
+    if (points.size() == 1) {
+        float gain = points[0].gain;
+        return std::make_shared<AttenuationCurve>(points[0].distance, points[0].distance + 1.0f, [gain](float) { return gain; });
+    }
+
+    // Fritsch-Carlson tangents keep each segment monotone
+    size_t count = points.size();
+    std::vector<float> slopes(count - 1);
+    std::vector<float> tangents(count);
+    for (size_t i = 0; i + 1 < count; i++) {
+        float width = std::max(points[i + 1].distance - points[i].distance, 1e-6f);
+        slopes[i] = (points[i + 1].gain - points[i].gain) / width;
+    }
+    tangents[0] = slopes[0];
+    tangents[count - 1] = slopes[count - 2];
+    for (size_t i = 1; i + 1 < count; i++) {
+        tangents[i] = (slopes[i - 1] * slopes[i] <= 0.0f) ? 0.0f : (slopes[i - 1] + slopes[i]) * 0.5f;
+    }
+    for (size_t i = 0; i + 1 < count; i++) {
+        if (slopes[i] == 0.0f) {
+            tangents[i] = 0.0f;
+            tangents[i + 1] = 0.0f;
+            continue;
+        }
+        float a = tangents[i] / slopes[i];
+        float b = tangents[i + 1] / slopes[i];
+        float length = a * a + b * b;
+        if (length > 9.0f) {
+            float scale = 3.0f / std::sqrt(length);
+            tangents[i] = scale * a * slopes[i];
+            tangents[i + 1] = scale * b * slopes[i];
+        }
+    }
+
+    return std::make_shared<AttenuationCurve>(points.front().distance, points.back().distance,
+        [points, tangents](float distance) {
+            size_t segment = 0;
+            while (segment + 2 < points.size() && distance > points[segment + 1].distance) segment++;
+
+            const AttenuationPoint& p0 = points[segment];
+            const AttenuationPoint& p1 = points[segment + 1];
+            float width = std::max(p1.distance - p0.distance, 1e-6f);
+            float t = std::max(0.0f, std::min((distance - p0.distance) / width, 1.0f));
+            float t2 = t * t;
+            float t3 = t2 * t;
+
+            return (2 * t3 - 3 * t2 + 1) * p0.gain + (t3 - 2 * t2 + t) * width * tangents[segment] +
+                (-2 * t3 + 3 * t2) * p1.gain + (t3 - t2) * width * tangents[segment + 1];
+        });
+}
+
+float AttenuationCurve::Evaluate(float distance) const {
+    float position = std::max(0.0f, std::min((distance - minDistance) * tableScale, static_cast<float>(TableSize - 1)));
+    size_t index = static_cast<size_t>(position);
+    float frac = position - index;
+    return table[index] + (table[index + 1] - table[index]) * frac;
+}
+
+float AttenuationCurve::GetMinDistance() const {
+    return minDistance;
+}
+
+float AttenuationCurve::GetMaxDistance() const {
+    return maxDistance;
+}
+
+// ---------------------------------------------------------------------------
+// AttenuationEffect
+// ---------------------------------------------------------------------------
+
+AttenuationEffect::AttenuationEffect(std::shared_ptr<const AttenuationCurve> curve, ma_sound* source)
+    : curve(curve)
+    , activeCurve(curve.get())
+    , busy(false)
+    , source(source)
+    , gain(1.0f)
+    , hasGain(false)
+{
+    if (channels == 0 || !curve || !source) return;
+
+    InitNode();
+}
+
+AttenuationEffect::~AttenuationEffect() {
+    UninitNode();
+}
+
+void AttenuationEffect::SetCurve(std::shared_ptr<const AttenuationCurve> newCurve) {
+    if (!newCurve || newCurve == curve) return;
+
+    // Sequentially consistent with Process(): either it reads the new pointer, or
+    // this sees it busy and waits for the block to finish with the old one
+    activeCurve.store(newCurve.get());
+    while (busy.load()) {
+        std::this_thread::yield();
+    }
+    curve = newCurve;
+}
+
+const std::shared_ptr<const AttenuationCurve>& AttenuationEffect::GetCurve() const {
+    return curve;
+}
+
+void AttenuationEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+
+    // Distance to the listener the sound is heard through, in the listener's space
+    ma_engine* soundEngine = ma_sound_get_engine(source);
+    ma_uint32 listenerIndex = ma_sound_get_listener_index(source);
+    ma_vec3f relative;
+    ma_spatializer_get_relative_position_and_direction(&source->engineNode.spatializer,
+        &soundEngine->listeners[listenerIndex], &relative, NULL);
+
+    float distance = std::sqrt(relative.x * relative.x + relative.y * relative.y + relative.z * relative.z);
+    busy.store(true);
+    float targetGain = activeCurve.load()->Evaluate(distance);
+    busy.store(false);
+    if (!hasGain) {
+        gain = targetGain;
+        hasGain = true;
+    }
+
+    float step = (frameCount > 0) ? (targetGain - gain) / frameCount : 0.0f;
+    for (ma_uint32 frame = 0; frame < frameCount; frame++) {
+        float g = gain + step * (frame + 1);
+        const float* pIn = &pFramesIn[frame * channels];
+        float* pOut = &pFramesOut[frame * channels];
+        for (ma_uint32 c = 0; c < channels; c++) {
+            pOut[c] = pIn[c] * g;
+        }
+    }
+
+    gain = targetGain;
+}
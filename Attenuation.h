@@ -0,0 +1,71 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEffect.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Control point for a designer-authored falloff
+struct AttenuationPoint {
+    float distance;
+    float gain;     // 0.0 to 1.0
+};
+
+// Distance-to-gain falloff baked into a lookup table, so evaluating it costs a
+// multiply and a lerp whatever the shape. Immutable once built, so one curve can
+// be shared by any number of sounds and buses.
+class AttenuationCurve {
+public:
+    static const size_t TableSize = 256;
+
+    // Samples gainAtDistance across [minDistance, maxDistance]; outside that range
+    // the end values hold
+    AttenuationCurve(float minDistance, float maxDistance, const std::function<float(float distance)>& gainAtDistance);
+
+    static std::shared_ptr<AttenuationCurve> CreateLinear(float minDistance, float maxDistance);
+    // Gain falls linearly with log distance, reaching silence at maxDistance
+    static std::shared_ptr<AttenuationCurve> CreateLogarithmic(float minDistance, float maxDistance);
+    // Same shape as miniaudio's inverse model
+    static std::shared_ptr<AttenuationCurve> CreateInverse(float minDistance, float maxDistance, float rolloff = 1.0f);
+    // Monotone cubic through the points (no overshoot between them)
+    static std::shared_ptr<AttenuationCurve> CreateSpline(std::vector<AttenuationPoint> points);
+
+    float Evaluate(float distance) const;
+
+    float GetMinDistance() const;
+    float GetMaxDistance() const;
+
+private:
+    float minDistance;
+    float maxDistance;
+    float tableScale;
+    std::vector<float> table;   // TableSize + 1 entries so lookups never need a bounds check
+};
+
+// Applies an attenuation curve to one sound. Placed in the sound's voice effect
+// chain; each block it measures the distance to the sound's listener, looks up
+// the gain and ramps to it across the block. Swapping the curve keeps the node,
+// so the gain ramps from the old curve's value to the new one's.
+class AttenuationEffect : public AudioEffect {
+public:
+    AttenuationEffect(std::shared_ptr<const AttenuationCurve> curve, ma_sound* source);
+    ~AttenuationEffect() override;
+
+    // Game thread. Waits out a block using the old curve before releasing it.
+    void SetCurve(std::shared_ptr<const AttenuationCurve> curve);
+    const std::shared_ptr<const AttenuationCurve>& GetCurve() const;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    std::shared_ptr<const AttenuationCurve> curve;      // Owned by the game thread
+    std::atomic<const AttenuationCurve*> activeCurve;   // What the audio thread reads
+    std::atomic<bool> busy;
+    ma_sound* source;
+    float gain;
+    bool hasGain;
+};
@@ -0,0 +1,78 @@
+#include "miniaudio.h"
+#include "AudioBus.h"
+
+AudioBus::AudioBus(ma_engine* engine, AudioBus* parent)
+    : engine(engine)
+    , parent(parent)
+    , initialized(false)
+{
+    // Buses only mix, so skip the per-group spatializer and resampler
+    ma_uint32 flags = MA_SOUND_FLAG_NO_SPATIALIZATION | MA_SOUND_FLAG_NO_PITCH;
+    ma_sound_group* parentGroup = parent ? parent->GetGroup() : nullptr;
+
+    ma_result result = ma_sound_group_init(engine, flags, parentGroup, &group);
+    initialized = (result == MA_SUCCESS);
+
+    if (initialized) {
+        effects.Connect(&group, parent ? static_cast<ma_node*>(parentGroup) : ma_engine_get_endpoint(engine));
+    }
+}
+
+AudioBus::~AudioBus() {
+    if (initialized) {
+        effects.Disconnect();
+        ma_sound_group_uninit(&group);
+    }
+    if (subgraph) {
+        ma_node_graph_uninit(subgraph.get(), NULL);
+    }
+}
+
+bool AudioBus::IsInitialized() const {
+    return initialized;
+}
+
+ma_sound_group* AudioBus::GetGroup() {
+    return initialized ? &group : nullptr;
+}
+
+ma_node* AudioBus::GetOutputNode() {
+    return effects.GetDestination();
+}
+
+EffectChain& AudioBus::GetEffects() {
+    return effects;
+}
+
+bool AudioBus::SetIsolated(bool isolate) {
+    if (!initialized || !parent || isolate == IsIsolated()) {
+        return initialized && parent;
+    }
+
+    if (isolate) {
+        ma_node_graph_config config = ma_node_graph_config_init(ma_engine_get_channels(engine));
+        std::unique_ptr<ma_node_graph> graph(new ma_node_graph());
+        if (ma_node_graph_init(&config, NULL, graph.get()) != MA_SUCCESS) {
+            return false;
+        }
+        subgraph = std::move(graph);
+
+        // Scheduled start/stop times are checked against the reading graph's clock
+        ma_node_graph_set_time(subgraph.get(), ma_engine_get_time_in_pcm_frames(engine));
+        effects.SetDestination(ma_node_graph_get_endpoint(subgraph.get()));
+    }
+    else {
+        effects.SetDestination(parent->GetGroup());
+        ma_node_graph_uninit(subgraph.get(), NULL);
+        subgraph.reset();
+    }
+    return true;
+}
+
+bool AudioBus::IsIsolated() const {
+    return subgraph != nullptr;
+}
+
+ma_node_graph* AudioBus::GetSubgraph() {
+    return subgraph.get();
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "EffectChain.h"
+
+#include <memory>
+
+// A mixing bus. Sounds are routed into the bus's sound group, which is summed and
+// then passed through the bus's insert effect chain before reaching its parent bus
+// (or the engine endpoint for the master bus). One effect instance on a bus
+// processes every sound in that bus.
+class AudioBus {
+public:
+    AudioBus(ma_engine* engine, AudioBus* parent = nullptr);
+    ~AudioBus();
+
+    bool IsInitialized() const;
+
+    // Node that sounds attach their output to
+    ma_sound_group* GetGroup();
+
+    // Node the bus output (after effects) feeds
+    ma_node* GetOutputNode();
+
+    EffectChain& GetEffects();
+
+    // Moves the bus output into a node graph of its own instead of the parent bus,
+    // so it can be mixed on another thread (see ParallelMixer). Whatever reads the
+    // subgraph must be torn down before the bus is rejoined to its parent.
+    bool SetIsolated(bool isolate);
+    bool IsIsolated() const;
+    ma_node_graph* GetSubgraph();
+
+private:
+    AudioBus(const AudioBus&) = delete;
+    AudioBus& operator=(const AudioBus&) = delete;
+
+    ma_engine* engine;
+    AudioBus* parent;
+    ma_sound_group group;
+    std::unique_ptr<ma_node_graph> subgraph;
+    EffectChain effects;
+    bool initialized;
+};
@@ -0,0 +1,672 @@
+#include "miniaudio.h"
+#include "AudioEffect.h"
+#include "AudioEngine.h"
+
+#include <algorithm>
+#include <cmath>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_node_vtable AudioEffect::NodeVTable = {
+    &AudioEffect::ProcessNode,
+    nullptr,
+    MA_NODE_BUS_COUNT_UNKNOWN,
+    MA_NODE_BUS_COUNT_UNKNOWN,
+    // Keep processing with no input so delay and reverb tails ring out
+    MA_NODE_FLAG_CONTINUOUS_PROCESSING
+};
+
+AudioEffect::AudioEffect()
+    : engine(nullptr)
+    , channels(0)
+    , sampleRate(0)
+    , initialized(false)
+    , bypassed(false)
+    , parameterVersion(1)
+    , appliedParameterVersion(0)
+    , chain(nullptr)
+{
+    engine = AudioEngine::Instance().GetEngine();
+    channels = ma_engine_get_channels(engine);
+    sampleRate = ma_engine_get_sample_rate(engine);
+}
+
+AudioEffect::~AudioEffect() {
+    UninitNode();
+}
+
+bool AudioEffect::IsInitialized() const {
+    return initialized;
+}
+
+void AudioEffect::SetBypassed(bool bypass) {
+    bypassed.store(bypass);
+}
+
+bool AudioEffect::IsBypassed() const {
+    return bypassed.load();
+}
+
+bool AudioEffect::IsAttached() const {
+    return chain != nullptr;
+}
+
+ma_node* AudioEffect::GetNode() {
+    return initialized ? &node : nullptr;
+}
+
+bool AudioEffect::InitNode(ma_uint32 inputBusCount, ma_uint32 outputBusCount) {
+    if (initialized) return true;
+    if (channels == 0 || sampleRate == 0 || inputBusCount == 0 || outputBusCount == 0) return false;
+
+    std::vector<ma_uint32> inputChannels(inputBusCount, channels);
+    std::vector<ma_uint32> outputChannels(outputBusCount, channels);
+
+    ma_node_config nodeConfig = ma_node_config_init();
+    nodeConfig.vtable = &NodeVTable;
+    nodeConfig.inputBusCount = inputBusCount;
+    nodeConfig.outputBusCount = outputBusCount;
+    nodeConfig.pInputChannels = inputChannels.data();
+    nodeConfig.pOutputChannels = outputChannels.data();
+
+    node.effect = this;
+    ma_result result = ma_node_init(ma_engine_get_node_graph(engine), &nodeConfig, NULL, &node);
+    initialized = (result == MA_SUCCESS);
+    return initialized;
+}
+
+void AudioEffect::UninitNode() {
+    if (!initialized) return;
+
+    // Blocks until the audio thread is no longer processing the node
+    ma_node_uninit(&node, NULL);
+    initialized = false;
+}
+
+void AudioEffect::MarkParametersDirty() {
+    parameterVersion.fetch_add(1, std::memory_order_release);
+}
+
+void AudioEffect::ProcessNode(ma_node* pNode, const float** ppFramesIn, ma_uint32* pFrameCountIn,
+    float** ppFramesOut, ma_uint32* pFrameCountOut) {
+    (void)pFrameCountIn;
+
+    AudioEffect* effect = reinterpret_cast<EffectNode*>(pNode)->effect;
+    ma_uint32 frameCount = *pFrameCountOut;
+
+    ma_uint32 version = effect->parameterVersion.load(std::memory_order_acquire);
+    if (version != effect->appliedParameterVersion) {
+        effect->appliedParameterVersion = version;
+        effect->ApplyParameters();
+    }
+
+    if (effect->bypassed.load(std::memory_order_relaxed)) {
+        ma_copy_pcm_frames(ppFramesOut[0], ppFramesIn[0], frameCount, ma_format_f32, effect->channels);
+    }
+    else {
+        effect->Process(ppFramesIn, ppFramesOut[0], frameCount);
+    }
+
+    // Sends mirror the main output
+    ma_uint32 outputBusCount = ma_node_get_output_bus_count(pNode);
+    for (ma_uint32 bus = 1; bus < outputBusCount; bus++) {
+        ma_copy_pcm_frames(ppFramesOut[bus], ppFramesOut[0], frameCount, ma_format_f32, effect->channels);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// LowPassEffect
+// ---------------------------------------------------------------------------
+
+LowPassEffect::LowPassEffect(float cutoffHz, ma_uint32 order)
+    : order(std::max<ma_uint32>(1, std::min<ma_uint32>(order, MA_MAX_FILTER_ORDER)))
+    , filterInitialized(false)
+    , cutoff(cutoffHz)
+{
+    if (channels == 0) return;
+
+    ma_lpf_config config = ma_lpf_config_init(ma_format_f32, channels, sampleRate, cutoffHz, this->order);
+    filterInitialized = (ma_lpf_init(&config, NULL, &filter) == MA_SUCCESS);
+    if (filterInitialized) {
+        InitNode();
+    }
+}
+
+LowPassEffect::~LowPassEffect() {
+    UninitNode();
+    if (filterInitialized) {
+        ma_lpf_uninit(&filter, NULL);
+    }
+}
+
+void LowPassEffect::SetCutoff(float cutoffHz) {
+    cutoff.store(std::max(10.0f, std::min(cutoffHz, sampleRate * 0.5f)));
+    MarkParametersDirty();
+}
+
+float LowPassEffect::GetCutoff() const {
+    return cutoff.load();
+}
+
+void LowPassEffect::ApplyParameters() {
+    // Same order as at init, so this only recomputes coefficients
+    ma_lpf_config config = ma_lpf_config_init(ma_format_f32, channels, sampleRate, cutoff.load(), order);
+    ma_lpf_reinit(&config, &filter);
+}
+
+void LowPassEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    ma_lpf_process_pcm_frames(&filter, pFramesOut, ppFramesIn[0], frameCount);
+}
+
+// ---------------------------------------------------------------------------
+// HighPassEffect
+// ---------------------------------------------------------------------------
+
+HighPassEffect::HighPassEffect(float cutoffHz, ma_uint32 order)
+    : order(std::max<ma_uint32>(1, std::min<ma_uint32>(order, MA_MAX_FILTER_ORDER)))
+    , filterInitialized(false)
+    , cutoff(cutoffHz)
+{
+    if (channels == 0) return;
+
+    ma_hpf_config config = ma_hpf_config_init(ma_format_f32, channels, sampleRate, cutoffHz, this->order);
+    filterInitialized = (ma_hpf_init(&config, NULL, &filter) == MA_SUCCESS);
+    if (filterInitialized) {
+        InitNode();
+    }
+}
+
+HighPassEffect::~HighPassEffect() {
+    UninitNode();
+    if (filterInitialized) {
+        ma_hpf_uninit(&filter, NULL);
+    }
+}
+
+void HighPassEffect::SetCutoff(float cutoffHz) {
+    cutoff.store(std::max(10.0f, std::min(cutoffHz, sampleRate * 0.5f)));
+    MarkParametersDirty();
+}
+
+float HighPassEffect::GetCutoff() const {
+    return cutoff.load();
+}
+
+void HighPassEffect::ApplyParameters() {
+    ma_hpf_config config = ma_hpf_config_init(ma_format_f32, channels, sampleRate, cutoff.load(), order);
+    ma_hpf_reinit(&config, &filter);
+}
+
+void HighPassEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    ma_hpf_process_pcm_frames(&filter, pFramesOut, ppFramesIn[0], frameCount);
+}
+
+// ---------------------------------------------------------------------------
+// DelayEffect
+// ---------------------------------------------------------------------------
+
+DelayEffect::DelayEffect(float delaySeconds, float feedback, float wet, float maxDelaySeconds)
+    : bufferFrames(0)
+    , writeIndex(0)
+    , maxDelaySeconds(std::max(0.01f, maxDelaySeconds))
+    , delaySeconds(0.0f)
+    , feedback(0.0f)
+    , wet(0.0f)
+{
+    if (channels == 0) return;
+
+    bufferFrames = static_cast<ma_uint32>(this->maxDelaySeconds * sampleRate) + 1;
+    buffer.assign(static_cast<size_t>(bufferFrames) * channels, 0.0f);
+
+    SetDelay(delaySeconds);
+    SetFeedback(feedback);
+    SetWet(wet);
+    InitNode();
+}
+
+DelayEffect::~DelayEffect() {
+    UninitNode();
+}
+
+void DelayEffect::SetDelay(float seconds) {
+    delaySeconds.store(std::max(0.0f, std::min(seconds, maxDelaySeconds)));
+}
+
+float DelayEffect::GetDelay() const {
+    return delaySeconds.load();
+}
+
+void DelayEffect::SetFeedback(float fb) {
+    feedback.store(std::max(0.0f, std::min(fb, 0.95f)));
+}
+
+float DelayEffect::GetFeedback() const {
+    return feedback.load();
+}
+
+void DelayEffect::SetWet(float w) {
+    wet.store(std::max(0.0f, std::min(w, 1.0f)));
+}
+
+float DelayEffect::GetWet() const {
+    return wet.load();
+}
+
+void DelayEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const ma_uint32 delayFrames = std::max<ma_uint32>(1, std::min<ma_uint32>(
+        static_cast<ma_uint32>(delaySeconds.load(std::memory_order_relaxed) * sampleRate), bufferFrames - 1));
+    const float fb = feedback.load(std::memory_order_relaxed);
+    const float wetGain = wet.load(std::memory_order_relaxed);
+    const float dryGain = 1.0f - wetGain;
+
+    for (ma_uint32 frame = 0; frame < frameCount; frame++) {
+        ma_uint32 readIndex = (writeIndex + bufferFrames - delayFrames) % bufferFrames;
+        float* pWrite = &buffer[static_cast<size_t>(writeIndex) * channels];
+        const float* pRead = &buffer[static_cast<size_t>(readIndex) * channels];
+
+        for (ma_uint32 c = 0; c < channels; c++) {
+            float in = pFramesIn[frame * channels + c];
+            float delayed = pRead[c];
+            pFramesOut[frame * channels + c] = in * dryGain + delayed * wetGain;
+            pWrite[c] = in + delayed * fb;
+        }
+
+        writeIndex = (writeIndex + 1) % bufferFrames;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// EqualizerEffect
+// ---------------------------------------------------------------------------
+
+EqualizerEffect::EqualizerEffect(ma_uint32 peakBandCount)
+    : peaks(peakBandCount)
+    , initializedPeaks(0)
+    , shelvesInitialized(false)
+    , bandParams(peakBandCount)
+{
+    lowShelfParams.frequency.store(100.0f);
+    lowShelfParams.gainDb.store(0.0f);
+    lowShelfParams.q.store(1.0f);
+    highShelfParams.frequency.store(8000.0f);
+    highShelfParams.gainDb.store(0.0f);
+    highShelfParams.q.store(1.0f);
+
+    // Spread the peaking bands logarithmically between the shelves
+    for (ma_uint32 i = 0; i < peakBandCount; i++) {
+        float t = (i + 1.0f) / (peakBandCount + 1.0f);
+        bandParams[i].frequency.store(100.0f * std::pow(80.0f, t));
+        bandParams[i].gainDb.store(0.0f);
+        bandParams[i].q.store(1.0f);
+    }
+
+    if (channels == 0) return;
+
+    ma_loshelf2_config lowConfig = ma_loshelf2_config_init(ma_format_f32, channels, sampleRate, 0.0, 1.0, lowShelfParams.frequency.load());
+    ma_hishelf2_config highConfig = ma_hishelf2_config_init(ma_format_f32, channels, sampleRate, 0.0, 1.0, highShelfParams.frequency.load());
+    if (ma_loshelf2_init(&lowConfig, NULL, &lowShelf) != MA_SUCCESS) return;
+    if (ma_hishelf2_init(&highConfig, NULL, &highShelf) != MA_SUCCESS) {
+        ma_loshelf2_uninit(&lowShelf, NULL);
+        return;
+    }
+    shelvesInitialized = true;
+
+    for (; initializedPeaks < peakBandCount; initializedPeaks++) {
+        const BandParameters& band = bandParams[initializedPeaks];
+        ma_peak2_config peakConfig = ma_peak2_config_init(ma_format_f32, channels, sampleRate,
+            band.gainDb.load(), band.q.load(), band.frequency.load());
+        if (ma_peak2_init(&peakConfig, NULL, &peaks[initializedPeaks]) != MA_SUCCESS) {
+            return;
+        }
+    }
+
+    InitNode();
+}
+
+EqualizerEffect::~EqualizerEffect() {
+    UninitNode();
+
+    for (ma_uint32 i = 0; i < initializedPeaks; i++) {
+        ma_peak2_uninit(&peaks[i], NULL);
+    }
+    if (shelvesInitialized) {
+        ma_loshelf2_uninit(&lowShelf, NULL);
+        ma_hishelf2_uninit(&highShelf, NULL);
+    }
+}
+
+void EqualizerEffect::SetLowShelf(float frequencyHz, float gainDb) {
+    lowShelfParams.frequency.store(std::max(10.0f, std::min(frequencyHz, sampleRate * 0.45f)));
+    lowShelfParams.gainDb.store(gainDb);
+    MarkParametersDirty();
+}
+
+void EqualizerEffect::SetHighShelf(float frequencyHz, float gainDb) {
+    highShelfParams.frequency.store(std::max(10.0f, std::min(frequencyHz, sampleRate * 0.45f)));
+    highShelfParams.gainDb.store(gainDb);
+    MarkParametersDirty();
+}
+
+void EqualizerEffect::SetBand(ma_uint32 band, float frequencyHz, float gainDb, float q) {
+    if (band >= bandParams.size()) return;
+
+    bandParams[band].frequency.store(std::max(10.0f, std::min(frequencyHz, sampleRate * 0.45f)));
+    bandParams[band].gainDb.store(gainDb);
+    bandParams[band].q.store(std::max(0.1f, q));
+    MarkParametersDirty();
+}
+
+ma_uint32 EqualizerEffect::GetBandCount() const {
+    return static_cast<ma_uint32>(bandParams.size());
+}
+
+void EqualizerEffect::ApplyParameters() {
+    ma_loshelf2_config lowConfig = ma_loshelf2_config_init(ma_format_f32, channels, sampleRate,
+        lowShelfParams.gainDb.load(), 1.0, lowShelfParams.frequency.load());
+    ma_loshelf2_reinit(&lowConfig, &lowShelf);
+
+    ma_hishelf2_config highConfig = ma_hishelf2_config_init(ma_format_f32, channels, sampleRate,
+        highShelfParams.gainDb.load(), 1.0, highShelfParams.frequency.load());
+    ma_hishelf2_reinit(&highConfig, &highShelf);
+
+    for (ma_uint32 i = 0; i < initializedPeaks; i++) {
+        const BandParameters& band = bandParams[i];
+        ma_peak2_config peakConfig = ma_peak2_config_init(ma_format_f32, channels, sampleRate,
+            band.gainDb.load(), band.q.load(), band.frequency.load());
+        ma_peak2_reinit(&peakConfig, &peaks[i]);
+    }
+}
+
+void EqualizerEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    // Biquads support in-place processing, so run the whole cascade in the output buffer
+    ma_loshelf2_process_pcm_frames(&lowShelf, pFramesOut, ppFramesIn[0], frameCount);
+    for (ma_uint32 i = 0; i < initializedPeaks; i++) {
+        ma_peak2_process_pcm_frames(&peaks[i], pFramesOut, pFramesOut, frameCount);
+    }
+    ma_hishelf2_process_pcm_frames(&highShelf, pFramesOut, pFramesOut, frameCount);
+}
+
+// ---------------------------------------------------------------------------
+// ReverbEffect
+// ---------------------------------------------------------------------------
+
+// Classic Freeverb tunings at 44.1kHz, scaled to the engine sample rate
+static const ma_uint32 g_combTunings[] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+static const ma_uint32 g_allpassTunings[] = { 556, 441, 341, 225 };
+static const ma_uint32 g_stereoSpread = 23;
+static const float g_reverbInputGain = 0.015f;
+static const float g_reverbWetScale = 3.0f;
+static const float g_allpassFeedback = 0.5f;
+
+static inline float FlushDenormal(float value) {
+    return (std::fabs(value) < 1.0e-15f) ? 0.0f : value;
+}
+
+ReverbEffect::ReverbEffect(float roomSize, float damping, float wet)
+    : roomSize(0.0f)
+    , damping(0.0f)
+    , wet(0.0f)
+    , width(1.0f)
+    , combFeedback(0.0f)
+    , combDamping(0.0f)
+    , wetGain1(0.0f)
+    , wetGain2(0.0f)
+    , dryGain(1.0f)
+{
+    SetRoomSize(roomSize);
+    SetDamping(damping);
+    SetWet(wet);
+
+    if (channels == 0) return;
+
+    const float scale = sampleRate / 44100.0f;
+    combs.resize(static_cast<size_t>(CombCount) * channels);
+    allpasses.resize(static_cast<size_t>(AllpassCount) * channels);
+
+    for (ma_uint32 c = 0; c < channels; c++) {
+        const ma_uint32 spread = (c % 2) * g_stereoSpread;
+        for (ma_uint32 i = 0; i < CombCount; i++) {
+            Comb& comb = combs[c * CombCount + i];
+            comb.buffer.assign(std::max<ma_uint32>(1, static_cast<ma_uint32>((g_combTunings[i] + spread) * scale)), 0.0f);
+            comb.index = 0;
+            comb.store = 0.0f;
+        }
+        for (ma_uint32 i = 0; i < AllpassCount; i++) {
+            Allpass& allpass = allpasses[c * AllpassCount + i];
+            allpass.buffer.assign(std::max<ma_uint32>(1, static_cast<ma_uint32>((g_allpassTunings[i] + spread) * scale)), 0.0f);
+            allpass.index = 0;
+        }
+    }
+
+    ApplyParameters();
+    InitNode();
+}
+
+ReverbEffect::~ReverbEffect() {
+    UninitNode();
+}
+
+void ReverbEffect::SetRoomSize(float value) {
+    roomSize.store(std::max(0.0f, std::min(value, 1.0f)));
+    MarkParametersDirty();
+}
+
+float ReverbEffect::GetRoomSize() const {
+    return roomSize.load();
+}
+
+void ReverbEffect::SetDamping(float value) {
+    damping.store(std::max(0.0f, std::min(value, 1.0f)));
+    MarkParametersDirty();
+}
+
+float ReverbEffect::GetDamping() const {
+    return damping.load();
+}
+
+void ReverbEffect::SetWet(float value) {
+    wet.store(std::max(0.0f, std::min(value, 1.0f)));
+    MarkParametersDirty();
+}
+
+float ReverbEffect::GetWet() const {
+    return wet.load();
+}
+
+void ReverbEffect::SetWidth(float value) {
+    width.store(std::max(0.0f, std::min(value, 1.0f)));
+    MarkParametersDirty();
+}
+
+float ReverbEffect::GetWidth() const {
+    return width.load();
+}
+
+void ReverbEffect::ApplyParameters() {
+    const float w = wet.load();
+    const float spread = width.load();
+
+    combFeedback = roomSize.load() * 0.28f + 0.7f;
+    combDamping = damping.load() * 0.4f;
+    wetGain1 = w * g_reverbWetScale * (spread * 0.5f + 0.5f);
+    wetGain2 = w * g_reverbWetScale * ((1.0f - spread) * 0.5f);
+    dryGain = 1.0f - w;
+}
+
+void ReverbEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    float wetFrame[MA_MAX_CHANNELS];
+
+    for (ma_uint32 frame = 0; frame < frameCount; frame++) {
+        const float* pIn = &pFramesIn[frame * channels];
+
+        // All channels are fed the same mono sum; decorrelation comes from the spread tunings
+        float input = 0.0f;
+        for (ma_uint32 c = 0; c < channels; c++) {
+            input += pIn[c];
+        }
+        input *= g_reverbInputGain;
+
+        for (ma_uint32 c = 0; c < channels; c++) {
+            float out = 0.0f;
+
+            for (ma_uint32 i = 0; i < CombCount; i++) {
+                Comb& comb = combs[c * CombCount + i];
+                float delayed = comb.buffer[comb.index];
+                comb.store = FlushDenormal(delayed * (1.0f - combDamping) + comb.store * combDamping);
+                comb.buffer[comb.index] = input + comb.store * combFeedback;
+                if (++comb.index >= comb.buffer.size()) comb.index = 0;
+                out += delayed;
+            }
+
+            for (ma_uint32 i = 0; i < AllpassCount; i++) {
+                Allpass& allpass = allpasses[c * AllpassCount + i];
+                float delayed = allpass.buffer[allpass.index];
+                allpass.buffer[allpass.index] = FlushDenormal(out + delayed * g_allpassFeedback);
+                out = delayed - out;
+                if (++allpass.index >= allpass.buffer.size()) allpass.index = 0;
+            }
+
+            wetFrame[c] = out;
+        }
+
+        float* pOut = &pFramesOut[frame * channels];
+        for (ma_uint32 c = 0; c < channels; c++) {
+            // Cross-feed the neighbouring channel to control stereo width
+            float other = wetFrame[(c + 1) % channels];
+            pOut[c] = wetFrame[c] * wetGain1 + other * wetGain2 + pIn[c] * dryGain;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// OcclusionEffect
+// ---------------------------------------------------------------------------
+
+const ma_uint32 OcclusionEffect::SubBlockFrames;
+
+OcclusionEffect::OcclusionEffect(const OcclusionSettings& settings)
+    : occlusion(0.0f)
+    , obstruction(0.0f)
+    , occlusionGain(settings.occlusionGain)
+    , occlusionCutoff(settings.occlusionCutoff)
+    , obstructionGain(settings.obstructionGain)
+    , obstructionCutoff(settings.obstructionCutoff)
+    , smoothingTime(settings.smoothingTime)
+    , snapToTarget(true)
+    , currentOcclusion(0.0f)
+    , currentObstruction(0.0f)
+    , currentGain(1.0f)
+    , smoothing(1.0f)
+    , maxCutoff(0.0f)
+{
+    if (channels == 0) return;
+
+    filterState.assign(channels * 2, 0.0f);
+    maxCutoff = std::min(20000.0f, sampleRate * 0.45f);
+    InitNode();
+}
+
+OcclusionEffect::~OcclusionEffect() {
+    UninitNode();
+}
+
+void OcclusionEffect::SetOcclusion(float value) {
+    occlusion.store(std::max(0.0f, std::min(value, 1.0f)), std::memory_order_relaxed);
+}
+
+float OcclusionEffect::GetOcclusion() const {
+    return occlusion.load();
+}
+
+void OcclusionEffect::SetObstruction(float value) {
+    obstruction.store(std::max(0.0f, std::min(value, 1.0f)), std::memory_order_relaxed);
+}
+
+float OcclusionEffect::GetObstruction() const {
+    return obstruction.load();
+}
+
+void OcclusionEffect::SetSettings(const OcclusionSettings& settings) {
+    occlusionGain.store(std::max(0.0f, std::min(settings.occlusionGain, 1.0f)));
+    occlusionCutoff.store(std::max(20.0f, settings.occlusionCutoff));
+    obstructionGain.store(std::max(0.0f, std::min(settings.obstructionGain, 1.0f)));
+    obstructionCutoff.store(std::max(20.0f, settings.obstructionCutoff));
+    smoothingTime.store(std::max(0.0f, settings.smoothingTime));
+    MarkParametersDirty();
+}
+
+void OcclusionEffect::ApplyParameters() {
+    // One-pole smoothing per sub-block that settles to ~95% in smoothingTime
+    float settleFrames = smoothingTime.load() * sampleRate / 3.0f;
+    smoothing = (settleFrames > SubBlockFrames) ? 1.0f - std::exp(-static_cast<float>(SubBlockFrames) / settleFrames) : 1.0f;
+}
+
+void OcclusionEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const float twoPi = 6.28318530718f;
+
+    float targetOcclusion = occlusion.load(std::memory_order_relaxed);
+    float targetObstruction = obstruction.load(std::memory_order_relaxed);
+    if (snapToTarget.exchange(false)) {
+        currentOcclusion = targetOcclusion;
+        currentObstruction = targetObstruction;
+    }
+
+    // Fully open: nothing to do
+    const float silentAmount = 1e-4f;
+    if (currentOcclusion < silentAmount && currentObstruction < silentAmount &&
+        targetOcclusion < silentAmount && targetObstruction < silentAmount) {
+        ma_copy_pcm_frames(pFramesOut, pFramesIn, frameCount, ma_format_f32, channels);
+        std::fill(filterState.begin(), filterState.end(), 0.0f);
+        currentOcclusion = 0.0f;
+        currentObstruction = 0.0f;
+        currentGain = 1.0f;
+        return;
+    }
+
+    float occludedGain = occlusionGain.load(std::memory_order_relaxed);
+    float occludedCutoff = std::min(occlusionCutoff.load(std::memory_order_relaxed), maxCutoff);
+    float obstructedGain = obstructionGain.load(std::memory_order_relaxed);
+    float obstructedCutoff = std::min(obstructionCutoff.load(std::memory_order_relaxed), maxCutoff);
+
+    for (ma_uint32 offset = 0; offset < frameCount; offset += SubBlockFrames) {
+        ma_uint32 frames = std::min(SubBlockFrames, frameCount - offset);
+
+        currentOcclusion += (targetOcclusion - currentOcclusion) * smoothing;
+        currentObstruction += (targetObstruction - currentObstruction) * smoothing;
+
+        // Cutoffs combine geometrically so both amounts darken the sound independently
+        float cutoff = maxCutoff * std::pow(occludedCutoff / maxCutoff, currentOcclusion) *
+            std::pow(obstructedCutoff / maxCutoff, currentObstruction);
+        float coefficient = 1.0f - std::exp(-twoPi * cutoff / sampleRate);
+        float targetGain = (1.0f + (occludedGain - 1.0f) * currentOcclusion) *
+            (1.0f + (obstructedGain - 1.0f) * currentObstruction);
+
+        // Fade the filter in over the first few percent so switching it on is seamless
+        float wet = std::min(1.0f, (currentOcclusion + currentObstruction) * 20.0f);
+
+        for (ma_uint32 i = 0; i < frames; i++) {
+            const float* pIn = &pFramesIn[(offset + i) * channels];
+            float* pOut = &pFramesOut[(offset + i) * channels];
+            float gain = currentGain + (targetGain - currentGain) * (i + 1) / frames;
+
+            for (ma_uint32 c = 0; c < channels; c++) {
+                float& pole1 = filterState[c * 2 + 0];
+                float& pole2 = filterState[c * 2 + 1];
+                pole1 = FlushDenormal(pole1 + (pIn[c] - pole1) * coefficient);
+                pole2 = FlushDenormal(pole2 + (pole1 - pole2) * coefficient);
+                pOut[c] = (pIn[c] + (pole2 - pIn[c]) * wet) * gain;
+            }
+        }
+
+        currentGain = targetGain;
+    }
+}
\ No newline at end of file
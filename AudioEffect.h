@@ -0,0 +1,274 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+#include <vector>
+
+class EffectChain;
+
+// Base class for DSP effects that live as nodes in the engine's node graph.
+//
+// Parameters are written from the game thread into atomics and picked up by the
+// audio thread at the start of the next processing block, so changing a value
+// never allocates or locks on the audio thread. Derived classes allocate all of
+// their state in the constructor and must call UninitNode() first thing in
+// their destructor so the audio thread stops calling Process() before their
+// members are destroyed.
+class AudioEffect {
+public:
+    AudioEffect();
+    virtual ~AudioEffect();
+
+    bool IsInitialized() const;
+
+    // Bypassed effects pass their input through untouched
+    void SetBypassed(bool bypass);
+    bool IsBypassed() const;
+
+    // True while the effect is inserted into an effect chain
+    bool IsAttached() const;
+
+    // Dynamics effects report how far they are currently turning the signal down, in dB
+    virtual float GetGainReduction() const { return 0.0f; }
+
+    ma_node* GetNode();
+
+protected:
+    // Creates the node with the given number of input and output buses. Output
+    // buses past the first carry copies of the first (sends).
+    bool InitNode(ma_uint32 inputBusCount = 1, ma_uint32 outputBusCount = 1);
+    void UninitNode();
+
+    // Tells the audio thread to call ApplyParameters() before the next block
+    void MarkParametersDirty();
+
+    // Called on the audio thread when parameters changed since the last block
+    virtual void ApplyParameters() {}
+
+    // Called on the audio thread. ppFramesIn has one interleaved buffer per input bus.
+    virtual void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) = 0;
+
+    ma_engine* engine;
+    ma_uint32 channels;
+    ma_uint32 sampleRate;
+
+private:
+    friend class EffectChain;
+
+    static void ProcessNode(ma_node* pNode, const float** ppFramesIn, ma_uint32* pFrameCountIn,
+        float** ppFramesOut, ma_uint32* pFrameCountOut);
+    static const ma_node_vtable NodeVTable;
+
+    struct EffectNode {
+        ma_node_base base;
+        AudioEffect* effect;
+    };
+
+    EffectNode node;
+    bool initialized;
+    std::atomic<bool> bypassed;
+    std::atomic<ma_uint32> parameterVersion;
+    ma_uint32 appliedParameterVersion;
+    EffectChain* chain;
+};
+
+// Biquad/Butterworth low-pass filter
+class LowPassEffect : public AudioEffect {
+public:
+    LowPassEffect(float cutoffHz, ma_uint32 order = 2);
+    ~LowPassEffect() override;
+
+    void SetCutoff(float cutoffHz);
+    float GetCutoff() const;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    ma_lpf filter;
+    ma_uint32 order;
+    bool filterInitialized;
+    std::atomic<float> cutoff;
+};
+
+// Butterworth high-pass filter
+class HighPassEffect : public AudioEffect {
+public:
+    HighPassEffect(float cutoffHz, ma_uint32 order = 2);
+    ~HighPassEffect() override;
+
+    void SetCutoff(float cutoffHz);
+    float GetCutoff() const;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    ma_hpf filter;
+    ma_uint32 order;
+    bool filterInitialized;
+    std::atomic<float> cutoff;
+};
+
+// Feedback delay (echo). The delay line is sized for maxDelaySeconds up front
+// so the delay time can be changed at runtime.
+class DelayEffect : public AudioEffect {
+public:
+    DelayEffect(float delaySeconds, float feedback = 0.5f, float wet = 0.5f, float maxDelaySeconds = 2.0f);
+    ~DelayEffect() override;
+
+    void SetDelay(float delaySeconds);
+    float GetDelay() const;
+    void SetFeedback(float feedback); // 0.0 to 0.95
+    float GetFeedback() const;
+    void SetWet(float wet);           // 0.0 (dry) to 1.0 (wet)
+    float GetWet() const;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    std::vector<float> buffer;
+    ma_uint32 bufferFrames;
+    ma_uint32 writeIndex;
+    float maxDelaySeconds;
+    std::atomic<float> delaySeconds;
+    std::atomic<float> feedback;
+    std::atomic<float> wet;
+};
+
+// Parametric EQ: a low shelf, a fixed number of peaking bands and a high shelf
+class EqualizerEffect : public AudioEffect {
+public:
+    explicit EqualizerEffect(ma_uint32 peakBandCount = 3);
+    ~EqualizerEffect() override;
+
+    void SetLowShelf(float frequencyHz, float gainDb);
+    void SetHighShelf(float frequencyHz, float gainDb);
+    void SetBand(ma_uint32 band, float frequencyHz, float gainDb, float q = 1.0f);
+    ma_uint32 GetBandCount() const;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    struct BandParameters {
+        std::atomic<float> frequency;
+        std::atomic<float> gainDb;
+        std::atomic<float> q;
+    };
+
+    ma_loshelf2 lowShelf;
+    ma_hishelf2 highShelf;
+    std::vector<ma_peak2> peaks;
+    ma_uint32 initializedPeaks;
+    bool shelvesInitialized;
+
+    BandParameters lowShelfParams;
+    BandParameters highShelfParams;
+    std::vector<BandParameters> bandParams;
+};
+
+// Schroeder/Moorer style algorithmic reverb (parallel combs into series allpasses)
+class ReverbEffect : public AudioEffect {
+public:
+    ReverbEffect(float roomSize = 0.5f, float damping = 0.5f, float wet = 0.3f);
+    ~ReverbEffect() override;
+
+    void SetRoomSize(float roomSize); // 0.0 to 1.0
+    float GetRoomSize() const;
+    void SetDamping(float damping);   // 0.0 to 1.0
+    float GetDamping() const;
+    void SetWet(float wet);           // 0.0 (dry) to 1.0 (wet)
+    float GetWet() const;
+    void SetWidth(float width);       // 0.0 (mono) to 1.0 (full stereo)
+    float GetWidth() const;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    static const ma_uint32 CombCount = 8;
+    static const ma_uint32 AllpassCount = 4;
+
+    struct Comb {
+        std::vector<float> buffer;
+        ma_uint32 index;
+        float store;
+    };
+
+    struct Allpass {
+        std::vector<float> buffer;
+        ma_uint32 index;
+    };
+
+    // Per output channel
+    std::vector<Comb> combs;
+    std::vector<Allpass> allpasses;
+
+    std::atomic<float> roomSize;
+    std::atomic<float> damping;
+    std::atomic<float> wet;
+    std::atomic<float> width;
+
+    // Derived on the audio thread by ApplyParameters()
+    float combFeedback;
+    float combDamping;
+    float wetGain1;
+    float wetGain2;
+    float dryGain;
+};
+
+// How strongly occlusion and obstruction darken and attenuate a sound when fully applied
+struct OcclusionSettings {
+    float occlusionGain = 0.3f;         // Wall between sound and listener
+    float occlusionCutoff = 600.0f;     // Hz
+    float obstructionGain = 0.7f;       // Direct path blocked, sound still leaks around
+    float obstructionCutoff = 2000.0f;  // Hz
+    float smoothingTime = 0.08f;        // Seconds to settle after a change
+};
+
+// Per-voice occlusion/obstruction: a 2-pole low-pass and gain driven by two 0..1
+// amounts. Targets can be set from any thread; the audio thread eases towards
+// them in small sub-blocks so raycast results arriving once per frame never click.
+class OcclusionEffect : public AudioEffect {
+public:
+    explicit OcclusionEffect(const OcclusionSettings& settings = OcclusionSettings());
+    ~OcclusionEffect() override;
+
+    void SetOcclusion(float occlusion);     // 0.0 (clear) to 1.0 (fully occluded)
+    float GetOcclusion() const;
+    void SetObstruction(float obstruction); // 0.0 (clear) to 1.0 (fully obstructed)
+    float GetObstruction() const;
+
+    void SetSettings(const OcclusionSettings& settings);
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    static const ma_uint32 SubBlockFrames = 32;
+
+    std::atomic<float> occlusion;
+    std::atomic<float> obstruction;
+    std::atomic<float> occlusionGain;
+    std::atomic<float> occlusionCutoff;
+    std::atomic<float> obstructionGain;
+    std::atomic<float> obstructionCutoff;
+    std::atomic<float> smoothingTime;
+    std::atomic<bool> snapToTarget;
+
+    // Audio thread state
+    std::vector<float> filterState;     // Two poles per channel
+    float currentOcclusion;
+    float currentObstruction;
+    float currentGain;
+    float smoothing;
+    float maxCutoff;
+};
\ No newline at end of file
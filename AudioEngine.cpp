@@ -4,12 +4,52 @@
 #include "AudioEngine.h"
 #include "Sound.h"
 #include "Music.h"
+#include "AudioBus.h"
+#include "Hrtf.h"
+#include "Loudness.h"
+#include "ParallelMixer.h"
+#include "PcmCache.h"
+#include "LatencyProbe.h"
+#include "OutputEndpoint.h"
+#include "Microphone.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 
 AudioEngine::AudioEngine()
-    : pPlaybackDeviceInfos(nullptr)
-    , playbackDeviceCount(0)
+    : renderDevice(nullptr)
+    , renderersInside(0)
     , masterVolume(1.0f)
+    , loudnessNormalization(false)
+    , loudnessTarget(-23.0f)
+    , autoDecodeSeconds(5.0f)
+    , autoCompressedBytes(16 * 1024 * 1024)
+    , occlusionBusy(false)
+    , occlusionReady(false)
+    , occlusionStop(false)
+    , parallelMixing(false)
+    , parallelWorkerCount(0)
+    , pcmCache(new PcmCache())
+    , latencyProbe(nullptr)
     , initialized(false)
+    , deviceStopExpected(false)
+    , deviceLost(false)
+    , rerouteStage(RerouteIdle)
+    , rerouteType(DeviceChangeEvent::Type::Rerouted)
+    , lastRenderTicks(0)
+    , rerouteFromTicks(0)
+    , rerouteGlitchTicks(0)
+    , deviceRetryTimer(0.0f)
+    , deviceListVersion(0)
+    , reportedDeviceListVersion(0)
+    , deviceRefreshRequested(false)
+    , deviceWorkerStop(false)
+    , deviceLostReported(false)
+    , deviceReroutes(0)
+    , lastRerouteGlitchMs(0.0f)
+    , maxRerouteGlitchMs(0.0f)
 {
     // Initialize default category volumes
     categoryVolumes[AudioCategory::SFX] = 1.0f;
@@ -22,45 +62,118 @@ AudioEngine::AudioEngine()
     categoryMuted[AudioCategory::MUSIC] = false;
     categoryMuted[AudioCategory::VOICE] = false;
     categoryMuted[AudioCategory::AMBIENT] = false;
+
+    // Initialize spatialization modes
+    categorySpatialization[AudioCategory::SFX] = SpatializationMode::Panner;
+    categorySpatialization[AudioCategory::MUSIC] = SpatializationMode::Panner;
+    categorySpatialization[AudioCategory::VOICE] = SpatializationMode::Panner;
+    categorySpatialization[AudioCategory::AMBIENT] = SpatializationMode::Panner;
+
+    // Pitch-randomized effects and dialogue get the clean resampler
+    categoryResamplerQuality[AudioCategory::SFX] = ResamplerQuality::Sinc;
+    categoryResamplerQuality[AudioCategory::MUSIC] = ResamplerQuality::Linear;
+    categoryResamplerQuality[AudioCategory::VOICE] = ResamplerQuality::Sinc;
+    categoryResamplerQuality[AudioCategory::AMBIENT] = ResamplerQuality::Linear;
 }
 
 AudioEngine::~AudioEngine() {
     Shutdown();
 }
 
-bool AudioEngine::Initialize() {
+bool AudioEngine::Initialize(const AudioEngineConfig& engineSettings) {
     if (initialized) {
         return true;
     }
 
+    config = engineSettings;
+    parallelMixing = config.parallelMixing;
+    parallelWorkerCount = config.mixWorkerCount;
+
     // Initialize miniaudio context for device enumeration
-    ma_result result = ma_context_init(nullptr, 0, nullptr, &context);
+    const ma_backend nullBackend = ma_backend_null;
+    ma_result result = config.nullDevice
+        ? ma_context_init(&nullBackend, 1, nullptr, &context)
+        : ma_context_init(nullptr, 0, nullptr, &context);
     if (result != MA_SUCCESS) {
         return false;
     }
 
-    // Enumerate playback devices
-    result = ma_context_get_devices(&context, &pPlaybackDeviceInfos, &playbackDeviceCount, nullptr, nullptr);
-    if (result != MA_SUCCESS) {
+    // Enumerate devices; the worker keeps the lists current from here on
+    std::vector<ma_device_info> devices;
+    std::vector<ma_device_info> inputs;
+    if (!EnumerateDevices(devices, inputs)) {
         ma_context_uninit(&context);
         return false;
     }
+    {
+        std::lock_guard<std::mutex> lock(deviceListMutex);
+        playbackDevices = devices;
+        captureDevices = inputs;
+        deviceListVersion++;
+    }
 
-    // Set the default device
-    if (playbackDeviceCount > 0) {
-        currentDevice = pPlaybackDeviceInfos[0].name;
+    deviceStopExpected = false;
+    deviceLost = false;
+    rerouteStage = RerouteIdle;
+    device = OpenDevice(nullptr, config.sampleRate, config.channels);
+    if (!device) {
+        ma_context_uninit(&context);
+        return false;
+    }
+    renderDevice.store(device.get());
+
+    // Without job threads the resource manager only moves when ProcessJobs() is called.
+    // Synchronous loads run their own jobs inline on the loading thread. Unlike
+    // NO_THREADING, NON_BLOCKING keeps the resource manager's locks, which the audio
+    // thread and whichever thread calls ProcessJobs() both need. Decoding matches what
+    // ma_engine_init() would set up itself: engine rate, each file's own channels.
+    if (config.hostResourceJobs) {
+        ma_resource_manager_config resourceConfig = ma_resource_manager_config_init();
+        resourceConfig.decodedFormat = ma_format_f32;
+        resourceConfig.decodedChannels = 0;
+        resourceConfig.decodedSampleRate = device->sampleRate;
+        resourceConfig.jobThreadCount = 0;
+        resourceConfig.flags = MA_RESOURCE_MANAGER_FLAG_NON_BLOCKING;
+
+        result = ma_resource_manager_init(&resourceConfig, &resourceManager);
+        if (result != MA_SUCCESS) {
+            ma_device_uninit(device.get());
+            renderDevice.store(nullptr);
+            device.reset();
+            ma_context_uninit(&context);
+            return false;
+        }
     }
 
     // Initialize the engine
     ma_engine_config engineConfig = ma_engine_config_init();
-    engineConfig.listenerCount = 1;
+    engineConfig.listenerCount = std::max<ma_uint32>(1, std::min<ma_uint32>(config.listenerCount, MA_ENGINE_MAX_LISTENERS));
+    engineConfig.pDevice = device.get();
+    engineConfig.pResourceManager = config.hostResourceJobs ? &resourceManager : nullptr;
 
     result = ma_engine_init(&engineConfig, &engine);
     if (result != MA_SUCCESS) {
+        ma_device_uninit(device.get());
+        renderDevice.store(nullptr);
+        device.reset();
+        if (config.hostResourceJobs) {
+            ma_resource_manager_uninit(&resourceManager);
+        }
         ma_context_uninit(&context);
         return false;
     }
 
+    // Imports must match the rate streams are decoded at, so a sound can switch between them
+    ma_resource_manager* engineResources = ma_engine_get_resource_manager(&engine);
+    pcmCache->SetResourceManager(engineResources, engineResources->config.decodedSampleRate, config.cacheDirectory);
+    pcmCache->SetBudget(config.pcmCacheBudget);
+
+    CreateBuses();
+
+    currentDevice = device->playback.name;
+    deviceWorkerStop = false;
+    deviceWorker = std::thread(&AudioEngine::DeviceWorkerLoop, this);
+
     initialized = true;
     return true;
 }
@@ -72,20 +185,56 @@ void AudioEngine::Shutdown() {
 
     // Stop all sounds
     StopAll();
+    StopOcclusionWorker();
+    StopDeviceWorker();
+
+    // The recorder's tap sits on the master bus, the microphone's voice on its category bus
+    masterRecorder.reset();
+    microphone.reset();
+
+    // Endpoints read bus subgraphs, so they close before the buses go
+    outputEndpoints.clear();
+    categoryOutputs.clear();
 
     // Uninitialize the engine
+    DestroyBuses();
+    pcmCache->SetResourceManager(nullptr);
+    deviceStopExpected = true;
     ma_engine_uninit(&engine);
+    ma_device_uninit(device.get());
+    renderDevice.store(nullptr);
+    device.reset();
+    if (config.hostResourceJobs) {
+        ma_resource_manager_uninit(&resourceManager);
+    }
     ma_context_uninit(&context);
 
     initialized = false;
 }
 
-std::shared_ptr<Sound> AudioEngine::LoadSound(const std::string& filePath) {
+std::shared_ptr<Sound> AudioEngine::LoadSound(const std::string& filePath, LoadPolicy policy) {
+    if (!initialized) {
+        return nullptr;
+    }
+
+    std::shared_ptr<Sound> sound = std::make_shared<Sound>(filePath, policy);
+    if (sound->IsLoaded()) {
+        float lufs;
+        if (loudnessNormalization && MeasureLoudness(filePath, lufs)) {
+            sound->SetLoudness(lufs);
+        }
+        return sound;
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<Sound> AudioEngine::CreateSound(const std::string& name, std::shared_ptr<ProceduralSource> source) {
     if (!initialized) {
         return nullptr;
     }
 
-    std::shared_ptr<Sound> sound = std::make_shared<Sound>(filePath);
+    std::shared_ptr<Sound> sound = std::make_shared<Sound>(name, source);
     if (sound->IsLoaded()) {
         return sound;
     }
@@ -93,19 +242,126 @@ std::shared_ptr<Sound> AudioEngine::LoadSound(const std::string& filePath) {
     return nullptr;
 }
 
-std::shared_ptr<Music> AudioEngine::LoadMusic(const std::string& filePath) {
+std::shared_ptr<Music> AudioEngine::LoadMusic(const std::string& filePath, LoadPolicy policy) {
     if (!initialized) {
         return nullptr;
     }
 
-    std::shared_ptr<Music> music = std::make_shared<Music>(filePath);
+    std::shared_ptr<Music> music = std::make_shared<Music>(filePath, policy);
     if (music->IsLoaded()) {
+        float lufs;
+        if (loudnessNormalization && MeasureLoudness(filePath, lufs)) {
+            music->SetLoudness(lufs);
+        }
         return music;
     }
 
     return nullptr;
 }
 
+void AudioEngine::SetAutoLoadPolicyLimits(float maxDecodeSeconds, size_t maxCompressedBytes) {
+    autoDecodeSeconds = std::max(0.0f, maxDecodeSeconds);
+    autoCompressedBytes = maxCompressedBytes;
+    chosenLoadPolicies.clear();
+}
+
+LoadPolicy AudioEngine::ChooseLoadPolicy(const std::string& filePath) {
+    auto it = chosenLoadPolicies.find(filePath);
+    if (it != chosenLoadPolicies.end()) {
+        return it->second;
+    }
+
+    // Opening a decoder only parses headers (MP3 scans frame headers for the length)
+    ma_decoder_config decoderConfig = ma_decoder_config_init(ma_format_f32, 0, 0);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filePath.c_str(), &decoderConfig, &decoder) != MA_SUCCESS) {
+        return LoadPolicy::Decode;
+    }
+
+    ma_uint32 channels = 0;
+    ma_uint32 sampleRate = 0;
+    ma_uint64 length = 0;
+    ma_decoder_get_data_format(&decoder, NULL, &channels, &sampleRate, NULL, 0);
+    ma_decoder_get_length_in_pcm_frames(&decoder, &length);
+
+    ma_uint64 fileBytes = 0;
+    ma_default_vfs vfs;
+    ma_vfs_file file;
+    ma_default_vfs_init(&vfs, NULL);
+    if (ma_vfs_open(&vfs, filePath.c_str(), MA_OPEN_MODE_READ, &file) == MA_SUCCESS) {
+        ma_file_info info;
+        if (ma_vfs_info(&vfs, file, &info) == MA_SUCCESS) {
+            fileBytes = info.sizeInBytes;
+        }
+        ma_vfs_close(&vfs, file);
+    }
+    ma_decoder_uninit(&decoder);
+
+    // Unknown lengths (some streams report 0) are treated as long
+    const float seconds = (length > 0 && sampleRate > 0) ? static_cast<float>(length) / sampleRate : -1.0f;
+    const ma_uint64 decodedBytes = length * channels * sizeof(float);
+
+    LoadPolicy policy = LoadPolicy::Stream;
+    if (seconds >= 0.0f && seconds <= autoDecodeSeconds) {
+        policy = LoadPolicy::Decode;
+    }
+    else if (fileBytes > 0 && fileBytes <= autoCompressedBytes && fileBytes * 2 <= decodedBytes) {
+        policy = LoadPolicy::CompressedInMemory;
+    }
+
+    chosenLoadPolicies[filePath] = policy;
+    return policy;
+}
+
+bool AudioEngine::MeasureLoudness(const std::string& filePath, float& lufs) {
+    auto it = measuredLoudness.find(filePath);
+    if (it != measuredLoudness.end()) {
+        lufs = it->second;
+        return true;
+    }
+
+    // Decodes the whole file on first sight of an asset, then reads the sidecar
+    if (!LoudnessMeter::GetFileLoudness(filePath, config.cacheDirectory, lufs)) {
+        return false;
+    }
+
+    measuredLoudness[filePath] = lufs;
+    return true;
+}
+
+void AudioEngine::SetLoudnessNormalization(bool enabled, float targetLufs) {
+    loudnessNormalization = enabled;
+    loudnessTarget = targetLufs;
+
+    std::lock_guard<std::mutex> lock(soundMutex);
+    for (auto sound : activeSounds) {
+        sound->UpdateVolume();
+    }
+
+    std::lock_guard<std::mutex> lockMusic(musicMutex);
+    for (auto music : activeMusic) {
+        music->UpdateVolume();
+    }
+}
+
+bool AudioEngine::IsLoudnessNormalizationEnabled() const {
+    return loudnessNormalization;
+}
+
+float AudioEngine::GetLoudnessTarget() const {
+    return loudnessTarget;
+}
+
+float AudioEngine::GetLoudnessGain(float lufs) const {
+    if (!loudnessNormalization) {
+        return 1.0f;
+    }
+
+    // Don't boost quiet assets by more than 12dB, which would mostly raise their noise floor
+    float gainDb = std::max(-40.0f, std::min(loudnessTarget - lufs, 12.0f));
+    return std::pow(10.0f, gainDb / 20.0f);
+}
+
 void AudioEngine::SetMasterVolume(float volume) {
     masterVolume = std::max(0.0f, std::min(volume, 1.0f));
     ma_engine_set_volume(&engine, masterVolume);
@@ -225,116 +481,1329 @@ void AudioEngine::StopAll() {
 std::vector<std::string> AudioEngine::GetAudioDevices() const {
     std::vector<std::string> devices;
 
-    for (ma_uint32 i = 0; i < playbackDeviceCount; i++) {
-        devices.push_back(pPlaybackDeviceInfos[i].name);
+    std::lock_guard<std::mutex> lock(deviceListMutex);
+    for (const auto& info : playbackDevices) {
+        devices.push_back(info.name);
+    }
+
+    return devices;
+}
+
+std::vector<std::string> AudioEngine::GetCaptureDevices() const {
+    std::vector<std::string> devices;
+
+    std::lock_guard<std::mutex> lock(deviceListMutex);
+    for (const auto& info : captureDevices) {
+        devices.push_back(info.name);
     }
 
     return devices;
 }
 
+std::string AudioEngine::GetDefaultAudioDevice() const {
+    std::lock_guard<std::mutex> lock(deviceListMutex);
+    for (const auto& info : playbackDevices) {
+        if (info.isDefault) {
+            return info.name;
+        }
+    }
+    return playbackDevices.empty() ? std::string() : playbackDevices.front().name;
+}
+
+ma_uint32 AudioEngine::GetAudioDeviceListVersion() const {
+    std::lock_guard<std::mutex> lock(deviceListMutex);
+    return deviceListVersion;
+}
+
+void AudioEngine::RefreshAudioDevices() {
+    {
+        std::lock_guard<std::mutex> lock(deviceListMutex);
+        deviceRefreshRequested = true;
+    }
+    deviceListCondition.notify_one();
+}
+
+void AudioEngine::SetDeviceListCallback(DeviceListCallback callback) {
+    deviceListCallback = callback;
+}
+
 bool AudioEngine::SetAudioDevice(const std::string& deviceName) {
     if (!initialized) {
         return false;
     }
 
-    // Find the device
-    for (ma_uint32 i = 0; i < playbackDeviceCount; i++) {
-        if (deviceName == pPlaybackDeviceInfos[i].name) {
-            // Stop all current sounds
-            StopAll();
-
-            // Uninitialize the engine
-            ma_engine_uninit(&engine);
-
-            // Create a new engine with the selected device
-            ma_engine_config engineConfig = ma_engine_config_init();
-            engineConfig.pPlaybackDeviceID = &pPlaybackDeviceInfos[i].id;
+    ma_device_id deviceId;
+    if (!FindDevice(deviceName, deviceId) || !SwitchDevice(&deviceId, false)) {
+        return false;
+    }
 
-            ma_result result = ma_engine_init(&engineConfig, &engine);
-            if (result != MA_SUCCESS) {
-                // Try to reinitialize with the default device
-                engineConfig.pPlaybackDeviceID = nullptr;
-                result = ma_engine_init(&engineConfig, &engine);
-                if (result != MA_SUCCESS) {
-                    return false;
-                }
-            }
+    currentDevice = deviceName;
+    return true;
+}
 
-            // Set the master volume
-            ma_engine_set_volume(&engine, masterVolume);
+std::string AudioEngine::GetCurrentDevice() const {
+    return currentDevice;
+}
 
-            currentDevice = deviceName;
+bool AudioEngine::FindDevice(const std::string& deviceName, ma_device_id& deviceId, bool capture) const {
+    std::lock_guard<std::mutex> lock(deviceListMutex);
+    for (const auto& info : capture ? captureDevices : playbackDevices) {
+        if (deviceName == info.name) {
+            deviceId = info.id;
             return true;
         }
     }
-
     return false;
 }
 
-std::string AudioEngine::GetCurrentDevice() const {
-    return currentDevice;
+AudioDeviceLatency AudioEngine::GetDeviceLatency() const {
+    AudioDeviceLatency latency;
+    if (!initialized) {
+        return latency;
+    }
+
+    // The backend's side of the device, after any rounding it did
+    latency.sampleRate = device->playback.internalSampleRate;
+    latency.channels = device->playback.internalChannels;
+    latency.periodSizeInFrames = device->playback.internalPeriodSizeInFrames;
+    latency.periods = device->playback.internalPeriods;
+    if (latency.sampleRate > 0) {
+        latency.periodMs = 1000.0f * latency.periodSizeInFrames / latency.sampleRate;
+        latency.bufferMs = latency.periodMs * latency.periods;
+    }
+    return latency;
 }
 
-void AudioEngine::RegisterSound(Sound* sound) {
-    if (!sound) return;
+ma_device_config AudioEngine::GetDeviceConfig(const ma_device_id* deviceId, ma_uint32 sampleRate, ma_uint32 channels) const {
+    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_playback);
+    deviceConfig.playback.pDeviceID = deviceId;
+    deviceConfig.playback.format = ma_format_f32;
+    deviceConfig.playback.channels = channels;
+    deviceConfig.sampleRate = sampleRate;
+    deviceConfig.periodSizeInFrames = config.periodSizeInFrames;
+    deviceConfig.periodSizeInMilliseconds = config.periodSizeInMilliseconds;
+    deviceConfig.periods = config.periods;
+    deviceConfig.performanceProfile = config.performanceProfile;
+    return deviceConfig;
+}
 
-    std::lock_guard<std::mutex> lock(soundMutex);
-    activeSounds.push_back(sound);
+std::unique_ptr<ma_device> AudioEngine::OpenDevice(const ma_device_id* deviceId, ma_uint32 sampleRate, ma_uint32 channels) {
+    ma_device_config deviceConfig = GetDeviceConfig(deviceId, sampleRate, channels);
+    deviceConfig.dataCallback = &AudioEngine::DeviceDataCallback;
+    deviceConfig.notificationCallback = &AudioEngine::DeviceNotificationCallback;
+    deviceConfig.pUserData = this;
+    deviceConfig.noPreSilencedOutputBuffer = MA_TRUE;  // The engine writes every frame
+    deviceConfig.noClip = MA_TRUE;                     // As ma_engine sets up its own device
+
+    std::unique_ptr<ma_device> newDevice(new ma_device);
+    if (ma_device_init(&context, &deviceConfig, newDevice.get()) != MA_SUCCESS) {
+        return nullptr;
+    }
+    return newDevice;
 }
 
-void AudioEngine::UnregisterSound(Sound* sound) {
-    if (!sound) return;
+bool AudioEngine::SwitchDevice(const ma_device_id* deviceId, bool start) {
+    // Opened at the engine's format, so nothing in the graph has to change
+    std::unique_ptr<ma_device> newDevice = OpenDevice(deviceId, ma_engine_get_sample_rate(&engine), ma_engine_get_channels(&engine));
+    if (!newDevice) {
+        return false;
+    }
 
-    std::lock_guard<std::mutex> lock(soundMutex);
-    auto it = std::find(activeSounds.begin(), activeSounds.end(), sound);
-    if (it != activeSounds.end()) {
-        activeSounds.erase(it);
+    // The new device plays silence until it is swapped in, so starting it first means
+    // the outputs overlap rather than leave a gap
+    const bool running = start || ma_device_get_state(device.get()) == ma_device_state_started;
+    if (running && ma_device_start(newDevice.get()) != MA_SUCCESS) {
+        ma_device_uninit(newDevice.get());
+        return false;
+    }
+
+    // Neither device mixes until a callback already mixing on the old one is done;
+    // the gap is at most one period, and nothing spins on the audio threads
+    renderDevice.store(nullptr);
+    while (renderersInside.load() != 0) {
+        std::this_thread::yield();
     }
+    device.swap(newDevice);
+    engine.pDevice = device.get();
+    renderDevice.store(device.get());
+
+    // Waits for any callback still running on the old device
+    ma_device_uninit(newDevice.get());
+    return true;
 }
 
-void AudioEngine::RegisterMusic(Music* music) {
-    if (!music) return;
+void AudioEngine::DeviceDataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+    (void)pInput;
 
-    std::lock_guard<std::mutex> lock(musicMutex);
-    activeMusic.push_back(music);
+    AudioEngine* self = static_cast<AudioEngine*>(pDevice->pUserData);
+    const long long now = std::chrono::steady_clock::now().time_since_epoch().count();
+
+    // Only the current device mixes; during a switch the other one outputs silence.
+    // Counted in before checking, so SwitchDevice() sees this callback or it sees the swap.
+    self->renderersInside.fetch_add(1);
+    if (pDevice != self->renderDevice.load()) {
+        self->renderersInside.fetch_sub(1, std::memory_order_release);
+        ma_silence_pcm_frames(pOutput, frameCount, ma_format_f32, pDevice->playback.channels);
+        return;
+    }
+
+    // First period on a new route: anything beyond the usual spacing was a gap
+    if (self->rerouteStage.load(std::memory_order_acquire) == RerouteWaiting) {
+        const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(frameCount) / pDevice->sampleRate));
+        const long long gap = now - self->rerouteFromTicks.load(std::memory_order_relaxed) - period.count();
+        self->rerouteGlitchTicks.store(std::max(0LL, gap), std::memory_order_relaxed);
+        self->rerouteStage.store(RerouteMeasured, std::memory_order_release);
+    }
+    self->lastRenderTicks.store(now, std::memory_order_relaxed);
+
+    ma_engine_read_pcm_frames(&self->engine, pOutput, frameCount, NULL);
+
+    if (LatencyProbe* probe = self->latencyProbe.load(std::memory_order_acquire)) {
+        probe->Process(static_cast<const float*>(pOutput), frameCount, pDevice->playback.channels, pDevice->sampleRate);
+    }
+    self->renderersInside.fetch_sub(1, std::memory_order_release);
 }
 
-void AudioEngine::UnregisterMusic(Music* music) {
-    if (!music) return;
+void AudioEngine::DeviceNotificationCallback(const ma_device_notification* pNotification) {
+    AudioEngine* self = static_cast<AudioEngine*>(pNotification->pDevice->pUserData);
 
-    std::lock_guard<std::mutex> lock(musicMutex);
-    auto it = std::find(activeMusic.begin(), activeMusic.end(), music);
-    if (it != activeMusic.end()) {
-        activeMusic.erase(it);
+    switch (pNotification->type) {
+    case ma_device_notification_type_rerouted:
+        self->BeginReroute(DeviceChangeEvent::Type::Rerouted);
+        break;
+
+    case ma_device_notification_type_stopped: {
+        // Shutting down, or the old device of a switch
+        const bool current = (pNotification->pDevice == self->renderDevice.load());
+        if (!current || self->deviceStopExpected.load()) {
+            break;
+        }
+
+        // Lost (unplugged, disabled); Update() moves to the default device
+        self->BeginReroute(DeviceChangeEvent::Type::Recovered);
+        self->deviceLost.store(true, std::memory_order_release);
+        break;
+    }
+
+    default:
+        break;
     }
 }
 
-void AudioEngine::SetListenerPosition(float x, float y, float z) {
-    ma_engine_listener_set_position(&engine, 0, x, y, z);
+void AudioEngine::BeginReroute(DeviceChangeEvent::Type type) {
+    rerouteType.store(type, std::memory_order_relaxed);
+    rerouteFromTicks.store(lastRenderTicks.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    rerouteStage.store(RerouteWaiting, std::memory_order_release);
+}
+
+void AudioEngine::UpdateDevice(float deltaTime) {
+    if (!initialized) {
+        return;
+    }
+
+    if (deviceListCallback) {
+        std::vector<std::string> devices;
+        ma_uint32 version = 0;
+        {
+            std::lock_guard<std::mutex> lock(deviceListMutex);
+            version = deviceListVersion;
+            if (version != reportedDeviceListVersion) {
+                for (const auto& info : playbackDevices) {
+                    devices.push_back(info.name);
+                }
+            }
+        }
+        if (version != reportedDeviceListVersion) {
+            reportedDeviceListVersion = version;
+            deviceListCallback(devices, version);
+        }
+    }
+
+    if (deviceLost.load(std::memory_order_acquire)) {
+        deviceRetryTimer -= deltaTime;
+        if (deviceRetryTimer > 0.0f) {
+            return;
+        }
+
+        // The device list has changed too
+        RefreshAudioDevices();
+        if (!SwitchDevice(nullptr, true)) {
+            if (!deviceLostReported && deviceChangeCallback) {
+                DeviceChangeEvent event;
+                event.type = DeviceChangeEvent::Type::Lost;
+                deviceChangeCallback(event);
+            }
+            deviceLostReported = true;
+            deviceRetryTimer = 1.0f;
+            return;
+        }
+        deviceLost = false;
+        deviceLostReported = false;
+        deviceRetryTimer = 0.0f;
+    }
+
+    if (rerouteStage.load(std::memory_order_acquire) != RerouteMeasured) {
+        return;
+    }
+    rerouteStage.store(RerouteIdle, std::memory_order_relaxed);
+
+    DeviceChangeEvent event;
+    event.type = rerouteType.load(std::memory_order_relaxed);
+    event.deviceName = device->playback.name;
+    event.glitchMs = std::chrono::duration<float, std::milli>(
+        std::chrono::steady_clock::duration(rerouteGlitchTicks.load(std::memory_order_relaxed))).count();
+
+    currentDevice = event.deviceName;
+    deviceReroutes++;
+    lastRerouteGlitchMs = event.glitchMs;
+    maxRerouteGlitchMs = std::max(maxRerouteGlitchMs, event.glitchMs);
+
+    if (deviceChangeCallback) {
+        deviceChangeCallback(event);
+    }
 }
 
-void AudioEngine::SetListenerDirection(float x, float y, float z) {
-    ma_engine_listener_set_direction(&engine, 0, x, y, z);
+bool AudioEngine::EnumerateDevices(std::vector<ma_device_info>& devices, std::vector<ma_device_info>& inputs) {
+    // The context's list is overwritten by the next enumeration, so only one thread
+    // (Initialize, then the worker) calls this at a time
+    ma_device_info* pInfos = nullptr;
+    ma_uint32 count = 0;
+    ma_device_info* pInputInfos = nullptr;
+    ma_uint32 inputCount = 0;
+    if (ma_context_get_devices(&context, &pInfos, &count, &pInputInfos, &inputCount) != MA_SUCCESS) {
+        return false;
+    }
+
+    devices.assign(pInfos, pInfos + count);
+    inputs.assign(pInputInfos, pInputInfos + inputCount);
+    return true;
 }
 
-void AudioEngine::SetListenerVelocity(float x, float y, float z) {
-    ma_engine_listener_set_velocity(&engine, 0, x, y, z);
+static bool SameDeviceList(const std::vector<ma_device_info>& a, const std::vector<ma_device_info>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::strcmp(a[i].name, b[i].name) != 0 || a[i].isDefault != b[i].isDefault
+            || std::memcmp(&a[i].id, &b[i].id, sizeof(ma_device_id)) != 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
-void AudioEngine::SetListenerWorldUp(float x, float y, float z) {
-    ma_engine_listener_set_world_up(&engine, 0, x, y, z);
+void AudioEngine::StopDeviceWorker() {
+    if (!deviceWorker.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(deviceListMutex);
+        deviceWorkerStop = true;
+    }
+    deviceListCondition.notify_one();
+    deviceWorker.join();
 }
 
-void AudioEngine::Update(float deltaTime) {
-    // Clean up any finished sounds
-    std::lock_guard<std::mutex> lock(soundMutex);
-    auto soundIt = activeSounds.begin();
-    while (soundIt != activeSounds.end()) {
-        if (!(*soundIt)->IsPlaying()) {
-            soundIt = activeSounds.erase(soundIt);
+void AudioEngine::DeviceWorkerLoop() {
+    const auto interval = std::chrono::duration<float>(config.deviceRefreshInterval);
+    std::unique_lock<std::mutex> lock(deviceListMutex);
+
+    while (true) {
+        auto wake = [this] { return deviceWorkerStop || deviceRefreshRequested; };
+        if (config.deviceRefreshInterval > 0.0f) {
+            deviceListCondition.wait_for(lock, interval, wake);
         }
         else {
-            ++soundIt;
+            deviceListCondition.wait(lock, wake);
+        }
+        if (deviceWorkerStop) return;
+        deviceRefreshRequested = false;
+
+        // Enumerating can take a while on some backends; readers keep the old list meanwhile
+        lock.unlock();
+        std::vector<ma_device_info> devices;
+        std::vector<ma_device_info> inputs;
+        const bool enumerated = EnumerateDevices(devices, inputs);
+        lock.lock();
+
+        if (enumerated && (!SameDeviceList(devices, playbackDevices) || !SameDeviceList(inputs, captureDevices))) {
+            playbackDevices.swap(devices);
+            captureDevices.swap(inputs);
+            deviceListVersion++;
+        }
+    }
+}
+
+void AudioEngine::SetDeviceChangeCallback(DeviceChangeCallback callback) {
+    deviceChangeCallback = callback;
+}
+
+void AudioEngine::SetLatencyProbe(LatencyProbe* probe) {
+    latencyProbe.store(probe, std::memory_order_release);
+}
+
+EffectChain* AudioEngine::GetMasterEffects() {
+    if (!masterBus) {
+        return nullptr;
+    }
+    return &masterBus->GetEffects();
+}
+
+EffectChain* AudioEngine::GetBusEffects(AudioCategory category) {
+    auto it = categoryBuses.find(category);
+    if (it != categoryBuses.end()) {
+        return &it->second->GetEffects();
+    }
+    return nullptr;
+}
+
+bool AudioEngine::SetDucking(AudioCategory target, AudioCategory key, const DuckingSettings& settings) {
+    if (target == key) {
+        return false;
+    }
+
+    // The sidechain shares nodes, so both buses must be mixed by the same device
+    if (GetCategoryOutput(target) != GetCategoryOutput(key)) {
+        return false;
+    }
+
+    // Same key: just retune the existing ducker
+    auto it = duckingRoutes.find(target);
+    if (it != duckingRoutes.end() && it->second.key == key && it->second.ducker) {
+        it->second.settings = settings;
+        it->second.ducker->SetSettings(settings);
+        return true;
+    }
+
+    ClearDucking(target);
+
+    // Registered before connecting so the parallel mixer puts both buses in one
+    // job before they share nodes; connected once it has picked up the new groups
+    DuckingRoute& route = duckingRoutes[target];
+    route.key = key;
+    route.settings = settings;
+    UpdateMixGroups();
+    ApplyMixRouting();
+
+    // Dropped if connecting failed
+    return duckingRoutes.count(target) != 0;
+}
+
+void AudioEngine::ClearDucking(AudioCategory target) {
+    auto it = duckingRoutes.find(target);
+    if (it == duckingRoutes.end()) {
+        return;
+    }
+
+    DisconnectDucking(it->second, target);
+    duckingRoutes.erase(it);
+    UpdateMixGroups();
+}
+
+float AudioEngine::GetDuckingGainReduction(AudioCategory target) const {
+    auto it = duckingRoutes.find(target);
+    if (it != duckingRoutes.end() && it->second.ducker) {
+        return it->second.ducker->GetGainReduction();
+    }
+    return 0.0f;
+}
+
+bool AudioEngine::StartRecording(const std::string& filePath, RecordingFormat format) {
+    if (!initialized || !masterBus) {
+        return false;
+    }
+
+    if (!masterRecorder) {
+        auto recorder = std::make_unique<MixRecorder>();
+        if (!recorder->IsInitialized()) {
+            return false;
         }
+        masterRecorder = std::move(recorder);
+    }
+
+    // Last in the chain, so it hears every master effect (re-added if the chain was cleared)
+    std::shared_ptr<AudioEffect> tap = masterRecorder->GetTap();
+    if (!tap->IsAttached() && !masterBus->GetEffects().AddEffect(tap)) {
+        return false;
+    }
+    return masterRecorder->Start(filePath, format);
+}
+
+void AudioEngine::StopRecording() {
+    if (masterRecorder) {
+        masterRecorder->Stop();
+    }
+}
+
+bool AudioEngine::IsRecording() const {
+    return masterRecorder && masterRecorder->IsRecording();
+}
+
+MixRecorder::Stats AudioEngine::GetRecordingStats() const {
+    if (masterRecorder) {
+        return masterRecorder->GetStats();
+    }
+    return MixRecorder::Stats();
+}
+
+bool AudioEngine::StartMicrophone(const MicrophoneConfig& micConfig) {
+    if (!initialized) {
+        return false;
+    }
+    microphone.reset();
+
+    ma_device_id deviceId;
+    if (!micConfig.deviceName.empty() && !FindDevice(micConfig.deviceName, deviceId, true)) {
+        return false;
+    }
+
+    // Same period settings as the output, so the capture side is as tight as playback
+    ma_device_config deviceConfig = ma_device_config_init(ma_device_type_capture);
+    deviceConfig.capture.pDeviceID = micConfig.deviceName.empty() ? nullptr : &deviceId;
+    deviceConfig.periodSizeInFrames = config.periodSizeInFrames;
+    deviceConfig.periodSizeInMilliseconds = config.periodSizeInMilliseconds;
+    deviceConfig.periods = config.periods;
+    deviceConfig.performanceProfile = config.performanceProfile;
+
+    auto input = std::make_unique<MicrophoneInput>(&context, deviceConfig, &engine,
+        GetCategoryGroup(micConfig.category), micConfig.targetBufferMs);
+    if (!input->IsInitialized() || !input->Start()) {
+        return false;
     }
+    input->SetMonitoring(micConfig.monitor);
+
+    microphone = std::move(input);
+    return true;
+}
+
+void AudioEngine::StopMicrophone() {
+    microphone.reset();
+}
+
+MicrophoneInput* AudioEngine::GetMicrophone() {
+    return microphone.get();
+}
+
+MicrophoneStats AudioEngine::GetMicrophoneStats() const {
+    if (!microphone) {
+        return MicrophoneStats();
+    }
+    return microphone->GetStats(GetDeviceLatency());
+}
+
+AudioEngineStats AudioEngine::GetStats() {
+    AudioEngineStats stats;
+
+    if (masterBus) {
+        stats.masterGainReduction = masterBus->GetEffects().GetGainReduction();
+    }
+    for (auto& pair : categoryBuses) {
+        stats.busGainReduction[pair.first] = pair.second->GetEffects().GetGainReduction();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(soundMutex);
+        stats.activeSoundCount = activeSounds.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(musicMutex);
+        stats.activeMusicCount = activeMusic.size();
+    }
+    if (parallelMixer) {
+        stats.mixWorkerCount = parallelMixer->GetWorkerCount();
+        stats.mixLateJobs = parallelMixer->GetLateJobCount();
+    }
+    stats.pcmCacheBytes = pcmCache->GetUsage();
+    stats.deviceReroutes = deviceReroutes;
+    stats.lastRerouteGlitchMs = lastRerouteGlitchMs;
+    stats.maxRerouteGlitchMs = maxRerouteGlitchMs;
+    return stats;
+}
+
+void AudioEngine::SetPcmCacheBudget(size_t bytes) {
+    pcmCache->SetBudget(bytes);
+}
+
+size_t AudioEngine::GetPcmCacheBudget() const {
+    return pcmCache->GetBudget();
+}
+
+PcmCache* AudioEngine::GetPcmCache() {
+    return initialized ? pcmCache.get() : nullptr;
+}
+
+void AudioEngine::SetParallelMixing(bool enabled, ma_uint32 workerCount) {
+    parallelMixing = enabled;
+    parallelWorkerCount = workerCount;
+
+    if (!initialized) {
+        return;
+    }
+    DestroyParallelMixer();
+    if (enabled) {
+        CreateParallelMixer();
+    }
+}
+
+bool AudioEngine::IsParallelMixingEnabled() const {
+    return parallelMixing;
+}
+
+void AudioEngine::CreateParallelMixer() {
+    if (!masterBus || parallelMixer || categoryBuses.size() < 2) {
+        return;
+    }
+
+    ma_uint32 workerCount = parallelWorkerCount;
+    if (workerCount == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        workerCount = (cores > 1) ? cores - 1 : 0;
+    }
+
+    // The callback thread takes a job too, so more workers than buses would idle
+    workerCount = std::min(workerCount, static_cast<ma_uint32>(categoryBuses.size() - 1));
+    if (workerCount == 0) {
+        return;
+    }
+
+    for (auto& pair : categoryBuses) {
+        pair.second->SetIsolated(true);
+    }
+
+    auto mixer = std::make_unique<ParallelMixer>(&engine, workerCount, BuildMixGroups());
+    if (!mixer->IsInitialized()) {
+        for (auto& pair : categoryBuses) {
+            if (GetCategoryOutput(pair.first).empty()) {
+                pair.second->SetIsolated(false);
+            }
+        }
+        return;
+    }
+
+    ma_node_attach_output_bus(mixer->GetNode(), 0, masterBus->GetGroup(), 0);
+    parallelMixer = std::move(mixer);
+}
+
+void AudioEngine::DestroyParallelMixer() {
+    if (!parallelMixer) {
+        return;
+    }
+
+    // Blocks until the audio thread has stopped reading the subgraphs
+    parallelMixer.reset();
+
+    // Buses on other endpoints stay isolated
+    for (auto& pair : categoryBuses) {
+        if (GetCategoryOutput(pair.first).empty()) {
+            pair.second->SetIsolated(false);
+        }
+    }
+
+    // Anything still waiting on a handover can be wired now
+    ApplyMixRouting();
+}
+
+void AudioEngine::UpdateMixGroups() {
+    if (parallelMixer) {
+        parallelMixer->SetGroups(BuildMixGroups());
+    }
+}
+
+void AudioEngine::ApplyMixRouting() {
+    // The old groups may still be read; wiring graphs they split together would
+    // let two threads read the same nodes. Update() retries.
+    if (parallelMixer && !parallelMixer->CompleteHandover()) {
+        return;
+    }
+
+    bool regroup = false;
+    for (auto it = duckingRoutes.begin(); it != duckingRoutes.end();) {
+        if (!it->second.ducker && !ConnectDucking(it->second, it->first)) {
+            it = duckingRoutes.erase(it);
+            regroup = true;
+        }
+        else {
+            ++it;
+        }
+    }
+
+    for (auto it = categoryOutputs.begin(); it != categoryOutputs.end();) {
+        AudioBus* bus = categoryBuses.at(it->first).get();
+        if (!bus->SetIsolated(true)) {
+            it = categoryOutputs.erase(it);
+            regroup = true;
+            continue;
+        }
+
+        // Adding a graph twice is a no-op
+        outputEndpoints.at(it->second)->AddGraph(bus->GetSubgraph());
+        ++it;
+    }
+
+    if (regroup) {
+        UpdateMixGroups();
+    }
+}
+
+std::vector<std::vector<ma_node_graph*>> AudioEngine::BuildMixGroups() const {
+    std::unordered_map<AudioCategory, size_t> groupOf;
+    std::vector<std::vector<AudioCategory>> members;
+    for (const auto& pair : categoryBuses) {
+        // Mixed by their own endpoint
+        if (!GetCategoryOutput(pair.first).empty()) continue;
+
+        groupOf[pair.first] = members.size();
+        members.push_back({ pair.first });
+    }
+
+    // A sidechain shares nodes between two buses, so they are mixed by the same job
+    for (const auto& route : duckingRoutes) {
+        auto target = groupOf.find(route.first);
+        auto key = groupOf.find(route.second.key);
+        if (target == groupOf.end() || key == groupOf.end() || target->second == key->second) {
+            continue;
+        }
+
+        size_t from = key->second;
+        size_t to = target->second;
+        for (AudioCategory category : members[from]) {
+            groupOf[category] = to;
+            members[to].push_back(category);
+        }
+        members[from].clear();
+    }
+
+    std::vector<std::vector<ma_node_graph*>> groups;
+    for (const auto& group : members) {
+        std::vector<ma_node_graph*> graphs;
+        for (AudioCategory category : group) {
+            ma_node_graph* subgraph = categoryBuses.at(category)->GetSubgraph();
+            if (subgraph) {
+                graphs.push_back(subgraph);
+            }
+        }
+        if (!graphs.empty()) {
+            groups.push_back(graphs);
+        }
+    }
+    return groups;
+}
+
+bool AudioEngine::ConnectDucking(DuckingRoute& route, AudioCategory target) {
+    EffectChain* keyEffects = GetBusEffects(route.key);
+    EffectChain* targetEffects = GetBusEffects(target);
+    if (!keyEffects || !targetEffects) {
+        return false;
+    }
+
+    auto send = std::make_shared<SidechainSendEffect>();
+    auto ducker = std::make_shared<DuckerEffect>();
+    if (!send->IsInitialized() || !ducker->IsInitialized()) {
+        return false;
+    }
+    ducker->SetSettings(route.settings);
+
+    // Wire the key path before either node joins the graph, then add the ducker
+    // ahead of the send so the target never sees an unkeyed ducker
+    ma_node_attach_output_bus(send->GetNode(), 1, ducker->GetNode(), DuckerEffect::KeyInputBus);
+    if (!targetEffects->AddEffect(ducker)) {
+        return false;
+    }
+    if (!keyEffects->AddEffect(send)) {
+        targetEffects->RemoveEffect(ducker);
+        return false;
+    }
+
+    route.send = send;
+    route.ducker = ducker;
+    return true;
+}
+
+void AudioEngine::DisconnectDucking(DuckingRoute& route, AudioCategory target) {
+    EffectChain* keyEffects = GetBusEffects(route.key);
+    EffectChain* targetEffects = GetBusEffects(target);
+
+    if (route.send && keyEffects) {
+        keyEffects->RemoveEffect(route.send);
+    }
+    if (route.ducker && targetEffects) {
+        targetEffects->RemoveEffect(route.ducker);
+    }
+
+    route.send.reset();
+    route.ducker.reset();
+}
+
+bool AudioEngine::AddOutputEndpoint(const std::string& name, const std::string& deviceName) {
+    if (!initialized || name.empty() || outputEndpoints.count(name)) {
+        return false;
+    }
+
+    ma_device_id deviceId;
+    if (!deviceName.empty() && !FindDevice(deviceName, deviceId)) {
+        return false;
+    }
+
+    ma_device_config deviceConfig = GetDeviceConfig(deviceName.empty() ? nullptr : &deviceId,
+        ma_engine_get_sample_rate(&engine), ma_engine_get_channels(&engine));
+    auto endpoint = std::make_unique<OutputEndpoint>(&context, deviceConfig);
+    if (!endpoint->IsInitialized() || !endpoint->Start()) {
+        return false;
+    }
+
+    outputEndpoints[name] = std::move(endpoint);
+    return true;
+}
+
+void AudioEngine::RemoveOutputEndpoint(const std::string& name) {
+    auto it = outputEndpoints.find(name);
+    if (it == outputEndpoints.end()) {
+        return;
+    }
+
+    // Its buses fall back to the main output
+    std::vector<AudioCategory> routed;
+    for (const auto& pair : categoryOutputs) {
+        if (pair.second == name) {
+            routed.push_back(pair.first);
+        }
+    }
+    for (AudioCategory category : routed) {
+        SetCategoryOutput(category, std::string());
+    }
+
+    outputEndpoints.erase(it);
+}
+
+std::vector<std::string> AudioEngine::GetOutputEndpoints() const {
+    std::vector<std::string> names;
+    for (const auto& pair : outputEndpoints) {
+        names.push_back(pair.first);
+    }
+    return names;
+}
+
+std::string AudioEngine::GetOutputEndpointDevice(const std::string& name) const {
+    auto it = outputEndpoints.find(name);
+    if (it != outputEndpoints.end()) {
+        return it->second->GetDeviceName();
+    }
+    return std::string();
+}
+
+void AudioEngine::SetOutputEndpointVolume(const std::string& name, float volume) {
+    auto it = outputEndpoints.find(name);
+    if (it != outputEndpoints.end()) {
+        it->second->SetVolume(volume);
+    }
+}
+
+bool AudioEngine::SetCategoryOutput(AudioCategory category, const std::string& endpointName) {
+    auto busIt = categoryBuses.find(category);
+    if (busIt == categoryBuses.end()) {
+        return false;
+    }
+    AudioBus* bus = busIt->second.get();
+
+    OutputEndpoint* target = nullptr;
+    if (!endpointName.empty()) {
+        auto it = outputEndpoints.find(endpointName);
+        if (it == outputEndpoints.end()) {
+            return false;
+        }
+        target = it->second.get();
+    }
+
+    const std::string current = GetCategoryOutput(category);
+    if (current == endpointName) {
+        return true;
+    }
+
+    // A sidechain can't span two devices; clear the ducking first
+    for (const auto& route : duckingRoutes) {
+        AudioCategory other;
+        if (route.first == category) other = route.second.key;
+        else if (route.second.key == category) other = route.first;
+        else continue;
+
+        if (GetCategoryOutput(other) != endpointName) {
+            return false;
+        }
+    }
+
+    // Stop the current reader before another one starts on the subgraph
+    if (!current.empty()) {
+        outputEndpoints.at(current)->RemoveGraph(bus->GetSubgraph());
+    }
+    if (target) {
+        categoryOutputs[category] = endpointName;
+    }
+    else {
+        categoryOutputs.erase(category);
+    }
+    UpdateMixGroups();
+
+    if (!target && !parallelMixer) {
+        bus->SetIsolated(false);
+    }
+
+    // Handed to the endpoint once the parallel mixer has let go of the bus;
+    // dropped if the bus couldn't be isolated
+    ApplyMixRouting();
+    return GetCategoryOutput(category) == endpointName;
+}
+
+std::string AudioEngine::GetCategoryOutput(AudioCategory category) const {
+    auto it = categoryOutputs.find(category);
+    if (it != categoryOutputs.end()) {
+        return it->second;
+    }
+    return std::string();
+}
+
+void AudioEngine::SetCategorySpatialization(AudioCategory category, SpatializationMode mode) {
+    // A category cannot defer to itself
+    categorySpatialization[category] = (mode == SpatializationMode::Default) ? SpatializationMode::Panner : mode;
+
+    std::lock_guard<std::mutex> lock(soundMutex);
+    for (auto sound : activeSounds) {
+        if (sound->GetCategory() == category) {
+            sound->UpdateSpatializer();
+        }
+    }
+}
+
+SpatializationMode AudioEngine::GetCategorySpatialization(AudioCategory category) const {
+    auto it = categorySpatialization.find(category);
+    if (it != categorySpatialization.end()) {
+        return it->second;
+    }
+    return SpatializationMode::Panner;
+}
+
+void AudioEngine::SetCategoryResamplerQuality(AudioCategory category, ResamplerQuality quality) {
+    // A category cannot defer to itself
+    categoryResamplerQuality[category] = (quality == ResamplerQuality::Default) ? ResamplerQuality::Linear : quality;
+
+    {
+        std::lock_guard<std::mutex> lock(soundMutex);
+        for (auto sound : activeSounds) {
+            if (sound->GetCategory() == category) {
+                sound->UpdateResampler();
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(musicMutex);
+    for (auto music : activeMusic) {
+        if (music->GetCategory() == category) {
+            music->UpdateResampler();
+        }
+    }
+}
+
+ResamplerQuality AudioEngine::GetCategoryResamplerQuality(AudioCategory category) const {
+    auto it = categoryResamplerQuality.find(category);
+    if (it != categoryResamplerQuality.end()) {
+        return it->second;
+    }
+    return ResamplerQuality::Linear;
+}
+
+void AudioEngine::SetHrtfDataset(std::shared_ptr<HrtfDataset> dataset) {
+    hrtfDataset = dataset;
+}
+
+std::shared_ptr<HrtfDataset> AudioEngine::GetHrtfDataset() {
+    if (!hrtfDataset && initialized) {
+        hrtfDataset = HrtfDataset::CreateBuiltIn(ma_engine_get_sample_rate(&engine));
+    }
+    return hrtfDataset;
+}
+
+void AudioEngine::SetCategoryAttenuationCurve(AudioCategory category, std::shared_ptr<const AttenuationCurve> curve) {
+    categoryAttenuation[category] = curve;
+
+    std::lock_guard<std::mutex> lock(soundMutex);
+    for (auto sound : activeSounds) {
+        if (sound->GetCategory() == category) {
+            sound->UpdateAttenuation();
+        }
+    }
+}
+
+std::shared_ptr<const AttenuationCurve> AudioEngine::GetCategoryAttenuationCurve(AudioCategory category) const {
+    auto it = categoryAttenuation.find(category);
+    if (it != categoryAttenuation.end()) {
+        return it->second;
+    }
+    return nullptr;
+}
+
+void AudioEngine::SetOcclusionCallback(OcclusionCallback callback, bool runOnWorkerThread) {
+    // The worker reads the callback unlocked, so it must be idle before swapping
+    StopOcclusionWorker();
+
+    std::lock_guard<std::mutex> lock(soundMutex);
+    occlusionCallback = callback;
+
+    if (occlusionCallback && runOnWorkerThread) {
+        occlusionStop = false;
+        occlusionWorker = std::thread(&AudioEngine::OcclusionWorkerLoop, this);
+    }
+
+    // Without a callback nothing would ever clear the last results
+    if (!occlusionCallback) {
+        for (auto sound : activeSounds) {
+            sound->SetOcclusion(0.0f, 0.0f);
+        }
+    }
+}
+
+void AudioEngine::SetOcclusionSettings(const OcclusionSettings& settings) {
+    occlusionSettings = settings;
+
+    std::lock_guard<std::mutex> lock(soundMutex);
+    for (auto sound : activeSounds) {
+        if (sound->occlusionFilter) {
+            sound->occlusionFilter->SetSettings(occlusionSettings);
+        }
+    }
+}
+
+const OcclusionSettings& AudioEngine::GetOcclusionSettings() const {
+    return occlusionSettings;
+}
+
+void AudioEngine::UpdateOcclusion() {
+    if (!occlusionCallback) return;
+
+    if (!occlusionWorker.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(soundMutex);
+            GatherOcclusionQueries();
+        }
+        if (occlusionQueries.empty()) return;
+
+        occlusionCallback(occlusionQueries);
+
+        std::lock_guard<std::mutex> lock(soundMutex);
+        ApplyOcclusionResults();
+        return;
+    }
+
+    // While the worker isn't busy the batch belongs to this thread
+    bool ready = false;
+    {
+        std::lock_guard<std::mutex> lock(occlusionMutex);
+
+        // Still raycasting last frame's batch; try again next frame
+        if (occlusionBusy) return;
+
+        ready = occlusionReady;
+        occlusionReady = false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(soundMutex);
+        if (ready) {
+            ApplyOcclusionResults();
+        }
+        GatherOcclusionQueries();
+    }
+    if (occlusionQueries.empty()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(occlusionMutex);
+        occlusionBusy = true;
+    }
+    occlusionCondition.notify_one();
+}
+
+void AudioEngine::GatherOcclusionQueries() {
+    occlusionQueries.clear();
+
+    for (auto sound : activeSounds) {
+        if (!sound->loaded || !sound->playing || sound->paused) continue;
+        if (IsCategoryMuted(sound->category)) continue;
+
+        // Only positional sounds can be occluded
+        if (!ma_sound_is_spatialization_enabled(&sound->sound) && !sound->IsUsingHrtf()) continue;
+
+        OcclusionQuery query;
+        query.soundId = sound->GetId();
+        query.position = ma_sound_get_position(&sound->sound);
+        query.listener = ma_engine_listener_get_position(&engine, ma_sound_get_listener_index(&sound->sound));
+        query.occlusion = sound->GetOcclusion();
+        query.obstruction = sound->GetObstruction();
+
+        // Out of earshot
+        float dx = query.position.x - query.listener.x;
+        float dy = query.position.y - query.listener.y;
+        float dz = query.position.z - query.listener.z;
+        float maxDistance = ma_sound_get_max_distance(&sound->sound);
+        if (dx * dx + dy * dy + dz * dz > maxDistance * maxDistance) continue;
+
+        occlusionQueries.push_back(query);
+    }
+}
+
+void AudioEngine::ApplyOcclusionResults() {
+    // Matched by id: a sound destroyed while the batch was out may have had its
+    // address reused by a new one
+    std::unordered_map<ma_uint64, Sound*> soundsById;
+    for (auto sound : activeSounds) {
+        soundsById[sound->GetId()] = sound;
+    }
+
+    for (const OcclusionQuery& query : occlusionQueries) {
+        auto it = soundsById.find(query.soundId);
+        if (it == soundsById.end()) continue;
+
+        it->second->SetOcclusion(query.occlusion, query.obstruction);
+    }
+}
+
+void AudioEngine::StopOcclusionWorker() {
+    if (!occlusionWorker.joinable()) return;
+
+    {
+        std::lock_guard<std::mutex> lock(occlusionMutex);
+        occlusionStop = true;
+    }
+    occlusionCondition.notify_one();
+    occlusionWorker.join();
+
+    occlusionBusy = false;
+    occlusionReady = false;
+}
+
+void AudioEngine::OcclusionWorkerLoop() {
+    std::unique_lock<std::mutex> lock(occlusionMutex);
+
+    while (true) {
+        occlusionCondition.wait(lock, [this] { return occlusionStop || occlusionBusy; });
+        if (occlusionStop) return;
+
+        // The batch belongs to this thread until occlusionBusy is cleared
+        lock.unlock();
+        occlusionCallback(occlusionQueries);
+        lock.lock();
+
+        occlusionBusy = false;
+        occlusionReady = true;
+    }
+}
+
+ma_sound_group* AudioEngine::GetCategoryGroup(AudioCategory category) {
+    auto it = categoryBuses.find(category);
+    if (it != categoryBuses.end()) {
+        return it->second->GetGroup();
+    }
+    return nullptr;
+}
+
+void AudioEngine::CreateBuses() {
+    masterBus = std::make_unique<AudioBus>(&engine);
+    if (!masterBus->IsInitialized()) {
+        masterBus.reset();
+        return;
+    }
+
+    const AudioCategory categories[] = {
+        AudioCategory::SFX, AudioCategory::MUSIC, AudioCategory::VOICE, AudioCategory::AMBIENT
+    };
+    for (AudioCategory category : categories) {
+        auto bus = std::make_unique<AudioBus>(&engine, masterBus.get());
+        if (bus->IsInitialized()) {
+            categoryBuses[category] = std::move(bus);
+        }
+    }
+
+    if (parallelMixing) {
+        CreateParallelMixer();
+    }
+
+    // Ducking survives device changes
+    for (auto& route : duckingRoutes) {
+        ConnectDucking(route.second, route.first);
+    }
+}
+
+void AudioEngine::DestroyBuses() {
+    for (auto& route : duckingRoutes) {
+        DisconnectDucking(route.second, route.first);
+    }
+
+    // The mixer reads the category buses, so it goes first
+    parallelMixer.reset();
+
+    // Category buses feed the master, so they go first
+    categoryBuses.clear();
+    masterBus.reset();
+}
+
+void AudioEngine::RegisterSound(Sound* sound) {
+    if (!sound) return;
+
+    // Sounds re-register every time they are played
+    std::lock_guard<std::mutex> lock(soundMutex);
+    if (std::find(activeSounds.begin(), activeSounds.end(), sound) == activeSounds.end()) {
+        activeSounds.push_back(sound);
+    }
+}
+
+void AudioEngine::UnregisterSound(Sound* sound) {
+    if (!sound) return;
+
+    std::lock_guard<std::mutex> lock(soundMutex);
+    auto it = std::find(activeSounds.begin(), activeSounds.end(), sound);
+    if (it != activeSounds.end()) {
+        activeSounds.erase(it);
+    }
+}
+
+void AudioEngine::RegisterMusic(Music* music) {
+    if (!music) return;
+
+    std::lock_guard<std::mutex> lock(musicMutex);
+    activeMusic.push_back(music);
+}
+
+void AudioEngine::UnregisterMusic(Music* music) {
+    if (!music) return;
+
+    std::lock_guard<std::mutex> lock(musicMutex);
+    auto it = std::find(activeMusic.begin(), activeMusic.end(), music);
+    if (it != activeMusic.end()) {
+        activeMusic.erase(it);
+    }
+}
+
+void AudioEngine::SetListenerPosition(float x, float y, float z, ma_uint32 listenerIndex) {
+    ma_engine_listener_set_position(&engine, listenerIndex, x, y, z);
+}
+
+void AudioEngine::SetListenerDirection(float x, float y, float z, ma_uint32 listenerIndex) {
+    ma_engine_listener_set_direction(&engine, listenerIndex, x, y, z);
+}
+
+void AudioEngine::SetListenerVelocity(float x, float y, float z, ma_uint32 listenerIndex) {
+    ma_engine_listener_set_velocity(&engine, listenerIndex, x, y, z);
+}
+
+void AudioEngine::SetListenerWorldUp(float x, float y, float z, ma_uint32 listenerIndex) {
+    ma_engine_listener_set_world_up(&engine, listenerIndex, x, y, z);
+}
+
+ma_uint32 AudioEngine::GetListenerCount() const {
+    if (!initialized) {
+        return 0;
+    }
+    return ma_engine_get_listener_count(&engine);
+}
+
+void AudioEngine::SetListenerEnabled(ma_uint32 listenerIndex, bool enabled) {
+    ma_engine_listener_set_enabled(&engine, listenerIndex, enabled ? MA_TRUE : MA_FALSE);
+}
+
+bool AudioEngine::IsListenerEnabled(ma_uint32 listenerIndex) const {
+    return ma_engine_listener_is_enabled(&engine, listenerIndex) == MA_TRUE;
+}
+
+void AudioEngine::UpdateListenerSelection() {
+    // With one listener there is nothing to choose
+    ma_uint32 listenerCount = ma_engine_get_listener_count(&engine);
+    if (listenerCount < 2) return;
+
+    ma_vec3f listeners[MA_ENGINE_MAX_LISTENERS];
+    bool enabled[MA_ENGINE_MAX_LISTENERS];
+    for (ma_uint32 i = 0; i < listenerCount; i++) {
+        listeners[i] = ma_engine_listener_get_position(&engine, i);
+        enabled[i] = ma_engine_listener_is_enabled(&engine, i) == MA_TRUE;
+    }
+
+    // Pinning here saves the audio thread a search per sound per block, and a sound
+    // halfway between two players only moves once it is clearly closer to the other
+    const float switchRatio = 0.8f;    // Squared distance, about 10% closer
+
+    for (auto sound : activeSounds) {
+        if (!sound->loaded || sound->listenerIndex != MA_LISTENER_INDEX_CLOSEST) continue;
+        if (!ma_sound_is_spatialization_enabled(&sound->sound) && !sound->IsUsingHrtf()) continue;
+
+        ma_vec3f position = ma_sound_get_position(&sound->sound);
+        ma_uint32 current = ma_sound_get_pinned_listener_index(&sound->sound);
+        ma_uint32 nearest = MA_LISTENER_INDEX_CLOSEST;
+        float nearestDistance = 0.0f;
+        float currentDistance = 0.0f;
+        for (ma_uint32 i = 0; i < listenerCount; i++) {
+            if (!enabled[i]) continue;
+
+            float dx = position.x - listeners[i].x;
+            float dy = position.y - listeners[i].y;
+            float dz = position.z - listeners[i].z;
+            float distance = dx * dx + dy * dy + dz * dz;
+            if (i == current) currentDistance = distance;
+            if (nearest == MA_LISTENER_INDEX_CLOSEST || distance < nearestDistance) {
+                nearest = i;
+                nearestDistance = distance;
+            }
+        }
+        if (nearest == MA_LISTENER_INDEX_CLOSEST || nearest == current) continue;
+
+        bool currentUsable = current < listenerCount && enabled[current];
+        if (currentUsable && nearestDistance > currentDistance * switchRatio) continue;
+
+        ma_sound_set_pinned_listener_index(&sound->sound, nearest);
+    }
+}
+
+void AudioEngine::Update(float deltaTime) {
+    UpdateDevice(deltaTime);
+
+    {
+        // Clean up any finished sounds
+        std::lock_guard<std::mutex> lock(soundMutex);
+        auto soundIt = activeSounds.begin();
+        while (soundIt != activeSounds.end()) {
+            if (!(*soundIt)->IsPlaying()) {
+                soundIt = activeSounds.erase(soundIt);
+            }
+            else {
+                ++soundIt;
+            }
+        }
+
+        UpdateListenerSelection();
+    }
+
+    if (parallelMixer) {
+        ApplyMixRouting();
+    }
+    UpdateOcclusion();
+}
+
+ma_uint32 AudioEngine::ProcessJobs(float budgetMs) {
+    if (!initialized || !config.hostResourceJobs) {
+        return 0;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float, std::milli>(budgetMs));
+
+    ma_uint32 jobCount = 0;
+    do {
+        ma_job job;
+        if (ma_resource_manager_next_job(&resourceManager, &job) != MA_SUCCESS) {
+            break;  // Queue empty, or shutting down
+        }
+        ma_job_process(&job);
+        jobCount++;
+    } while (std::chrono::steady_clock::now() < deadline);
+
+    return jobCount;
+}
+
+bool AudioEngine::IsHostingResourceJobs() const {
+    return config.hostResourceJobs;
 }
\ No newline at end of file
@@ -1,15 +1,34 @@
 #pragma once
 
 #include "miniaudio.h"   
+#include "AudioEffect.h"
+#include "Ducking.h"
+#include "MixRecorder.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <string>
 #include <unordered_map>
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <thread>
 
 class Sound;
 class Music;
+class AudioBus;
+class EffectChain;
+class HrtfDataset;
+class AttenuationCurve;
+class ParallelMixer;
+class PcmCache;
+class LatencyProbe;
+class OutputEndpoint;
+class MicrophoneInput;
+class ProceduralSource;
+struct MicrophoneConfig;
+struct MicrophoneStats;
 
 enum class AudioCategory {
     SFX,
@@ -18,6 +37,119 @@ enum class AudioCategory {
     AMBIENT
 };
 
+// How positional sounds are rendered. Default defers to the sound's category.
+enum class SpatializationMode {
+    Default,
+    Panner,     // miniaudio's built-in stereo panner
+    Hrtf        // Binaural rendering for headphones
+};
+
+// How an asset's audio data is held in memory
+enum class LoadPolicy {
+    Auto,               // Picked from the file's duration and size, see AudioEngine::ChooseLoadPolicy()
+    Decode,             // Decoded to PCM up front (sounds share it through the PCM cache)
+    CompressedInMemory, // Encoded bytes stay resident and are decoded while playing
+    Stream,             // Read from disk while playing
+    Procedural          // Synthesized while playing; nothing is loaded (see ProceduralSource)
+};
+
+// Interpolation for sounds that are pitched or whose data isn't at the engine rate.
+// Default defers to the sound's category.
+enum class ResamplerQuality {
+    Default,
+    Linear,     // Two-point interpolation: almost free, but aliases when pitched up
+    Sinc        // 32-tap windowed-sinc polyphase filter
+};
+
+// One audible emitter in an occlusion batch
+struct OcclusionQuery {
+    ma_uint64 soundId;      // Identifies the emitter (Sound::GetId())
+    ma_vec3f position;      // Emitter position
+    ma_vec3f listener;      // Position of the listener it is heard through
+    float occlusion;        // Filled in by the callback, 0.0 (clear) to 1.0 (fully occluded)
+    float obstruction;      // Filled in by the callback, 0.0 (clear) to 1.0 (fully obstructed)
+};
+
+// Options fixed for the lifetime of the engine
+struct AudioEngineConfig {
+    // Run miniaudio's resource-manager jobs (streaming page loads, deferred decodes)
+    // from ProcessJobs() on the game's job system instead of miniaudio's own thread
+    bool hostResourceJobs = false;
+
+    // See AudioEngine::SetParallelMixing()
+    bool parallelMixing = false;
+    ma_uint32 mixWorkerCount = 0;
+
+    // See AudioEngine::SetPcmCacheBudget()
+    size_t pcmCacheBudget = 64 * 1024 * 1024;
+
+    // Where files derived from assets are kept (loudness measurements, imports); see AssetCache.h
+    std::string cacheDirectory = "AssetCache";
+
+    // Output device. Zeros take the backend's defaults; the device may round what it
+    // is asked for, so check GetDeviceLatency() for what it settled on.
+    ma_uint32 sampleRate = 0;
+    ma_uint32 channels = 0;
+    ma_uint32 periodSizeInFrames = 0;          // Takes precedence over periodSizeInMilliseconds
+    ma_uint32 periodSizeInMilliseconds = 0;
+    ma_uint32 periods = 0;
+    ma_performance_profile performanceProfile = ma_performance_profile_low_latency;
+
+    // Render to miniaudio's null device, which keeps real-time pacing without audio
+    // hardware (build machines, latency runs)
+    bool nullDevice = false;
+
+    // Seconds between background device list refreshes; 0 only refreshes on request
+    float deviceRefreshInterval = 2.0f;
+
+    // Listeners, one per local player for split-screen (1 to MA_ENGINE_MAX_LISTENERS)
+    ma_uint32 listenerCount = 1;
+};
+
+// What the output device negotiated. The mixer renders one period per callback, and
+// bufferMs is how far ahead of the speakers that can be.
+struct AudioDeviceLatency {
+    ma_uint32 sampleRate = 0;
+    ma_uint32 channels = 0;
+    ma_uint32 periodSizeInFrames = 0;
+    ma_uint32 periods = 0;
+    float periodMs = 0.0f;
+    float bufferMs = 0.0f;
+};
+
+// Snapshot of the mixer for debug overlays and profiling
+struct AudioEngineStats {
+    float masterGainReduction = 0.0f;   // dB, summed over the master bus dynamics
+    std::unordered_map<AudioCategory, float> busGainReduction;  // dB, per category bus
+    size_t activeSoundCount = 0;
+    size_t activeMusicCount = 0;
+    ma_uint32 mixWorkerCount = 0;       // Threads helping the audio callback mix buses
+    ma_uint64 mixLateJobs = 0;          // Bus mixes played a block late because a worker was late
+    size_t pcmCacheBytes = 0;           // Decoded sound data currently resident
+    ma_uint32 deviceReroutes = 0;       // Device changes handled without the game's help
+    float lastRerouteGlitchMs = 0.0f;   // Output gap beyond one period, for the last and worst of them
+    float maxRerouteGlitchMs = 0.0f;
+};
+
+// An output device change the engine handled on its own
+struct DeviceChangeEvent {
+    enum class Type {
+        Rerouted,       // The backend moved the stream to a new default device (e.g. headphones plugged in)
+        Recovered,      // The device went away and the engine reopened the default device
+        Lost            // The device went away and no device could be opened yet; retried every second
+    };
+
+    Type type = Type::Rerouted;
+    std::string deviceName;
+    float glitchMs = 0.0f;      // Gap between the last period on the old route and the first on the new one, less a period
+};
+
+// Receives every audible positional sound at once, so the game can batch its raycasts
+using OcclusionCallback = std::function<void(std::vector<OcclusionQuery>& queries)>;
+
+using DeviceChangeCallback = std::function<void(const DeviceChangeEvent& event)>;
+using DeviceListCallback = std::function<void(const std::vector<std::string>& devices, ma_uint32 version)>;
+
 class AudioEngine {
 public:
     static AudioEngine& Instance() {
@@ -25,12 +157,22 @@ public:
         return instance;
     }
 
-    bool Initialize();
+    bool Initialize(const AudioEngineConfig& config = AudioEngineConfig());
     void Shutdown();
 
     // Sound management
-    std::shared_ptr<Sound> LoadSound(const std::string& filePath);
-    std::shared_ptr<Music> LoadMusic(const std::string& filePath);
+    std::shared_ptr<Sound> LoadSound(const std::string& filePath, LoadPolicy policy = LoadPolicy::Auto);
+    std::shared_ptr<Music> LoadMusic(const std::string& filePath, LoadPolicy policy = LoadPolicy::Stream);
+
+    // Wraps a synthesized source in a Sound, which then plays, spatializes and routes
+    // like a loaded one. Not loudness-normalized; set the source's amplitude instead.
+    std::shared_ptr<Sound> CreateSound(const std::string& name, std::shared_ptr<ProceduralSource> source);
+
+    // LoadPolicy::Auto decodes clips up to maxDecodeSeconds long. Longer files are
+    // kept compressed in memory if that at least halves their size and they are no
+    // bigger than maxCompressedBytes; anything else streams.
+    void SetAutoLoadPolicyLimits(float maxDecodeSeconds, size_t maxCompressedBytes);
+    LoadPolicy ChooseLoadPolicy(const std::string& filePath);
 
     // Global volume control
     void SetMasterVolume(float volume);
@@ -40,6 +182,14 @@ public:
     void SetCategoryVolume(AudioCategory category, float volume);
     float GetCategoryVolume(AudioCategory category) const;
 
+    // Loudness normalization, off by default: while it is on, LoadSound/LoadMusic
+    // measure each file's integrated loudness once (cached in the config's
+    // cacheDirectory) and gain it to the target. Only files loaded while it is on
+    // are measured, so turn it on before loading assets.
+    void SetLoudnessNormalization(bool enabled, float targetLufs = -23.0f);
+    bool IsLoudnessNormalizationEnabled() const;
+    float GetLoudnessTarget() const;
+
     // Mute/unmute
     void MuteAll(bool mute);
     void MuteCategory(AudioCategory category, bool mute);
@@ -52,27 +202,152 @@ public:
     // Stop all sounds
     void StopAll();
 
-    // Device enumeration
+    // Device enumeration. The lists are refreshed on a worker thread, so reading them
+    // never blocks; the version goes up whenever either changes.
     std::vector<std::string> GetAudioDevices() const;
+    std::vector<std::string> GetCaptureDevices() const;
+    std::string GetDefaultAudioDevice() const;
+    ma_uint32 GetAudioDeviceListVersion() const;
+    void RefreshAudioDevices();     // Wakes the worker; the new list arrives later
+
+    // Called from Update() with the new list whenever it changes
+    void SetDeviceListCallback(DeviceListCallback callback);
+
+    // Switching keeps the engine, so voices, buses and fades carry on; the new device
+    // is opened at the engine's rate and channel count and converts to its own format
+    // if they differ. On failure the current device stays.
     bool SetAudioDevice(const std::string& deviceName);
     std::string GetCurrentDevice() const;
 
+    // Called from Update() after the engine follows a device change by itself: the
+    // backend rerouting to a new default device, or the device disappearing and the
+    // engine moving to the default one. Voices keep playing either way.
+    void SetDeviceChangeCallback(DeviceChangeCallback callback);
+    AudioDeviceLatency GetDeviceLatency() const;
+
+    // Feeds every mixed period to the probe (Mixer tap); null to detach. The probe
+    // must outlive its attachment.
+    void SetLatencyProbe(LatencyProbe* probe);
+
+    // Bus insert effects (sounds -> category bus -> master bus -> device)
+    EffectChain* GetMasterEffects();
+    EffectChain* GetBusEffects(AudioCategory category);
+
+    // Sidechain ducking: the target bus is turned down while the key bus is active
+    // (e.g. MUSIC under VOICE). Runs in the mix graph; nothing to poll per frame.
+    // With parallel mixing the sidechain is connected by a later Update(), once the
+    // mixer has moved both buses into one job.
+    bool SetDucking(AudioCategory target, AudioCategory key, const DuckingSettings& settings = DuckingSettings());
+    void ClearDucking(AudioCategory target);
+    float GetDuckingGainReduction(AudioCategory target) const;
+
+    // Extra output endpoints, e.g. comms on a headset while the game plays on the
+    // speakers. A category bus routed to an endpoint skips the master bus and is mixed
+    // by that device; its sounds keep sharing the resource manager and PCM cache.
+    // An empty device name opens the default device; an empty endpoint name means the
+    // main output. Ducking only works between buses on the same endpoint. With
+    // parallel mixing a bus reaches its endpoint on a later Update(), once the mixer
+    // has stopped reading it.
+    bool AddOutputEndpoint(const std::string& name, const std::string& deviceName = std::string());
+    void RemoveOutputEndpoint(const std::string& name);     // Its buses go back to the main output
+    std::vector<std::string> GetOutputEndpoints() const;
+    std::string GetOutputEndpointDevice(const std::string& name) const;
+    void SetOutputEndpointVolume(const std::string& name, float volume);
+    bool SetCategoryOutput(AudioCategory category, const std::string& endpointName);
+    std::string GetCategoryOutput(AudioCategory category) const;
+
+    // Microphone capture into a category bus (VOICE by default), for push-to-talk
+    // monitoring and voice chat. Restarting replaces the current microphone.
+    bool StartMicrophone(const MicrophoneConfig& config);
+    void StopMicrophone();
+    MicrophoneInput* GetMicrophone();              // Null when not capturing
+    MicrophoneStats GetMicrophoneStats() const;
+
+    // Records the master bus (after its effects, before master volume) to a WAV file
+    // on a background thread; see MixRecorder to record any other bus
+    bool StartRecording(const std::string& filePath, RecordingFormat format = RecordingFormat::Pcm16);
+    void StopRecording();
+    bool IsRecording() const;
+    MixRecorder::Stats GetRecordingStats() const;
+
+    // Gain reduction of every bus's dynamics (limiters, compressors, duckers) plus voice counts
+    AudioEngineStats GetStats();
+
+    // Parallel mixing: each category bus is mixed by its own job on a worker pool and
+    // joined at the master bus (buses linked by ducking share a job). workerCount 0
+    // uses one worker per spare core. Switching while audio plays drops a block.
+    // Off by default: it only pays off with many sounds on heavy buses, and a worker
+    // the OS doesn't schedule in time sets its buses a block behind (see mixLateJobs).
+    void SetParallelMixing(bool enabled, ma_uint32 workerCount = 0);
+    bool IsParallelMixingEnabled() const;
+
+    // Decoded PCM for sounds is cached within a byte budget (music always streams).
+    // Assets nobody is playing are evicted least recently used first; their sounds
+    // stay loaded and stream until a later play finds room. 0 streams every sound.
+    void SetPcmCacheBudget(size_t bytes);
+    size_t GetPcmCacheBudget() const;
+    PcmCache* GetPcmCache();
+
+    // Spatialization (sounds set to SpatializationMode::Default follow their category)
+    void SetCategorySpatialization(AudioCategory category, SpatializationMode mode);
+    SpatializationMode GetCategorySpatialization(AudioCategory category) const;
+
+    // Resampler quality for pitched sounds and music (sounds set to ResamplerQuality::Default,
+    // and all music, follow their category)
+    void SetCategoryResamplerQuality(AudioCategory category, ResamplerQuality quality);
+    ResamplerQuality GetCategoryResamplerQuality(AudioCategory category) const;
+
+    // HRTF set shared by every binaural sound. The built-in model is created on
+    // first use; a custom set must match the engine sample rate.
+    void SetHrtfDataset(std::shared_ptr<HrtfDataset> dataset);
+    std::shared_ptr<HrtfDataset> GetHrtfDataset();
+
+    // Distance attenuation curve for a category; sounds with their own curve ignore it.
+    // nullptr falls back to miniaudio's attenuation model. Music has no position, so
+    // it is never attenuated by distance and the curve doesn't apply to it.
+    void SetCategoryAttenuationCurve(AudioCategory category, std::shared_ptr<const AttenuationCurve> curve);
+    std::shared_ptr<const AttenuationCurve> GetCategoryAttenuationCurve(AudioCategory category) const;
+
+    // Occlusion queries, issued once per Update(). On a worker thread the results
+    // are applied on the following Update(). Pass an empty callback to stop.
+    void SetOcclusionCallback(OcclusionCallback callback, bool runOnWorkerThread = false);
+    void SetOcclusionSettings(const OcclusionSettings& settings);
+    const OcclusionSettings& GetOcclusionSettings() const;
+
     // Internal use (called by Sound/Music classes)
     ma_engine* GetEngine() { return &engine; }
+    ma_sound_group* GetCategoryGroup(AudioCategory category);
     void RegisterSound(Sound* sound);
     void UnregisterSound(Sound* sound);
     void RegisterMusic(Music* music);
     void UnregisterMusic(Music* music);
+    float GetLoudnessGain(float lufs) const;
 
     // 3D Audio settings
-    void SetListenerPosition(float x, float y, float z = 0.0f);
-    void SetListenerDirection(float x, float y, float z = 0.0f);
-    void SetListenerVelocity(float x, float y, float z = 0.0f);
-    void SetListenerWorldUp(float x, float y, float z = 1.0f);
+    void SetListenerPosition(float x, float y, float z = 0.0f, ma_uint32 listenerIndex = 0);
+    void SetListenerDirection(float x, float y, float z = 0.0f, ma_uint32 listenerIndex = 0);
+    void SetListenerVelocity(float x, float y, float z = 0.0f, ma_uint32 listenerIndex = 0);
+    void SetListenerWorldUp(float x, float y, float z = 1.0f, ma_uint32 listenerIndex = 0);
+
+    // With several listeners, each positional sound is heard through the nearest
+    // enabled one, picked once per Update() (see Sound::SetListener to fix one).
+    // Disabled listeners are skipped, e.g. for a player who has left.
+    ma_uint32 GetListenerCount() const;
+    void SetListenerEnabled(ma_uint32 listenerIndex, bool enabled);
+    bool IsListenerEnabled(ma_uint32 listenerIndex) const;
 
     // Update method to be called once per frame
     void Update(float deltaTime);
 
+    // With AudioEngineConfig::hostResourceJobs, runs queued resource-manager jobs until
+    // the queue is empty or budgetMs has passed (at least one job runs), and returns
+    // how many ran. Call it every frame or two; streams are paged about a second ahead.
+    // Opening and closing a stream (streamed sounds and music, and decoded sounds the
+    // PCM cache had to stream) blocks until ProcessJobs() has run that stream's job,
+    // so call it from a different thread than the one loading and unloading sounds.
+    ma_uint32 ProcessJobs(float budgetMs = 1.0f);
+    bool IsHostingResourceJobs() const;
+
 private:
     AudioEngine();
     ~AudioEngine();
@@ -81,21 +356,135 @@ private:
     AudioEngine(const AudioEngine&) = delete;
     AudioEngine& operator=(const AudioEngine&) = delete;
 
+    bool MeasureLoudness(const std::string& filePath, float& lufs);
+    void CreateBuses();
+    void DestroyBuses();
+
+    struct DuckingRoute {
+        AudioCategory key;
+        DuckingSettings settings;
+        std::shared_ptr<SidechainSendEffect> send;
+        std::shared_ptr<DuckerEffect> ducker;
+    };
+    bool ConnectDucking(DuckingRoute& route, AudioCategory target);
+    void DisconnectDucking(DuckingRoute& route, AudioCategory target);
+
+    void CreateParallelMixer();
+    void DestroyParallelMixer();
+    void UpdateMixGroups();
+    void ApplyMixRouting();     // Connects ducking and endpoint routes the mixer groups allow
+    std::vector<std::vector<ma_node_graph*>> BuildMixGroups() const;
+
+    // Nearest-listener pass; called from Update() with soundMutex held
+    void UpdateListenerSelection();
+
+    // Occlusion pass; called from Update() without soundMutex, so the callback may
+    // call back into the engine. Gather and Apply need soundMutex held.
+    void UpdateOcclusion();
+    void GatherOcclusionQueries();
+    void ApplyOcclusionResults();
+    void StopOcclusionWorker();
+    void OcclusionWorkerLoop();
+
+    // Output device, opened from config; the engine mixes into it but does not own it
+    ma_device_config GetDeviceConfig(const ma_device_id* deviceId, ma_uint32 sampleRate, ma_uint32 channels) const;
+    bool FindDevice(const std::string& deviceName, ma_device_id& deviceId, bool capture = false) const;
+    std::unique_ptr<ma_device> OpenDevice(const ma_device_id* deviceId, ma_uint32 sampleRate, ma_uint32 channels);
+    bool SwitchDevice(const ma_device_id* deviceId, bool start);
+    static void DeviceDataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+    static void DeviceNotificationCallback(const ma_device_notification* pNotification);
+
+    // Device change tracking; called from Update()
+    void BeginReroute(DeviceChangeEvent::Type type);
+    void UpdateDevice(float deltaTime);
+
+    // Device list worker
+    bool EnumerateDevices(std::vector<ma_device_info>& devices, std::vector<ma_device_info>& inputs);
+    void StopDeviceWorker();
+    void DeviceWorkerLoop();
+
     ma_engine engine;
-    ma_device_info* pPlaybackDeviceInfos;
-    ma_uint32 playbackDeviceCount;
+    std::unique_ptr<ma_device> device;
+    std::atomic<ma_device*> renderDevice;   // The device allowed to mix; the other one of a switch plays silence
+    std::atomic<ma_uint32> renderersInside; // Callbacks between checking renderDevice and finishing their mix
+    ma_resource_manager resourceManager;   // Only used with hostResourceJobs
+    AudioEngineConfig config;
     ma_context context;
 
     float masterVolume;
     std::unordered_map<AudioCategory, float> categoryVolumes;
     std::unordered_map<AudioCategory, bool> categoryMuted;
 
+    bool loudnessNormalization;
+    float loudnessTarget;
+    std::unordered_map<std::string, float> measuredLoudness;   // Per file path, for this session
+
+    float autoDecodeSeconds;
+    size_t autoCompressedBytes;
+    std::unordered_map<std::string, LoadPolicy> chosenLoadPolicies;    // Per file path, for the current limits
+    std::unordered_map<AudioCategory, SpatializationMode> categorySpatialization;
+    std::unordered_map<AudioCategory, ResamplerQuality> categoryResamplerQuality;
+    std::shared_ptr<HrtfDataset> hrtfDataset;
+    std::unordered_map<AudioCategory, std::shared_ptr<const AttenuationCurve>> categoryAttenuation;
+
+    OcclusionCallback occlusionCallback;
+    OcclusionSettings occlusionSettings;
+    std::vector<OcclusionQuery> occlusionQueries;   // Owned by the worker while occlusionBusy
+    std::thread occlusionWorker;
+    std::mutex occlusionMutex;
+    std::condition_variable occlusionCondition;
+    bool occlusionBusy;
+    bool occlusionReady;
+    bool occlusionStop;
+
+    std::unique_ptr<AudioBus> masterBus;
+    std::unordered_map<AudioCategory, std::unique_ptr<AudioBus>> categoryBuses;
+    std::unordered_map<AudioCategory, DuckingRoute> duckingRoutes;     // By target
+    std::unique_ptr<ParallelMixer> parallelMixer;
+    std::unordered_map<std::string, std::unique_ptr<OutputEndpoint>> outputEndpoints;
+    std::unordered_map<AudioCategory, std::string> categoryOutputs;    // Missing means the main output
+    bool parallelMixing;
+    ma_uint32 parallelWorkerCount;
+    std::unique_ptr<PcmCache> pcmCache;
+    std::unique_ptr<MixRecorder> masterRecorder;    // Created by the first StartRecording()
+    std::unique_ptr<MicrophoneInput> microphone;
+    std::atomic<LatencyProbe*> latencyProbe;
+
     std::vector<Sound*> activeSounds;
     std::vector<Music*> activeMusic;
 
     std::string currentDevice;
     bool initialized;
 
+    // Set from miniaudio's notification thread and the audio thread. A reroute waits
+    // for the first period mixed on the new route, which measures the glitch, and is
+    // then reported from Update().
+    enum RerouteStage { RerouteIdle, RerouteWaiting, RerouteMeasured };
+    std::atomic<bool> deviceStopExpected;
+    std::atomic<bool> deviceLost;
+    std::atomic<int> rerouteStage;
+    std::atomic<DeviceChangeEvent::Type> rerouteType;
+    std::atomic<long long> lastRenderTicks;       // steady_clock, at the start of the last mixed period
+    std::atomic<long long> rerouteFromTicks;
+    std::atomic<long long> rerouteGlitchTicks;
+    float deviceRetryTimer;
+
+    std::vector<ma_device_info> playbackDevices;    // Guarded by deviceListMutex
+    std::vector<ma_device_info> captureDevices;     // Likewise
+    ma_uint32 deviceListVersion;
+    ma_uint32 reportedDeviceListVersion;            // Last one passed to deviceListCallback
+    DeviceListCallback deviceListCallback;
+    std::thread deviceWorker;
+    mutable std::mutex deviceListMutex;
+    std::condition_variable deviceListCondition;
+    bool deviceRefreshRequested;
+    bool deviceWorkerStop;
+    bool deviceLostReported;
+    DeviceChangeCallback deviceChangeCallback;
+    ma_uint32 deviceReroutes;
+    float lastRerouteGlitchMs;
+    float maxRerouteGlitchMs;
+
     std::mutex soundMutex;
     std::mutex musicMutex;
 };
\ No newline at end of file
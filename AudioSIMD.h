@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstddef>
+
+// Small vector kernels shared by the DSP code. SSE is used on x86/x64, NEON on
+// ARM, and a scalar loop everywhere else. None of these require aligned memory.
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define AUDIO_SIMD_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define AUDIO_SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+namespace AudioSIMD {
+
+// accRe/accIm += (xRe + i*xIm) * (hRe + i*hIm), on split-complex arrays
+inline void ComplexMultiplyAccumulate(float* accRe, float* accIm,
+    const float* xRe, const float* xIm, const float* hRe, const float* hIm, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SIMD_SSE)
+    for (; i + 4 <= count; i += 4) {
+        __m128 xr = _mm_loadu_ps(xRe + i);
+        __m128 xi = _mm_loadu_ps(xIm + i);
+        __m128 hr = _mm_loadu_ps(hRe + i);
+        __m128 hi = _mm_loadu_ps(hIm + i);
+        __m128 re = _mm_sub_ps(_mm_mul_ps(xr, hr), _mm_mul_ps(xi, hi));
+        __m128 im = _mm_add_ps(_mm_mul_ps(xr, hi), _mm_mul_ps(xi, hr));
+        _mm_storeu_ps(accRe + i, _mm_add_ps(_mm_loadu_ps(accRe + i), re));
+        _mm_storeu_ps(accIm + i, _mm_add_ps(_mm_loadu_ps(accIm + i), im));
+    }
+#elif defined(AUDIO_SIMD_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t xr = vld1q_f32(xRe + i);
+        float32x4_t xi = vld1q_f32(xIm + i);
+        float32x4_t hr = vld1q_f32(hRe + i);
+        float32x4_t hi = vld1q_f32(hIm + i);
+        float32x4_t re = vmlsq_f32(vmulq_f32(xr, hr), xi, hi);
+        float32x4_t im = vmlaq_f32(vmulq_f32(xr, hi), xi, hr);
+        vst1q_f32(accRe + i, vaddq_f32(vld1q_f32(accRe + i), re));
+        vst1q_f32(accIm + i, vaddq_f32(vld1q_f32(accIm + i), im));
+    }
+#endif
+    for (; i < count; i++) {
+        accRe[i] += xRe[i] * hRe[i] - xIm[i] * hIm[i];
+        accIm[i] += xRe[i] * hIm[i] + xIm[i] * hRe[i];
+    }
+}
+
+// dst += src * gain
+inline void MultiplyAdd(float* dst, const float* src, float gain, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SIMD_SSE)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+    }
+#elif defined(AUDIO_SIMD_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), g));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] += src[i] * gain;
+    }
+}
+
+// dst = a * b, element-wise
+inline void Multiply(float* dst, const float* a, const float* b, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SIMD_SSE)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+#elif defined(AUDIO_SIMD_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = a[i] * b[i];
+    }
+}
+
+// peaks[f] = max over channels of |frames[f * channels + c]|
+inline void FramePeaks(float* peaks, const float* frames, size_t frameCount, size_t channels) {
+    size_t f = 0;
+#if defined(AUDIO_SIMD_SSE)
+    // |x| as max(x, -x), which needs nothing past SSE1
+    const __m128 zero = _mm_setzero_ps();
+    if (channels == 1) {
+        for (; f + 4 <= frameCount; f += 4) {
+            __m128 x = _mm_loadu_ps(frames + f);
+            _mm_storeu_ps(peaks + f, _mm_max_ps(x, _mm_sub_ps(zero, x)));
+        }
+    }
+    else if (channels == 2) {
+        for (; f + 4 <= frameCount; f += 4) {
+            __m128 a = _mm_loadu_ps(frames + f * 2);
+            __m128 b = _mm_loadu_ps(frames + f * 2 + 4);
+            a = _mm_max_ps(a, _mm_sub_ps(zero, a));
+            b = _mm_max_ps(b, _mm_sub_ps(zero, b));
+            a = _mm_max_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+            b = _mm_max_ps(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1)));
+            _mm_storeu_ps(peaks + f, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        }
+    }
+#elif defined(AUDIO_SIMD_NEON)
+    if (channels == 1) {
+        for (; f + 4 <= frameCount; f += 4) {
+            vst1q_f32(peaks + f, vabsq_f32(vld1q_f32(frames + f)));
+        }
+    }
+    else if (channels == 2) {
+        for (; f + 4 <= frameCount; f += 4) {
+            float32x4_t a = vabsq_f32(vld1q_f32(frames + f * 2));
+            float32x4_t b = vabsq_f32(vld1q_f32(frames + f * 2 + 4));
+            a = vmaxq_f32(a, vrev64q_f32(a));
+            b = vmaxq_f32(b, vrev64q_f32(b));
+            vst1q_f32(peaks + f, vuzpq_f32(a, b).val[0]);
+        }
+    }
+#endif
+    for (; f < frameCount; f++) {
+        float peak = 0.0f;
+        for (size_t c = 0; c < channels; c++) {
+            float value = frames[f * channels + c];
+            value = (value < 0.0f) ? -value : value;
+            peak = (value > peak) ? value : peak;
+        }
+        peaks[f] = peak;
+    }
+}
+
+// dst[f * channels + c] = src[f * channels + c] * gains[f]
+inline void ApplyFrameGains(float* dst, const float* src, const float* gains, size_t frameCount, size_t channels) {
+    if (channels == 1) {
+        Multiply(dst, src, gains, frameCount);
+        return;
+    }
+
+    size_t f = 0;
+#if defined(AUDIO_SIMD_SSE)
+    if (channels == 2) {
+        for (; f + 4 <= frameCount; f += 4) {
+            __m128 g = _mm_loadu_ps(gains + f);
+            _mm_storeu_ps(dst + f * 2, _mm_mul_ps(_mm_loadu_ps(src + f * 2), _mm_unpacklo_ps(g, g)));
+            _mm_storeu_ps(dst + f * 2 + 4, _mm_mul_ps(_mm_loadu_ps(src + f * 2 + 4), _mm_unpackhi_ps(g, g)));
+        }
+    }
+#elif defined(AUDIO_SIMD_NEON)
+    if (channels == 2) {
+        for (; f + 4 <= frameCount; f += 4) {
+            float32x4x2_t g = vzipq_f32(vld1q_f32(gains + f), vld1q_f32(gains + f));
+            vst1q_f32(dst + f * 2, vmulq_f32(vld1q_f32(src + f * 2), g.val[0]));
+            vst1q_f32(dst + f * 2 + 4, vmulq_f32(vld1q_f32(src + f * 2 + 4), g.val[1]));
+        }
+    }
+#endif
+    for (; f < frameCount; f++) {
+        for (size_t c = 0; c < channels; c++) {
+            dst[f * channels + c] = src[f * channels + c] * gains[f];
+        }
+    }
+}
+
+// Sum of a[i] * b[i]
+inline float DotProduct(const float* a, const float* b, size_t count) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(AUDIO_SIMD_SSE)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    }
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(1, 1, 1, 1)));
+    sum = _mm_cvtss_f32(acc);
+#elif defined(AUDIO_SIMD_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= count; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+    }
+    float32x2_t half = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(half, half), 0);
+#endif
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// dst = a + (b - a) * t
+inline void Lerp(float* dst, const float* a, const float* b, float t, size_t count) {
+    size_t i = 0;
+#if defined(AUDIO_SIMD_SSE)
+    __m128 w = _mm_set1_ps(t);
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(a + i);
+        _mm_storeu_ps(dst + i, _mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(b + i), x), w)));
+    }
+#elif defined(AUDIO_SIMD_NEON)
+    float32x4_t w = vdupq_n_f32(t);
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(a + i);
+        vst1q_f32(dst + i, vmlaq_f32(x, vsubq_f32(vld1q_f32(b + i), x), w));
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = a[i] + (b[i] - a[i]) * t;
+    }
+}
+
+} // namespace AudioSIMD
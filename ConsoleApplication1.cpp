@@ -1,17 +1,53 @@
 #include <iostream>
 #include <memory>
 
+#include "AssetImporter.h"
 #include "AudioEngine.h"
+#include "Dynamics.h"
+#include "LatencyHarness.h"
 #include "SoundComponent.h"
 #include "SoundSystem.h"
 
-int main()
+int main(int argc, char* argv[])
 {
     // -----------------------
 // 1) At startup (once):
 // -----------------------
     auto soundSystem = std::make_shared<SoundSystem>();
 
+    // "--import-assets [directory]" converts assets to the engine's format and exits.
+    // Rerun it whenever assets change; stale imports are ignored until then.
+    if (argc > 1 && std::string(argv[1]) == "--import-assets") {
+        // At the rate the engine runs at, so loading an import needs no conversion
+        AssetImporter importer(AudioEngineConfig().cacheDirectory, ma_engine_get_sample_rate(AudioEngine::Instance().GetEngine()));
+        AssetImporter::Report report = importer.ImportDirectory(argc > 2 ? argv[2] : "ASSETS");
+        std::cout << "Imported " << report.converted << ", up to date " << report.upToDate
+            << ", failed " << report.failed << "\n";
+        return report.failed == 0 ? 0 : 1;
+    }
+
+    // "--latency-test [--hardware] [--loopback]" prints trigger-to-output latency for a
+    // range of period sizes and voice counts, on the null device unless told otherwise
+    if (argc > 1 && std::string(argv[1]) == "--latency-test") {
+        LatencyHarnessConfig harnessConfig;
+        for (int i = 2; i < argc; i++) {
+            if (std::string(argv[i]) == "--hardware") harnessConfig.nullDevice = false;
+            if (std::string(argv[i]) == "--loopback") harnessConfig.loopback = true;
+        }
+        LatencyHarness harness(harnessConfig);
+        LatencyHarness::Print(harness.Run(), std::cout);
+        return 0;
+    }
+
+    // Or run streaming/decode jobs on the game's own job system:
+    // AudioEngineConfig audioConfig;
+    // audioConfig.hostResourceJobs = true;   // then call AudioEngine::Instance().ProcessJobs() from a job
+    // audioConfig.pcmCacheBudget = 32 * 1024 * 1024;   // decoded sound memory; the rest streams
+    // audioConfig.periodSizeInFrames = 128;             // small periods on low-latency rigs, bigger on weak machines
+    // audioConfig.periods = 2;                          // AudioEngine::GetDeviceLatency() reports what the device settled on
+    // audioConfig.listenerCount = 2;                    // split-screen: SetListenerPosition(x, y, z, 1) for player two
+    // auto soundSystem = std::make_shared<SoundSystem>(audioConfig);
+
     // Set up listener (usually follows player/camera)
     AudioEngine::Instance().SetListenerPosition(0.0f, 0.0f, 0.0f);  // X, Y, Z
     AudioEngine::Instance().SetListenerDirection(0.0f, 0.0f, -1.0f); // Facing forward
@@ -23,6 +59,38 @@ int main()
     // auto devices = AudioEngine::Instance().GetAudioDevices();
     // AudioEngine::Instance().SetAudioDevice(devices[1]);
 
+    // Optionally add insert effects to a category bus (one instance processes the whole bus):
+    // AudioEngine::Instance().GetBusEffects(AudioCategory::AMBIENT)->AddEffect(std::make_shared<ReverbEffect>(0.8f));
+    // AudioEngine::Instance().GetBusEffects(AudioCategory::MUSIC)->AddEffect(std::make_shared<LowPassEffect>(1200.0f));
+
+    // Optionally keep the final mix under -1 dBFS and glue the music bus together:
+    // AudioEngine::Instance().GetMasterEffects()->AddEffect(std::make_shared<LimiterEffect>(-1.0f));
+    // AudioEngine::Instance().GetBusEffects(AudioCategory::MUSIC)->AddEffect(std::make_shared<CompressorEffect>(-18.0f, 3.0f));
+
+    // Optionally duck music under dialogue:
+    // AudioEngine::Instance().SetDucking(AudioCategory::MUSIC, AudioCategory::VOICE);
+
+    // Optionally send voice chat to a headset while the game plays on the speakers:
+    // AudioEngine::Instance().AddOutputEndpoint("comms", AudioEngine::Instance().GetAudioDevices()[1]);
+    // AudioEngine::Instance().SetCategoryOutput(AudioCategory::VOICE, "comms");
+
+    // Optionally capture the mix for a bug report (written on a background thread):
+    // AudioEngine::Instance().StartRecording("session.wav");
+
+    // Optionally feed the microphone into the VOICE bus (needs Microphone.h):
+    // MicrophoneConfig micConfig;
+    // micConfig.monitor = true;                         // hear yourself; GetMicrophoneStats() reports the latency
+    // AudioEngine::Instance().StartMicrophone(micConfig);
+    // AudioEngine::Instance().GetMicrophone()->SetCaptureTap(true);   // then ReadProcessed() each frame for voice chat
+
+    // Optionally render positional sounds binaurally for headphones:
+    // AudioEngine::Instance().SetCategorySpatialization(AudioCategory::SFX, SpatializationMode::Hrtf);
+
+    // Optionally feed occlusion from the game's raycasts (one batched call per Update):
+    // AudioEngine::Instance().SetOcclusionCallback([](std::vector<OcclusionQuery>& queries) {
+    //     for (auto& query : queries) query.occlusion = /* raycast query.listener -> query.position */ 0.0f;
+    // });
+
 
     // -----------------------
     // 2) Load your assets:
@@ -36,6 +104,12 @@ int main()
 
     // a) load a sound effect
     SoundComponent::AddMusic("footstep", "ASSETS/SOUND/magic-spell.wav", AudioCategory::SFX);
+    // Long ambiences can stay compressed in RAM instead of decoding or streaming:
+    // SoundComponent::AddSound("wind", "ASSETS/SOUND/magic-spell-333896.mp3", AudioCategory::AMBIENT, LoadPolicy::CompressedInMemory);
+    // Or synthesize it, with no asset at all (needs Procedural.h):
+    // SoundComponent::AddSound("wind", std::make_shared<NoiseSource>(NoiseSource::Color::Pink, 0.3f), AudioCategory::AMBIENT);
+    // or grow an endless bed from a few seconds of material (needs Granular.h):
+    // SoundComponent::AddSound("rain", std::make_shared<GranularSource>("ASSETS/SOUND/magic-spell.wav"), AudioCategory::AMBIENT);
 
     //// b) load background music
     //SoundComponent::AddMusic("bgm", "ASSETS/SOUND/magic-spell.wav", AudioCategory::MUSIC);
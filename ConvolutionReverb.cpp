@@ -0,0 +1,443 @@
+#include "miniaudio.h"
+#include "ConvolutionReverb.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+// Tail partitions are this many times larger than head partitions
+static const size_t g_tailBlockMultiplier = 8;
+
+// ---------------------------------------------------------------------------
+// PartitionedConvolver
+// ---------------------------------------------------------------------------
+
+PartitionedConvolver::PartitionedConvolver()
+    : blockSize(0)
+    , binCount(0)
+    , partitionCount(0)
+    , irChannels(0)
+    , channels(0)
+    , fdlIndex(0)
+{
+}
+
+void PartitionedConvolver::Init(const std::vector<std::vector<float>>& ir, size_t offset, size_t length,
+    size_t blockSize, ma_uint32 channels) {
+    this->blockSize = blockSize;
+    this->channels = channels;
+    irChannels = ir.size();
+    partitionCount = (length + blockSize - 1) / blockSize;
+    fdlIndex = 0;
+
+    if (partitionCount == 0 || irChannels == 0) {
+        partitionCount = 0;
+        return;
+    }
+
+    fft.reset(new RealFFT(blockSize * 2));
+    binCount = fft->GetBinCount();
+
+    // Pre-transform every zero-padded IR partition
+    filterRe.assign(irChannels * partitionCount * binCount, 0.0f);
+    filterIm.assign(irChannels * partitionCount * binCount, 0.0f);
+    timeBuffer.assign(blockSize * 2, 0.0f);
+
+    for (size_t c = 0; c < irChannels; c++) {
+        for (size_t p = 0; p < partitionCount; p++) {
+            std::fill(timeBuffer.begin(), timeBuffer.end(), 0.0f);
+            for (size_t i = 0; i < blockSize; i++) {
+                size_t index = offset + p * blockSize + i;
+                if (index >= offset + length || index >= ir[c].size()) break;
+                timeBuffer[i] = ir[c][index];
+            }
+
+            size_t base = (c * partitionCount + p) * binCount;
+            fft->Forward(timeBuffer.data(), &filterRe[base], &filterIm[base]);
+        }
+    }
+
+    fdlRe.assign(channels * partitionCount * binCount, 0.0f);
+    fdlIm.assign(channels * partitionCount * binCount, 0.0f);
+    window.assign(channels * blockSize * 2, 0.0f);
+    accRe.assign(binCount, 0.0f);
+    accIm.assign(binCount, 0.0f);
+}
+
+bool PartitionedConvolver::IsEmpty() const {
+    return partitionCount == 0;
+}
+
+size_t PartitionedConvolver::GetBlockSize() const {
+    return blockSize;
+}
+
+void PartitionedConvolver::ProcessBlock(const float* const* input, float* const* output) {
+    for (ma_uint32 c = 0; c < channels; c++) {
+        // Slide the overlap-save window along by one block
+        float* pWindow = &window[c * blockSize * 2];
+        std::copy(pWindow + blockSize, pWindow + blockSize * 2, pWindow);
+        std::copy(input[c], input[c] + blockSize, pWindow + blockSize);
+
+        size_t fdlBase = c * partitionCount * binCount;
+        fft->Forward(pWindow, &fdlRe[fdlBase + fdlIndex * binCount], &fdlIm[fdlBase + fdlIndex * binCount]);
+
+        // Sum every past input spectrum against its matching IR partition
+        std::fill(accRe.begin(), accRe.end(), 0.0f);
+        std::fill(accIm.begin(), accIm.end(), 0.0f);
+
+        size_t filterBase = ((irChannels == 1) ? 0 : c) * partitionCount * binCount;
+        for (size_t p = 0; p < partitionCount; p++) {
+            size_t slot = (fdlIndex + partitionCount - p) % partitionCount;
+            AudioSIMD::ComplexMultiplyAccumulate(accRe.data(), accIm.data(),
+                &fdlRe[fdlBase + slot * binCount], &fdlIm[fdlBase + slot * binCount],
+                &filterRe[filterBase + p * binCount], &filterIm[filterBase + p * binCount], binCount);
+        }
+
+        // The second half of the circular result is the valid linear convolution
+        fft->Inverse(accRe.data(), accIm.data(), timeBuffer.data());
+        std::copy(timeBuffer.begin() + blockSize, timeBuffer.end(), output[c]);
+    }
+
+    fdlIndex = (fdlIndex + 1) % partitionCount;
+}
+
+void PartitionedConvolver::SkipBlocks(size_t count) {
+    if (partitionCount == 0) return;
+
+    // Beyond this the whole history is silence already
+    count = std::min(count, partitionCount + 1);
+    for (size_t i = 0; i < count; i++) {
+        SkipBlock();
+    }
+}
+
+void PartitionedConvolver::SkipBlock() {
+    for (ma_uint32 c = 0; c < channels; c++) {
+        float* pWindow = &window[c * blockSize * 2];
+        std::copy(pWindow + blockSize, pWindow + blockSize * 2, pWindow);
+        std::fill(pWindow + blockSize, pWindow + blockSize * 2, 0.0f);
+
+        size_t fdlBase = c * partitionCount * binCount;
+        fft->Forward(pWindow, &fdlRe[fdlBase + fdlIndex * binCount], &fdlIm[fdlBase + fdlIndex * binCount]);
+    }
+
+    fdlIndex = (fdlIndex + 1) % partitionCount;
+}
+
+// ---------------------------------------------------------------------------
+// ConvolutionReverbEffect
+// ---------------------------------------------------------------------------
+
+ConvolutionReverbEffect::ConvolutionReverbEffect(const std::string& impulseResponsePath, float wet,
+    bool useWorkerThread, ma_uint32 blockSize)
+    : loaded(false)
+    , irLength(0)
+    , headBlockSize(0)
+    , tailBlockSize(0)
+    , headFill(0)
+    , tailFill(0)
+    , ringMask(0)
+    , framesProcessed(0)
+    , jobTarget(0)
+    , jobSkippedBlocks(0)
+    , tailState(TailIdle)
+    , skippedTailBlocks(0)
+    , jobLate(false)
+    , useWorkerThread(useWorkerThread)
+    , workerRunning(false)
+    , wet(0.0f)
+    , dry(1.0f)
+{
+    SetWet(wet);
+
+    if (channels == 0) return;
+
+    std::vector<std::vector<float>> ir;
+    if (!LoadImpulseResponse(impulseResponsePath, ir)) return;
+
+    // Round the head block up to a power of two for the FFT
+    headBlockSize = 64;
+    while (headBlockSize < blockSize) headBlockSize <<= 1;
+    tailBlockSize = headBlockSize * g_tailBlockMultiplier;
+
+    // The head covers two tail blocks, which is how far ahead the tail is scheduled
+    size_t headLength = std::min(irLength, tailBlockSize * 2);
+    head.Init(ir, 0, headLength, headBlockSize, channels);
+    if (irLength > headLength) {
+        tail.Init(ir, headLength, irLength - headLength, tailBlockSize, channels);
+    }
+
+    size_t ringSize = 1;
+    while (ringSize < tailBlockSize * 4) ringSize <<= 1;
+    ringMask = ringSize - 1;
+
+    headInput.assign(channels, std::vector<float>(headBlockSize, 0.0f));
+    headOutput.assign(channels, std::vector<float>(headBlockSize, 0.0f));
+    ring.assign(channels, std::vector<float>(ringSize, 0.0f));
+
+    if (!tail.IsEmpty()) {
+        tailInput.assign(channels, std::vector<float>(tailBlockSize, 0.0f));
+        jobInput.assign(channels, std::vector<float>(tailBlockSize, 0.0f));
+        jobOutput.assign(channels, std::vector<float>(tailBlockSize, 0.0f));
+
+        if (this->useWorkerThread) {
+            workerRunning = true;
+            worker = std::thread(&ConvolutionReverbEffect::WorkerLoop, this);
+        }
+    }
+
+    loaded = true;
+    InitNode();
+}
+
+ConvolutionReverbEffect::~ConvolutionReverbEffect() {
+    UninitNode();
+
+    if (worker.joinable()) {
+        workerRunning = false;
+        workerCondition.notify_one();
+        worker.join();
+    }
+}
+
+bool ConvolutionReverbEffect::IsLoaded() const {
+    return loaded;
+}
+
+float ConvolutionReverbEffect::GetImpulseResponseDuration() const {
+    if (sampleRate == 0) return 0.0f;
+    return static_cast<float>(irLength) / sampleRate;
+}
+
+void ConvolutionReverbEffect::SetWet(float value) {
+    wet.store(std::max(0.0f, std::min(value, 1.0f)));
+}
+
+float ConvolutionReverbEffect::GetWet() const {
+    return wet.load();
+}
+
+void ConvolutionReverbEffect::SetDry(float value) {
+    dry.store(std::max(0.0f, std::min(value, 1.0f)));
+}
+
+float ConvolutionReverbEffect::GetDry() const {
+    return dry.load();
+}
+
+bool ConvolutionReverbEffect::LoadImpulseResponse(const std::string& path, std::vector<std::vector<float>>& ir) {
+    ma_resource_manager* resourceManager = ma_engine_get_resource_manager(engine);
+    if (!resourceManager) return false;
+
+    ma_resource_manager_data_source dataSource;
+    ma_result result = ma_resource_manager_data_source_init(resourceManager, path.c_str(),
+        MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_DECODE, NULL, &dataSource);
+    if (result != MA_SUCCESS) return false;
+
+    ma_format format;
+    ma_uint32 sourceChannels;
+    ma_uint32 sourceRate;
+    ma_data_source_get_data_format(&dataSource, &format, &sourceChannels, &sourceRate, NULL, 0);
+
+    // Read everything the resource manager decoded
+    std::vector<float> frames;
+    std::vector<ma_uint8> chunk(4096 * ma_get_bytes_per_frame(format, sourceChannels));
+    ma_uint64 totalFrames = 0;
+    for (;;) {
+        ma_uint64 framesRead = 0;
+        ma_data_source_read_pcm_frames(&dataSource, chunk.data(), 4096, &framesRead);
+        if (framesRead == 0) break;
+
+        frames.resize(static_cast<size_t>((totalFrames + framesRead) * sourceChannels));
+        ma_pcm_convert(&frames[static_cast<size_t>(totalFrames * sourceChannels)], ma_format_f32,
+            chunk.data(), format, framesRead * sourceChannels, ma_dither_mode_none);
+        totalFrames += framesRead;
+    }
+    ma_resource_manager_data_source_uninit(&dataSource);
+
+    if (totalFrames == 0 || sourceChannels == 0) return false;
+
+    // Mono IRs are shared by every channel; anything else is mapped to the engine layout
+    ma_uint32 irChannels = (sourceChannels == 1) ? 1 : channels;
+    if (sourceChannels != irChannels || sourceRate != sampleRate) {
+        ma_uint64 convertedFrames = ma_convert_frames(NULL, 0, ma_format_f32, irChannels, sampleRate,
+            frames.data(), totalFrames, ma_format_f32, sourceChannels, sourceRate);
+        std::vector<float> converted(static_cast<size_t>(convertedFrames * irChannels));
+        totalFrames = ma_convert_frames(converted.data(), convertedFrames, ma_format_f32, irChannels, sampleRate,
+            frames.data(), totalFrames, ma_format_f32, sourceChannels, sourceRate);
+        frames.swap(converted);
+    }
+
+    irLength = static_cast<size_t>(totalFrames);
+    ir.assign(irChannels, std::vector<float>(irLength, 0.0f));
+
+    // Deinterleave and normalise to unit energy per channel so IRs have comparable loudness
+    double energy = 0.0;
+    for (size_t i = 0; i < irLength; i++) {
+        for (ma_uint32 c = 0; c < irChannels; c++) {
+            float sample = frames[i * irChannels + c];
+            ir[c][i] = sample;
+            energy += static_cast<double>(sample) * sample;
+        }
+    }
+
+    if (energy > 0.0) {
+        float scale = static_cast<float>(1.0 / std::sqrt(energy / irChannels));
+        for (auto& channel : ir) {
+            for (float& sample : channel) sample *= scale;
+        }
+    }
+
+    return true;
+}
+
+void ConvolutionReverbEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const float wetGain = wet.load(std::memory_order_relaxed);
+    const float dryGain = dry.load(std::memory_order_relaxed);
+    const bool hasTail = !tail.IsEmpty();
+
+    ma_uint32 frame = 0;
+    while (frame < frameCount) {
+        // Run up to the next head block boundary
+        ma_uint32 count = static_cast<ma_uint32>(std::min<size_t>(frameCount - frame, headBlockSize - headFill));
+
+        for (ma_uint32 i = 0; i < count; i++) {
+            // Output lags the input by one head block
+            size_t readIndex = static_cast<size_t>(framesProcessed + ringMask + 1 - headBlockSize) & ringMask;
+            const float* pIn = &pFramesIn[(frame + i) * channels];
+            float* pOut = &pFramesOut[(frame + i) * channels];
+
+            for (ma_uint32 c = 0; c < channels; c++) {
+                headInput[c][headFill + i] = pIn[c];
+                if (hasTail) tailInput[c][tailFill + i] = pIn[c];
+
+                pOut[c] = pIn[c] * dryGain + ring[c][readIndex] * wetGain;
+                ring[c][readIndex] = 0.0f;
+            }
+            framesProcessed++;
+        }
+
+        frame += count;
+        headFill += count;
+        if (hasTail) tailFill += count;
+
+        if (headFill == headBlockSize) {
+            OnHeadBlock();
+            headFill = 0;
+        }
+        if (hasTail && tailFill == tailBlockSize) {
+            OnTailBlock();
+            tailFill = 0;
+        }
+    }
+}
+
+void ConvolutionReverbEffect::OnHeadBlock() {
+    float* inputs[MA_MAX_CHANNELS];
+    float* outputs[MA_MAX_CHANNELS];
+    for (ma_uint32 c = 0; c < channels; c++) {
+        inputs[c] = headInput[c].data();
+        outputs[c] = headOutput[c].data();
+    }
+    head.ProcessBlock(inputs, outputs);
+
+    ma_uint64 blockStart = framesProcessed - headBlockSize;
+    for (ma_uint32 c = 0; c < channels; c++) {
+        for (size_t i = 0; i < headBlockSize; i++) {
+            ring[c][static_cast<size_t>(blockStart + i) & ringMask] += headOutput[c][i];
+        }
+    }
+}
+
+void ConvolutionReverbEffect::OnTailBlock() {
+    // Collect the block handed out one tail period ago
+    int state = tailState.load(std::memory_order_acquire);
+    if (state == TailPending) {
+        if (tailState.compare_exchange_strong(state, TailRunning, std::memory_order_acq_rel)) {
+            // The worker never picked it up; do it here rather than drop it
+            RunTailJob();
+            tailState.store(TailDone, std::memory_order_release);
+            state = TailDone;
+        }
+    }
+
+    if (state == TailRunning) {
+        // The worker overran its period. Its output is already too late to use, and
+        // the convolver is busy, so this block can't be handed out either; it goes
+        // into the history as silence with the next job.
+        jobLate = true;
+        skippedTailBlocks++;
+        return;
+    }
+
+    if (state == TailDone) {
+        if (!jobLate) {
+            for (ma_uint32 c = 0; c < channels; c++) {
+                for (size_t i = 0; i < tailBlockSize; i++) {
+                    ring[c][static_cast<size_t>(jobTarget + i) & ringMask] += jobOutput[c][i];
+                }
+            }
+        }
+        jobLate = false;
+    }
+
+    // Hand out the block that just completed. Its output lands two tail blocks
+    // after its start, which is where the head segment ends.
+    for (ma_uint32 c = 0; c < channels; c++) {
+        std::copy(tailInput[c].begin(), tailInput[c].end(), jobInput[c].begin());
+    }
+    jobTarget = framesProcessed - tailBlockSize + tailBlockSize * 2;
+    jobSkippedBlocks = skippedTailBlocks;
+    skippedTailBlocks = 0;
+
+    if (useWorkerThread) {
+        tailState.store(TailPending, std::memory_order_release);
+        workerCondition.notify_one();
+    }
+    else {
+        tailState.store(TailRunning, std::memory_order_release);
+        RunTailJob();
+        tailState.store(TailDone, std::memory_order_release);
+    }
+}
+
+void ConvolutionReverbEffect::RunTailJob() {
+    tail.SkipBlocks(jobSkippedBlocks);
+
+    float* inputs[MA_MAX_CHANNELS];
+    float* outputs[MA_MAX_CHANNELS];
+    for (ma_uint32 c = 0; c < channels; c++) {
+        inputs[c] = jobInput[c].data();
+        outputs[c] = jobOutput[c].data();
+    }
+    tail.ProcessBlock(inputs, outputs);
+}
+
+void ConvolutionReverbEffect::WorkerLoop() {
+    while (workerRunning.load()) {
+        {
+            // The audio thread notifies without taking the lock, so poll as a fallback
+            std::unique_lock<std::mutex> lock(workerMutex);
+            workerCondition.wait_for(lock, std::chrono::milliseconds(2), [this] {
+                return tailState.load() == TailPending || !workerRunning.load();
+            });
+        }
+
+        int expected = TailPending;
+        if (tailState.compare_exchange_strong(expected, TailRunning, std::memory_order_acq_rel)) {
+            RunTailJob();
+            tailState.store(TailDone, std::memory_order_release);
+        }
+    }
+}
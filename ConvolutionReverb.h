@@ -0,0 +1,136 @@
+#pragma once
+
+#include "AudioEffect.h"
+#include "FFT.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Uniformly partitioned overlap-save convolver for one segment of an impulse
+// response. Each call consumes and produces exactly one block per channel.
+class PartitionedConvolver {
+public:
+    PartitionedConvolver();
+
+    // ir holds either one channel shared by every input channel, or one per channel.
+    // Only samples [offset, offset + length) of the impulse response are used.
+    void Init(const std::vector<std::vector<float>>& ir, size_t offset, size_t length,
+        size_t blockSize, ma_uint32 channels);
+
+    bool IsEmpty() const;
+    size_t GetBlockSize() const;
+
+    void ProcessBlock(const float* const* input, float* const* output);
+
+    // Advances the history by count blocks of silence without producing output, for
+    // blocks whose input was dropped. Keeps later blocks at the right partitions.
+    void SkipBlocks(size_t count);
+
+private:
+    void SkipBlock();
+
+    size_t blockSize;
+    size_t binCount;
+    size_t partitionCount;
+    size_t irChannels;
+    ma_uint32 channels;
+    size_t fdlIndex;
+    std::unique_ptr<RealFFT> fft;
+
+    // Spectra are laid out [channel][partition][bin]
+    std::vector<float> filterRe;
+    std::vector<float> filterIm;
+    std::vector<float> fdlRe;       // Frequency-domain delay line of past input blocks
+    std::vector<float> fdlIm;
+    std::vector<float> window;      // Last two input blocks per channel
+    std::vector<float> accRe;
+    std::vector<float> accIm;
+    std::vector<float> timeBuffer;
+};
+
+// Convolution reverb with a non-uniform partitioning: the head of the impulse
+// response is convolved in small blocks on the audio thread for low latency, and
+// the long tail in large blocks, optionally on a worker thread. The tail is
+// scheduled one large block ahead of when its output is needed, so the worker has
+// a full block period to finish; if it has not even started by then, the audio
+// thread processes the block itself. The audio thread never waits for a worker
+// that is still running: that block's tail output is dropped, and the input block
+// it couldn't hand out enters the tail's history as silence.
+//
+// The wet signal is delayed by one head block (blockSize frames).
+class ConvolutionReverbEffect : public AudioEffect {
+public:
+    // The impulse response is loaded through the engine's resource manager, so
+    // any path or format that works for Sound works here.
+    ConvolutionReverbEffect(const std::string& impulseResponsePath, float wet = 0.3f,
+        bool useWorkerThread = true, ma_uint32 blockSize = 256);
+    ~ConvolutionReverbEffect() override;
+
+    bool IsLoaded() const;
+    float GetImpulseResponseDuration() const;
+
+    void SetWet(float wet);   // 0.0 to 1.0
+    float GetWet() const;
+    void SetDry(float dry);   // 0.0 to 1.0
+    float GetDry() const;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    enum TailState {
+        TailIdle,
+        TailPending,
+        TailRunning,
+        TailDone
+    };
+
+    bool LoadImpulseResponse(const std::string& path, std::vector<std::vector<float>>& ir);
+    void OnHeadBlock();
+    void OnTailBlock();
+    void RunTailJob();
+    void WorkerLoop();
+
+    bool loaded;
+    size_t irLength;
+    size_t headBlockSize;
+    size_t tailBlockSize;
+
+    PartitionedConvolver head;
+    PartitionedConvolver tail;
+
+    // Deinterleaved input collected until a block is complete
+    std::vector<std::vector<float>> headInput;
+    std::vector<std::vector<float>> headOutput;
+    std::vector<std::vector<float>> tailInput;
+    size_t headFill;
+    size_t tailFill;
+
+    // Convolution output accumulated at its output position, per channel
+    std::vector<std::vector<float>> ring;
+    size_t ringMask;
+    ma_uint64 framesProcessed;
+
+    // Tail job handed between the audio thread and the worker
+    std::vector<std::vector<float>> jobInput;
+    std::vector<std::vector<float>> jobOutput;
+    ma_uint64 jobTarget;
+    size_t jobSkippedBlocks;        // Silent blocks to push before the job's own
+    std::atomic<int> tailState;
+    size_t skippedTailBlocks;       // Audio thread; input blocks not handed out yet
+    bool jobLate;                   // Audio thread; the job in flight missed its deadline
+
+    bool useWorkerThread;
+    std::thread worker;
+    std::mutex workerMutex;
+    std::condition_variable workerCondition;
+    std::atomic<bool> workerRunning;
+
+    std::atomic<float> wet;
+    std::atomic<float> dry;
+};
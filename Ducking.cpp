@@ -0,0 +1,131 @@
+#include "miniaudio.h"
+#include "Ducking.h"
+
+#include <algorithm>
+#include <cmath>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_uint32 DuckerEffect::KeyInputBus;
+
+// Key detector ballistics; the user attack/release shape the gain instead
+static const float g_detectorAttack = 0.002f;
+static const float g_detectorRelease = 0.08f;
+
+// Ducking goes from none at the threshold to full depth this far above it
+static const float g_kneeRatio = 2.0f;  // 6dB
+
+static float TimeToCoefficient(float seconds, ma_uint32 sampleRate) {
+    if (seconds <= 0.0f || sampleRate == 0) return 0.0f;
+    return std::exp(-1.0f / (seconds * sampleRate));
+}
+
+// ---------------------------------------------------------------------------
+// SidechainSendEffect
+// ---------------------------------------------------------------------------
+
+SidechainSendEffect::SidechainSendEffect() {
+    InitNode(1, 2);
+}
+
+SidechainSendEffect::~SidechainSendEffect() {
+    UninitNode();
+}
+
+void SidechainSendEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    ma_copy_pcm_frames(pFramesOut, ppFramesIn[0], frameCount, ma_format_f32, channels);
+}
+
+// ---------------------------------------------------------------------------
+// DuckerEffect
+// ---------------------------------------------------------------------------
+
+DuckerEffect::DuckerEffect(const DuckingSettings& settings)
+    : thresholdDb(settings.thresholdDb)
+    , depthDb(settings.depthDb)
+    , attackTime(settings.attackTime)
+    , releaseTime(settings.releaseTime)
+    , gainReduction(0.0f)
+    , threshold(1.0f)
+    , depthGain(1.0f)
+    , attackCoefficient(0.0f)
+    , releaseCoefficient(0.0f)
+    , envelope(0.0f)
+    , gain(1.0f)
+{
+    InitNode(2);
+}
+
+DuckerEffect::~DuckerEffect() {
+    UninitNode();
+}
+
+void DuckerEffect::SetSettings(const DuckingSettings& settings) {
+    thresholdDb.store(std::min(settings.thresholdDb, 0.0f));
+    depthDb.store(std::max(0.0f, settings.depthDb));
+    attackTime.store(std::max(0.0f, settings.attackTime));
+    releaseTime.store(std::max(0.0f, settings.releaseTime));
+    MarkParametersDirty();
+}
+
+DuckingSettings DuckerEffect::GetSettings() const {
+    DuckingSettings settings;
+    settings.thresholdDb = thresholdDb.load();
+    settings.depthDb = depthDb.load();
+    settings.attackTime = attackTime.load();
+    settings.releaseTime = releaseTime.load();
+    return settings;
+}
+
+float DuckerEffect::GetGainReduction() const {
+    return gainReduction.load(std::memory_order_relaxed);
+}
+
+void DuckerEffect::ApplyParameters() {
+    threshold = std::pow(10.0f, thresholdDb.load() / 20.0f);
+    depthGain = std::pow(10.0f, -depthDb.load() / 20.0f);
+    attackCoefficient = TimeToCoefficient(attackTime.load(), sampleRate);
+    releaseCoefficient = TimeToCoefficient(releaseTime.load(), sampleRate);
+}
+
+void DuckerEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const float* pKeyIn = ppFramesIn[KeyInputBus];
+
+    const float detectorAttack = TimeToCoefficient(g_detectorAttack, sampleRate);
+    const float detectorRelease = TimeToCoefficient(g_detectorRelease, sampleRate);
+    const float kneeScale = 1.0f / (threshold * (g_kneeRatio - 1.0f));
+
+    for (ma_uint32 frame = 0; frame < frameCount; frame++) {
+        const float* pKey = &pKeyIn[frame * channels];
+        float peak = 0.0f;
+        for (ma_uint32 c = 0; c < channels; c++) {
+            peak = std::max(peak, std::fabs(pKey[c]));
+        }
+
+        float detector = (peak > envelope) ? detectorAttack : detectorRelease;
+        envelope = peak + (envelope - peak) * detector;
+
+        // Linear-domain soft knee keeps log/exp out of the per-sample loop
+        float amount = std::max(0.0f, std::min((envelope - threshold) * kneeScale, 1.0f));
+        float targetGain = 1.0f + (depthGain - 1.0f) * amount;
+
+        float smoothing = (targetGain < gain) ? attackCoefficient : releaseCoefficient;
+        gain = targetGain + (gain - targetGain) * smoothing;
+
+        const float* pIn = &pFramesIn[frame * channels];
+        float* pOut = &pFramesOut[frame * channels];
+        for (ma_uint32 c = 0; c < channels; c++) {
+            pOut[c] = pIn[c] * gain;
+        }
+    }
+
+    if (envelope < 1e-9f) envelope = 0.0f;
+    gainReduction.store(std::max(0.0f, -20.0f * std::log10(std::max(gain, 1e-6f))), std::memory_order_relaxed);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "AudioEffect.h"
+
+#include <atomic>
+
+// How a ducked bus reacts to its key
+struct DuckingSettings {
+    float thresholdDb = -40.0f;     // Key level where ducking starts
+    float depthDb = 12.0f;          // Reduction once the key is 6dB over the threshold
+    float attackTime = 0.05f;       // Seconds to duck
+    float releaseTime = 0.5f;       // Seconds to recover
+};
+
+// Pass-through effect with a second output bus carrying a copy of its signal.
+// Put it at the end of the key bus's chain and attach output bus 1 to a ducker's
+// key input.
+class SidechainSendEffect : public AudioEffect {
+public:
+    SidechainSendEffect();
+    ~SidechainSendEffect() override;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+};
+
+// Sidechain ducker. Input bus 0 is the signal being ducked, input bus 1 the key.
+// A peak envelope follower on the key drives gain reduction per sample, so the
+// duck lands on the exact frame the key crosses the threshold.
+class DuckerEffect : public AudioEffect {
+public:
+    static const ma_uint32 KeyInputBus = 1;
+
+    explicit DuckerEffect(const DuckingSettings& settings = DuckingSettings());
+    ~DuckerEffect() override;
+
+    void SetSettings(const DuckingSettings& settings);
+    DuckingSettings GetSettings() const;
+
+    // Current gain reduction in dB (0 when not ducking), updated every block
+    float GetGainReduction() const override;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    std::atomic<float> thresholdDb;
+    std::atomic<float> depthDb;
+    std::atomic<float> attackTime;
+    std::atomic<float> releaseTime;
+    std::atomic<float> gainReduction;
+
+    // Derived on the audio thread by ApplyParameters()
+    float threshold;
+    float depthGain;
+    float attackCoefficient;
+    float releaseCoefficient;
+
+    float envelope;
+    float gain;
+};
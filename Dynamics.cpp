@@ -0,0 +1,291 @@
+#include "miniaudio.h"
+#include "Dynamics.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_uint32 LimiterEffect::ChunkFrames;
+const ma_uint32 CompressorEffect::ChunkFrames;
+
+static float TimeToCoefficient(float seconds, ma_uint32 sampleRate) {
+    if (seconds <= 0.0f || sampleRate == 0) return 0.0f;
+    return std::exp(-1.0f / (seconds * sampleRate));
+}
+
+static float GainToDecibels(float gain) {
+    return 20.0f * std::log10(std::max(gain, 1e-6f));
+}
+
+// ---------------------------------------------------------------------------
+// LimiterEffect
+// ---------------------------------------------------------------------------
+
+LimiterEffect::LimiterEffect(float ceilingDb, float releaseTime, float lookAheadTime)
+    : lookAhead(0)
+    , minimumHead(0)
+    , minimumCount(0)
+    , averageIndex(0)
+    , averageSum(0.0)
+    , frameIndex(0)
+    , releasedGain(1.0f)
+    , ceilingDb(0.0f)
+    , releaseTime(0.0f)
+    , gainReduction(0.0f)
+    , ceiling(1.0f)
+    , releaseCoefficient(0.0f)
+{
+    if (channels == 0) return;
+
+    lookAhead = std::max<ma_uint32>(1, static_cast<ma_uint32>(std::max(0.0f, lookAheadTime) * sampleRate));
+
+    delayBuffer.assign(static_cast<size_t>(lookAhead + ChunkFrames) * channels, 0.0f);
+    peaks.assign(ChunkFrames, 0.0f);
+    gains.assign(ChunkFrames, 1.0f);
+    minimumGains.assign(lookAhead + 1, 1.0f);
+    minimumFrames.assign(lookAhead + 1, 0);
+
+    // Start settled at unity gain
+    averageWindow.assign(lookAhead, 1.0f);
+    averageSum = lookAhead;
+
+    SetCeiling(ceilingDb);
+    SetRelease(releaseTime);
+    InitNode();
+}
+
+LimiterEffect::~LimiterEffect() {
+    UninitNode();
+}
+
+void LimiterEffect::SetCeiling(float ceilingDb) {
+    this->ceilingDb.store(std::min(ceilingDb, 0.0f));
+    MarkParametersDirty();
+}
+
+float LimiterEffect::GetCeiling() const {
+    return ceilingDb.load();
+}
+
+void LimiterEffect::SetRelease(float seconds) {
+    releaseTime.store(std::max(0.0f, seconds));
+    MarkParametersDirty();
+}
+
+float LimiterEffect::GetRelease() const {
+    return releaseTime.load();
+}
+
+ma_uint32 LimiterEffect::GetLatencyFrames() const {
+    return lookAhead;
+}
+
+float LimiterEffect::GetGainReduction() const {
+    return gainReduction.load(std::memory_order_relaxed);
+}
+
+void LimiterEffect::ApplyParameters() {
+    ceiling = std::pow(10.0f, ceilingDb.load() / 20.0f);
+    releaseCoefficient = TimeToCoefficient(releaseTime.load(), sampleRate);
+}
+
+void LimiterEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const size_t windowSize = minimumGains.size();
+    const double averageScale = 1.0 / lookAhead;
+    float lowestGain = 1.0f;
+
+    for (ma_uint32 offset = 0; offset < frameCount; offset += ChunkFrames) {
+        const ma_uint32 count = std::min(ChunkFrames, frameCount - offset);
+        const float* pChunkIn = &pFramesIn[static_cast<size_t>(offset) * channels];
+
+        // New frames go in behind the look-ahead history
+        std::memcpy(&delayBuffer[static_cast<size_t>(lookAhead) * channels], pChunkIn, sizeof(float) * count * channels);
+        AudioSIMD::FramePeaks(peaks.data(), pChunkIn, count, channels);
+
+        for (ma_uint32 i = 0; i < count; i++) {
+            float required = (peaks[i] > ceiling) ? ceiling / peaks[i] : 1.0f;
+
+            // Sliding minimum over the last lookAhead + 1 frames
+            if (minimumCount > 0 && frameIndex - minimumFrames[minimumHead] > lookAhead) {
+                minimumHead = (minimumHead + 1) % windowSize;
+                minimumCount--;
+            }
+            while (minimumCount > 0 && minimumGains[(minimumHead + minimumCount - 1) % windowSize] >= required) {
+                minimumCount--;
+            }
+            size_t tail = (minimumHead + minimumCount) % windowSize;
+            minimumGains[tail] = required;
+            minimumFrames[tail] = frameIndex;
+            minimumCount++;
+            float held = minimumGains[minimumHead];
+
+            // Drop instantly, recover at the release rate
+            releasedGain = (held < releasedGain) ? held : held + (releasedGain - held) * releaseCoefficient;
+
+            // Averaging a held minimum never rises above it, which keeps the brickwall
+            averageSum += releasedGain - averageWindow[averageIndex];
+            averageWindow[averageIndex] = releasedGain;
+            averageIndex = (averageIndex + 1 == lookAhead) ? 0 : averageIndex + 1;
+
+            gains[i] = static_cast<float>(averageSum * averageScale);
+            lowestGain = std::min(lowestGain, gains[i]);
+            frameIndex++;
+        }
+
+        AudioSIMD::ApplyFrameGains(&pFramesOut[static_cast<size_t>(offset) * channels], delayBuffer.data(), gains.data(), count, channels);
+
+        // Keep the most recent lookAhead frames as history
+        std::memmove(delayBuffer.data(), &delayBuffer[static_cast<size_t>(count) * channels], sizeof(float) * lookAhead * channels);
+    }
+
+    gainReduction.store(std::max(0.0f, -GainToDecibels(lowestGain)), std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------
+// CompressorEffect
+// ---------------------------------------------------------------------------
+
+CompressorEffect::CompressorEffect(float thresholdDb, float ratio, float attackTime, float releaseTime)
+    : envelopeDb(0.0f)
+    , thresholdDb(0.0f)
+    , ratio(1.0f)
+    , kneeDb(6.0f)
+    , attackTime(0.0f)
+    , releaseTime(0.0f)
+    , makeupDb(0.0f)
+    , gainReduction(0.0f)
+    , threshold(0.0f)
+    , slope(0.0f)
+    , knee(0.0f)
+    , attackCoefficient(0.0f)
+    , releaseCoefficient(0.0f)
+    , makeup(0.0f)
+{
+    if (channels == 0) return;
+
+    peaks.assign(ChunkFrames, 0.0f);
+    gains.assign(ChunkFrames, 1.0f);
+
+    SetThreshold(thresholdDb);
+    SetRatio(ratio);
+    SetAttack(attackTime);
+    SetRelease(releaseTime);
+    InitNode();
+}
+
+CompressorEffect::~CompressorEffect() {
+    UninitNode();
+}
+
+void CompressorEffect::SetThreshold(float thresholdDb) {
+    this->thresholdDb.store(std::min(thresholdDb, 0.0f));
+    MarkParametersDirty();
+}
+
+float CompressorEffect::GetThreshold() const {
+    return thresholdDb.load();
+}
+
+void CompressorEffect::SetRatio(float ratio) {
+    this->ratio.store(std::max(1.0f, ratio));
+    MarkParametersDirty();
+}
+
+float CompressorEffect::GetRatio() const {
+    return ratio.load();
+}
+
+void CompressorEffect::SetKnee(float kneeDb) {
+    this->kneeDb.store(std::max(0.0f, kneeDb));
+    MarkParametersDirty();
+}
+
+float CompressorEffect::GetKnee() const {
+    return kneeDb.load();
+}
+
+void CompressorEffect::SetAttack(float seconds) {
+    attackTime.store(std::max(0.0f, seconds));
+    MarkParametersDirty();
+}
+
+float CompressorEffect::GetAttack() const {
+    return attackTime.load();
+}
+
+void CompressorEffect::SetRelease(float seconds) {
+    releaseTime.store(std::max(0.0f, seconds));
+    MarkParametersDirty();
+}
+
+float CompressorEffect::GetRelease() const {
+    return releaseTime.load();
+}
+
+void CompressorEffect::SetMakeupGain(float gainDb) {
+    makeupDb.store(gainDb);
+    MarkParametersDirty();
+}
+
+float CompressorEffect::GetMakeupGain() const {
+    return makeupDb.load();
+}
+
+float CompressorEffect::GetGainReduction() const {
+    return gainReduction.load(std::memory_order_relaxed);
+}
+
+void CompressorEffect::ApplyParameters() {
+    threshold = thresholdDb.load();
+    slope = 1.0f - 1.0f / ratio.load();
+    knee = kneeDb.load();
+    attackCoefficient = TimeToCoefficient(attackTime.load(), sampleRate);
+    releaseCoefficient = TimeToCoefficient(releaseTime.load(), sampleRate);
+    makeup = makeupDb.load();
+}
+
+void CompressorEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const float halfKnee = knee * 0.5f;
+
+    for (ma_uint32 offset = 0; offset < frameCount; offset += ChunkFrames) {
+        const ma_uint32 count = std::min(ChunkFrames, frameCount - offset);
+        const size_t sampleOffset = static_cast<size_t>(offset) * channels;
+
+        AudioSIMD::FramePeaks(peaks.data(), &pFramesIn[sampleOffset], count, channels);
+
+        for (ma_uint32 i = 0; i < count; i++) {
+            float over = GainToDecibels(peaks[i]) - threshold;
+
+            // Static curve, quadratic through the knee
+            float reduction = 0.0f;
+            if (over >= halfKnee) {
+                reduction = slope * over;
+            }
+            else if (over > -halfKnee) {
+                float x = over + halfKnee;
+                reduction = slope * x * x / (2.0f * knee);
+            }
+
+            float smoothing = (reduction > envelopeDb) ? attackCoefficient : releaseCoefficient;
+            envelopeDb = reduction + (envelopeDb - reduction) * smoothing;
+
+            gains[i] = std::pow(10.0f, (makeup - envelopeDb) * 0.05f);
+        }
+
+        AudioSIMD::ApplyFrameGains(&pFramesOut[sampleOffset], &pFramesIn[sampleOffset], gains.data(), count, channels);
+    }
+
+    if (envelopeDb < 1e-6f) envelopeDb = 0.0f;
+    gainReduction.store(envelopeDb, std::memory_order_relaxed);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "AudioEffect.h"
+
+#include <atomic>
+#include <vector>
+
+// Look-ahead brickwall limiter. The required gain for each frame is held for the
+// look-ahead window and then averaged over it, so the gain has fully ramped down
+// by the time the loud frame leaves the delay line and the output never exceeds
+// the ceiling. Peak detection and gain application use AudioSIMD.
+//
+// The signal is delayed by the look-ahead time.
+class LimiterEffect : public AudioEffect {
+public:
+    // The look-ahead is fixed at construction
+    LimiterEffect(float ceilingDb = -1.0f, float releaseTime = 0.1f, float lookAheadTime = 0.005f);
+    ~LimiterEffect() override;
+
+    void SetCeiling(float ceilingDb);   // dBFS, at most 0
+    float GetCeiling() const;
+    void SetRelease(float seconds);
+    float GetRelease() const;
+
+    ma_uint32 GetLatencyFrames() const;
+    float GetGainReduction() const override;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    static const ma_uint32 ChunkFrames = 256;
+
+    ma_uint32 lookAhead;
+    std::vector<float> delayBuffer;     // lookAhead frames of history, then the current chunk
+    std::vector<float> peaks;
+    std::vector<float> gains;
+
+    // Monotonic queue giving the minimum required gain over the look-ahead window
+    std::vector<float> minimumGains;
+    std::vector<ma_uint64> minimumFrames;
+    size_t minimumHead;
+    size_t minimumCount;
+
+    // Moving average that turns the held gain into a ramp
+    std::vector<float> averageWindow;
+    size_t averageIndex;
+    double averageSum;
+
+    ma_uint64 frameIndex;
+    float releasedGain;
+
+    std::atomic<float> ceilingDb;
+    std::atomic<float> releaseTime;
+    std::atomic<float> gainReduction;
+
+    // Derived on the audio thread by ApplyParameters()
+    float ceiling;
+    float releaseCoefficient;
+};
+
+// Feed-forward compressor with a soft knee. Channels are linked (the loudest
+// channel drives the gain) so the stereo image doesn't shift.
+class CompressorEffect : public AudioEffect {
+public:
+    CompressorEffect(float thresholdDb = -18.0f, float ratio = 4.0f, float attackTime = 0.01f, float releaseTime = 0.15f);
+    ~CompressorEffect() override;
+
+    void SetThreshold(float thresholdDb);
+    float GetThreshold() const;
+    void SetRatio(float ratio);         // 1.0 (off) and up
+    float GetRatio() const;
+    void SetKnee(float kneeDb);
+    float GetKnee() const;
+    void SetAttack(float seconds);
+    float GetAttack() const;
+    void SetRelease(float seconds);
+    float GetRelease() const;
+    void SetMakeupGain(float gainDb);
+    float GetMakeupGain() const;
+
+    float GetGainReduction() const override;
+
+protected:
+    void ApplyParameters() override;
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    static const ma_uint32 ChunkFrames = 256;
+
+    std::vector<float> peaks;
+    std::vector<float> gains;
+    float envelopeDb;   // Smoothed gain reduction
+
+    std::atomic<float> thresholdDb;
+    std::atomic<float> ratio;
+    std::atomic<float> kneeDb;
+    std::atomic<float> attackTime;
+    std::atomic<float> releaseTime;
+    std::atomic<float> makeupDb;
+    std::atomic<float> gainReduction;
+
+    // Derived on the audio thread by ApplyParameters()
+    float threshold;
+    float slope;
+    float knee;
+    float attackCoefficient;
+    float releaseCoefficient;
+    float makeup;
+};
@@ -0,0 +1,177 @@
+#include "miniaudio.h"
+#include "EffectChain.h"
+
+#include <algorithm>
+
+EffectChain::EffectChain()
+    : source(nullptr)
+    , destination(nullptr)
+{
+}
+
+EffectChain::~EffectChain() {
+    Disconnect();
+}
+
+void EffectChain::Connect(ma_node* src, ma_node* dst) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    source = src;
+    destination = dst;
+
+    // Wire back to front so audio never flows into a half-built chain
+    for (size_t i = effects.size(); i-- > 0;) {
+        ma_node_attach_output_bus(effects[i]->GetNode(), 0, NodeAfter(i), 0);
+    }
+    ma_node* first = effects.empty() ? destination : effects.front()->GetNode();
+    if (source && first) {
+        ma_node_attach_output_bus(source, 0, first, 0);
+    }
+}
+
+void EffectChain::Disconnect() {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    // Teardown: cut every effect loose without bridging source to destination,
+    // since either end may already have been uninitialized
+    for (auto& effect : effects) {
+        ma_node_detach_output_bus(effect->GetNode(), 0);
+        effect->chain = nullptr;
+    }
+    effects.clear();
+
+    source = nullptr;
+    destination = nullptr;
+}
+
+void EffectChain::SetDestination(ma_node* dst) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    destination = dst;
+    ma_node* tail = effects.empty() ? source : effects.back()->GetNode();
+    if (tail && destination) {
+        ma_node_attach_output_bus(tail, 0, destination, 0);
+    }
+}
+
+ma_node* EffectChain::GetDestination() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return destination;
+}
+
+bool EffectChain::AddEffect(std::shared_ptr<AudioEffect> effect) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return InsertLocked(effects.size(), effect);
+}
+
+bool EffectChain::InsertEffect(size_t index, std::shared_ptr<AudioEffect> effect) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return InsertLocked(std::min(index, effects.size()), effect);
+}
+
+bool EffectChain::RemoveEffect(const std::shared_ptr<AudioEffect>& effect) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    auto it = std::find(effects.begin(), effects.end(), effect);
+    if (it == effects.end()) {
+        return false;
+    }
+
+    RemoveLocked(static_cast<size_t>(it - effects.begin()));
+    return true;
+}
+
+bool EffectChain::MoveEffect(size_t fromIndex, size_t toIndex) {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    if (fromIndex >= effects.size()) {
+        return false;
+    }
+
+    std::shared_ptr<AudioEffect> effect = RemoveLocked(fromIndex);
+    return InsertLocked(std::min(toIndex, effects.size()), effect);
+}
+
+void EffectChain::ClearEffects() {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    while (!effects.empty()) {
+        RemoveLocked(effects.size() - 1);
+    }
+}
+
+size_t EffectChain::GetEffectCount() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    return effects.size();
+}
+
+std::shared_ptr<AudioEffect> EffectChain::GetEffect(size_t index) const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+    if (index >= effects.size()) {
+        return nullptr;
+    }
+    return effects[index];
+}
+
+float EffectChain::GetGainReduction() const {
+    std::lock_guard<std::mutex> lock(chainMutex);
+
+    float total = 0.0f;
+    for (const auto& effect : effects) {
+        total += effect->GetGainReduction();
+    }
+    return total;
+}
+
+ma_node* EffectChain::NodeBefore(size_t index) const {
+    return (index == 0) ? source : effects[index - 1]->GetNode();
+}
+
+ma_node* EffectChain::NodeAfter(size_t index) const {
+    size_t next = index + 1;
+    return (next >= effects.size()) ? destination : effects[next]->GetNode();
+}
+
+bool EffectChain::InsertLocked(size_t index, std::shared_ptr<AudioEffect> effect) {
+    if (!effect || !effect->IsInitialized() || effect->IsAttached()) {
+        return false;
+    }
+
+    ma_node* node = effect->GetNode();
+    ma_node* prev = NodeBefore(index);
+    ma_node* next = (index < effects.size()) ? effects[index]->GetNode() : destination;
+
+    // Hook the new effect's output up first, then switch the upstream link over to it
+    if (next && ma_node_attach_output_bus(node, 0, next, 0) != MA_SUCCESS) {
+        return false;
+    }
+    if (prev && ma_node_attach_output_bus(prev, 0, node, 0) != MA_SUCCESS) {
+        ma_node_detach_output_bus(node, 0);
+        return false;
+    }
+
+    effect->chain = this;
+    effects.insert(effects.begin() + index, effect);
+    return true;
+}
+
+std::shared_ptr<AudioEffect> EffectChain::RemoveLocked(size_t index) {
+    std::shared_ptr<AudioEffect> effect = effects[index];
+    ma_node* prev = NodeBefore(index);
+    ma_node* next = NodeAfter(index);
+
+    // Bridge around the effect before cutting it loose
+    if (prev) {
+        if (next) {
+            ma_node_attach_output_bus(prev, 0, next, 0);
+        }
+        else {
+            ma_node_detach_output_bus(prev, 0);
+        }
+    }
+    ma_node_detach_output_bus(effect->GetNode(), 0);
+
+    effects.erase(effects.begin() + index);
+    effect->chain = nullptr;
+    return effect;
+}
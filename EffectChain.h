@@ -0,0 +1,56 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEffect.h"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Ordered list of insert effects wired between a source node and a destination node.
+//
+// Every edit re-routes only the links that change, and each link is switched with a
+// single ma_node_attach_output_bus() call, so effects can be added, removed or
+// reordered while audio is playing. All node allocation happens in the effect's
+// constructor on the calling thread, never on the audio thread.
+class EffectChain {
+public:
+    EffectChain();
+    ~EffectChain();
+
+    // Routes output bus 0 of source through the chain into input bus 0 of destination
+    void Connect(ma_node* source, ma_node* destination);
+
+    // Drops all effects and forgets both ends; the source is left unrouted
+    void Disconnect();
+
+    // Re-routes the end of the chain to a different node
+    void SetDestination(ma_node* destination);
+    ma_node* GetDestination() const;
+
+    // Effects can only be in one chain at a time
+    bool AddEffect(std::shared_ptr<AudioEffect> effect);
+    bool InsertEffect(size_t index, std::shared_ptr<AudioEffect> effect);
+    bool RemoveEffect(const std::shared_ptr<AudioEffect>& effect);
+    bool MoveEffect(size_t fromIndex, size_t toIndex);
+    void ClearEffects();
+
+    size_t GetEffectCount() const;
+    std::shared_ptr<AudioEffect> GetEffect(size_t index) const;
+
+    // Total gain reduction of the dynamics effects in the chain, in dB
+    float GetGainReduction() const;
+
+private:
+    // Node feeding the effect at index, and node the effect at index feeds
+    ma_node* NodeBefore(size_t index) const;
+    ma_node* NodeAfter(size_t index) const;
+
+    bool InsertLocked(size_t index, std::shared_ptr<AudioEffect> effect);
+    std::shared_ptr<AudioEffect> RemoveLocked(size_t index);
+
+    ma_node* source;
+    ma_node* destination;
+    std::vector<std::shared_ptr<AudioEffect>> effects;
+    mutable std::mutex chainMutex;
+};
@@ -0,0 +1,141 @@
+#include "FFT.h"
+
+#include <cmath>
+#include <utility>
+
+static const double g_pi = 3.14159265358979323846;
+
+RealFFT::RealFFT(size_t size)
+    : size(size)
+    , half(size / 2)
+{
+    // Bit-reversal permutation for the half-size complex transform
+    size_t bits = 0;
+    while ((static_cast<size_t>(1) << bits) < half) bits++;
+
+    bitReverse.resize(half);
+    for (size_t i = 0; i < half; i++) {
+        size_t reversed = 0;
+        for (size_t b = 0; b < bits; b++) {
+            if (i & (static_cast<size_t>(1) << b)) {
+                reversed |= static_cast<size_t>(1) << (bits - 1 - b);
+            }
+        }
+        bitReverse[i] = reversed;
+    }
+
+    cosTable.resize(half / 2 + 1);
+    sinTable.resize(half / 2 + 1);
+    for (size_t k = 0; k < cosTable.size(); k++) {
+        double angle = 2.0 * g_pi * k / half;
+        cosTable[k] = static_cast<float>(std::cos(angle));
+        sinTable[k] = static_cast<float>(std::sin(angle));
+    }
+
+    postCos.resize(half + 1);
+    postSin.resize(half + 1);
+    for (size_t k = 0; k <= half; k++) {
+        double angle = 2.0 * g_pi * k / size;
+        postCos[k] = static_cast<float>(std::cos(angle));
+        postSin[k] = static_cast<float>(std::sin(angle));
+    }
+
+    workRe.resize(half);
+    workIm.resize(half);
+}
+
+size_t RealFFT::GetSize() const {
+    return size;
+}
+
+size_t RealFFT::GetBinCount() const {
+    return half + 1;
+}
+
+void RealFFT::ComplexTransform(bool inverse) {
+    for (size_t i = 0; i < half; i++) {
+        size_t j = bitReverse[i];
+        if (j > i) {
+            std::swap(workRe[i], workRe[j]);
+            std::swap(workIm[i], workIm[j]);
+        }
+    }
+
+    const float sign = inverse ? 1.0f : -1.0f;
+    for (size_t length = 2; length <= half; length <<= 1) {
+        const size_t halfLength = length / 2;
+        const size_t step = half / length;
+
+        for (size_t start = 0; start < half; start += length) {
+            for (size_t j = 0; j < halfLength; j++) {
+                const float wr = cosTable[j * step];
+                const float wi = sign * sinTable[j * step];
+
+                const size_t a = start + j;
+                const size_t b = a + halfLength;
+                const float vr = workRe[b] * wr - workIm[b] * wi;
+                const float vi = workRe[b] * wi + workIm[b] * wr;
+
+                workRe[b] = workRe[a] - vr;
+                workIm[b] = workIm[a] - vi;
+                workRe[a] += vr;
+                workIm[a] += vi;
+            }
+        }
+    }
+}
+
+void RealFFT::Forward(const float* input, float* re, float* im) {
+    // Pack even samples into the real part and odd samples into the imaginary part
+    for (size_t n = 0; n < half; n++) {
+        workRe[n] = input[2 * n];
+        workIm[n] = input[2 * n + 1];
+    }
+
+    ComplexTransform(false);
+
+    // Split the packed spectrum into the even and odd halves and recombine
+    for (size_t k = 0; k <= half; k++) {
+        const size_t ka = (k == half) ? 0 : k;
+        const size_t kb = (k == 0) ? 0 : half - k;
+
+        const float aRe = workRe[ka], aIm = workIm[ka];
+        const float bRe = workRe[kb], bIm = -workIm[kb];
+
+        const float evenRe = 0.5f * (aRe + bRe);
+        const float evenIm = 0.5f * (aIm + bIm);
+        const float oddRe = 0.5f * (aIm - bIm);
+        const float oddIm = -0.5f * (aRe - bRe);
+
+        const float c = postCos[k], s = postSin[k];
+        re[k] = evenRe + c * oddRe + s * oddIm;
+        im[k] = evenIm + c * oddIm - s * oddRe;
+    }
+}
+
+void RealFFT::Inverse(const float* re, const float* im, float* output) {
+    for (size_t k = 0; k < half; k++) {
+        const float aRe = re[k], aIm = im[k];
+        const float bRe = re[half - k], bIm = -im[half - k];
+
+        const float evenRe = 0.5f * (aRe + bRe);
+        const float evenIm = 0.5f * (aIm + bIm);
+        const float dRe = 0.5f * (aRe - bRe);
+        const float dIm = 0.5f * (aIm - bIm);
+
+        const float c = postCos[k], s = postSin[k];
+        const float oddRe = dRe * c - dIm * s;
+        const float oddIm = dRe * s + dIm * c;
+
+        workRe[k] = evenRe - oddIm;
+        workIm[k] = evenIm + oddRe;
+    }
+
+    ComplexTransform(true);
+
+    const float scale = 1.0f / static_cast<float>(half);
+    for (size_t n = 0; n < half; n++) {
+        output[2 * n] = workRe[n] * scale;
+        output[2 * n + 1] = workIm[n] * scale;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Real-input FFT of a power-of-two size, computed with a half-size complex FFT.
+// Spectra are stored split-complex (separate real and imaginary arrays) with
+// size / 2 + 1 bins, which is the layout AudioSIMD::ComplexMultiplyAccumulate
+// expects. All buffers are allocated in the constructor, so Forward() and
+// Inverse() are safe to call on the audio thread.
+class RealFFT {
+public:
+    explicit RealFFT(size_t size);
+
+    size_t GetSize() const;
+    size_t GetBinCount() const;
+
+    // size real samples in, GetBinCount() complex bins out
+    void Forward(const float* input, float* re, float* im);
+
+    // GetBinCount() complex bins in, size real samples out. Inverse(Forward(x)) == x.
+    void Inverse(const float* re, const float* im, float* output);
+
+private:
+    void ComplexTransform(bool inverse);
+
+    size_t size;
+    size_t half;
+    std::vector<size_t> bitReverse;
+    std::vector<float> cosTable;   // Twiddles for the half-size complex FFT
+    std::vector<float> sinTable;
+    std::vector<float> postCos;    // Twiddles for splitting the real spectrum
+    std::vector<float> postSin;
+    std::vector<float> workRe;
+    std::vector<float> workIm;
+};
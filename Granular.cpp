@@ -0,0 +1,231 @@
+#include "miniaudio.h"
+#include "Granular.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+#include <cmath>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_uint32 GranularSource::MaxGrains;
+const ma_uint32 GranularSource::ChunkFrames;
+const ma_uint32 GranularSource::WindowSize;
+
+static const ma_uint32 g_decodeChunkFrames = 4096;
+
+// Shorter material is refused; grains need room to start at different places
+static const size_t g_minMaterialFrames = 64;
+
+GranularSource::GranularSource(const std::string& filePath, float amplitudeValue)
+    : ProceduralSource(0.0f)
+    , random(std::random_device{}())
+    , framesUntilGrain(0.0)
+    , grainMs(80.0f)
+    , density(40.0f)
+    , pitchJitter(0.5f)
+    , amplitude(amplitudeValue)
+    , activeGrains(0)
+    , droppedGrains(0)
+{
+    if (!ProceduralSource::IsInitialized()) {
+        return;
+    }
+
+    // Mono at the engine rate, so grains read the material without converting it
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 1, sampleRate);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filePath.c_str(), &config, &decoder) != MA_SUCCESS) {
+        return;
+    }
+
+    ma_uint64 length = 0;
+    if (ma_decoder_get_length_in_pcm_frames(&decoder, &length) == MA_SUCCESS && length > 0) {
+        material.reserve(static_cast<size_t>(length));
+    }
+    std::vector<float> buffer(g_decodeChunkFrames);
+    for (;;) {
+        ma_uint64 framesRead = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, buffer.data(), g_decodeChunkFrames, &framesRead);
+        material.insert(material.end(), buffer.begin(), buffer.begin() + static_cast<size_t>(framesRead));
+        if (result != MA_SUCCESS || framesRead == 0) break;
+    }
+    ma_decoder_uninit(&decoder);
+
+    window.resize(WindowSize + 1);
+    for (ma_uint32 i = 0; i < WindowSize; i++) {
+        window[i] = 0.5f - 0.5f * static_cast<float>(std::cos(6.283185307179586 * i / (WindowSize - 1)));
+    }
+    window[WindowSize] = 0.0f;
+
+    sourceScratch.resize(ChunkFrames);
+    windowScratch.resize(ChunkFrames);
+}
+
+bool GranularSource::IsInitialized() const {
+    return ProceduralSource::IsInitialized() && material.size() >= g_minMaterialFrames;
+}
+
+void GranularSource::SetGrainLength(float milliseconds) {
+    grainMs.store(std::min(std::max(milliseconds, 10.0f), 500.0f));
+}
+
+float GranularSource::GetGrainLength() const {
+    return grainMs.load();
+}
+
+void GranularSource::SetDensity(float grainsPerSecond) {
+    density.store(std::min(std::max(grainsPerSecond, 1.0f), 500.0f));
+}
+
+float GranularSource::GetDensity() const {
+    return density.load();
+}
+
+void GranularSource::SetPitchJitter(float semitones) {
+    pitchJitter.store(std::min(std::max(semitones, 0.0f), 12.0f));
+}
+
+float GranularSource::GetPitchJitter() const {
+    return pitchJitter.load();
+}
+
+void GranularSource::SetAmplitude(float value) {
+    amplitude.store(std::max(value, 0.0f));
+}
+
+float GranularSource::GetAmplitude() const {
+    return amplitude.load();
+}
+
+GranularSource::Stats GranularSource::GetStats() const {
+    Stats stats;
+    stats.activeGrains = activeGrains.load(std::memory_order_relaxed);
+    stats.droppedGrains = droppedGrains.load(std::memory_order_relaxed);
+    stats.materialBytes = material.size() * sizeof(float);
+    return stats;
+}
+
+void GranularSource::Restart() {
+    for (Grain& grain : grains) {
+        grain.active = false;
+    }
+    framesUntilGrain = 0.0;
+}
+
+void GranularSource::Generate(float* pFramesOut, ma_uint32 frameCount) {
+    ma_silence_pcm_frames(pFramesOut, frameCount, ma_format_f32, 1);
+    if (material.size() < g_minMaterialFrames) {
+        return;
+    }
+
+    const float gain = amplitude.load(std::memory_order_relaxed);
+
+    // Split the block where grains start, so each starts on its own frame
+    ma_uint32 offset = 0;
+    while (offset < frameCount) {
+        if (framesUntilGrain < 1.0) {
+            SpawnGrain();
+
+            // Randomized around the mean interval; a regular one would buzz at the density
+            std::uniform_real_distribution<double> spread(0.5, 1.5);
+            framesUntilGrain += spread(random) * sampleRate / density.load(std::memory_order_relaxed);
+        }
+
+        ma_uint32 count = std::min(frameCount - offset, static_cast<ma_uint32>(framesUntilGrain));
+        count = std::min(count, ChunkFrames);
+        for (Grain& grain : grains) {
+            if (grain.active) {
+                RenderGrain(grain, &pFramesOut[offset], count, gain);
+            }
+        }
+
+        framesUntilGrain -= count;
+        offset += count;
+    }
+
+    ma_uint32 active = 0;
+    for (const Grain& grain : grains) {
+        if (grain.active) active++;
+    }
+    activeGrains.store(active, std::memory_order_relaxed);
+}
+
+void GranularSource::SpawnGrain() {
+    Grain* slot = nullptr;
+    for (Grain& grain : grains) {
+        if (!grain.active) {
+            slot = &grain;
+            break;
+        }
+    }
+    if (!slot) {
+        droppedGrains.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const float jitter = pitchJitter.load(std::memory_order_relaxed);
+    std::uniform_real_distribution<float> semitones(-jitter, jitter);
+    const double step = std::pow(2.0, semitones(random) / 12.0);
+
+    // Never longer than the material allows, counting the frame interpolation reads past the span
+    const double available = static_cast<double>(material.size() - 2);
+    const float lengthMs = grainMs.load(std::memory_order_relaxed);
+    ma_uint32 length = static_cast<ma_uint32>(lengthMs * sampleRate / 1000.0f);
+    length = std::max(std::min(length, static_cast<ma_uint32>(available / step) - 1), 2u);
+
+    // Whole-frame starts, so unpitched grains read the material in place
+    const size_t lastStart = static_cast<size_t>(available - length * step);
+    std::uniform_int_distribution<size_t> start(0, lastStart);
+    std::uniform_real_distribution<float> level(0.7f, 1.0f);
+
+    // Overlapping grains are uncorrelated and add in power, so scale by the root of
+    // the average overlap to keep the bed's level independent of length and density
+    const float overlap = density.load(std::memory_order_relaxed) * lengthMs / 1000.0f;
+
+    slot->position = static_cast<double>(start(random));
+    slot->step = step;
+    slot->length = length;
+    slot->elapsed = 0;
+    slot->windowStep = static_cast<float>(WindowSize - 1) / (length - 1);
+    slot->gain = level(random) / std::sqrt(std::max(overlap, 1.0f));
+    slot->active = true;
+}
+
+void GranularSource::RenderGrain(Grain& grain, float* pFramesOut, ma_uint32 frameCount, float gain) {
+    const ma_uint32 count = std::min(frameCount, grain.length - grain.elapsed);
+
+    // Window lookups (and, for pitched grains, material reads) are gathers; the
+    // windowing and the sum into the output are vector operations
+    const float* source = &material[static_cast<size_t>(grain.position)];
+    if (grain.step != 1.0) {
+        double position = grain.position;
+        for (ma_uint32 i = 0; i < count; i++) {
+            const size_t index = static_cast<size_t>(position);
+            const float fraction = static_cast<float>(position - index);
+            sourceScratch[i] = material[index] + (material[index + 1] - material[index]) * fraction;
+            position += grain.step;
+        }
+        source = sourceScratch.data();
+    }
+
+    for (ma_uint32 i = 0; i < count; i++) {
+        const float position = (grain.elapsed + i) * grain.windowStep;
+        const ma_uint32 index = static_cast<ma_uint32>(position);
+        windowScratch[i] = window[index] + (window[index + 1] - window[index]) * (position - index);
+    }
+
+    AudioSIMD::Multiply(windowScratch.data(), windowScratch.data(), source, count);
+    AudioSIMD::MultiplyAdd(pFramesOut, windowScratch.data(), grain.gain * gain, count);
+
+    grain.position += grain.step * count;
+    grain.elapsed += count;
+    if (grain.elapsed >= grain.length) {
+        grain.active = false;
+    }
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Procedural.h"
+
+#include <array>
+#include <random>
+#include <string>
+#include <vector>
+
+// Endless ambience from a short recording. The file is decoded once into memory
+// (mono, engine rate) and played back as a cloud of short, windowed grains, each
+// from a random position with a little random pitch and level, started at
+// randomized intervals. Nothing repeats, so a few seconds of rain or crowd stand
+// in for minutes of decoded or streamed bed.
+//
+// At most MaxGrains play at once; a grain due while all are busy is skipped and
+// counted, so the cost per block is bounded whatever the density. Decoding
+// happens in the constructor, on the calling thread.
+class GranularSource : public ProceduralSource {
+public:
+    static const ma_uint32 MaxGrains = 32;
+
+    struct Stats {
+        ma_uint32 activeGrains = 0;
+        ma_uint64 droppedGrains = 0;    // Due while the budget was full
+        size_t materialBytes = 0;
+    };
+
+    explicit GranularSource(const std::string& filePath, float amplitude = 0.5f);
+
+    // False if the file couldn't be decoded
+    bool IsInitialized() const override;
+
+    void SetGrainLength(float milliseconds);        // 10 to 500, default 80
+    float GetGrainLength() const;
+    void SetDensity(float grainsPerSecond);         // 1 to 500, default 40
+    float GetDensity() const;
+    void SetPitchJitter(float semitones);           // Random +/- per grain, default 0.5
+    float GetPitchJitter() const;
+    void SetAmplitude(float amplitude);
+    float GetAmplitude() const;
+
+    Stats GetStats() const;
+
+protected:
+    void Generate(float* pFramesOut, ma_uint32 frameCount) override;
+    void Restart() override;
+
+private:
+    static const ma_uint32 ChunkFrames = 512;
+    static const ma_uint32 WindowSize = 1024;
+
+    struct Grain {
+        bool active = false;
+        double position = 0.0;      // In material frames
+        double step = 1.0;          // Material frames per output frame
+        ma_uint32 length = 0;       // Output frames
+        ma_uint32 elapsed = 0;
+        float windowStep = 0.0f;    // Window table entries per output frame
+        float gain = 0.0f;
+    };
+
+    // Audio thread
+    void SpawnGrain();
+    void RenderGrain(Grain& grain, float* pFramesOut, ma_uint32 frameCount, float amplitude);
+
+    std::vector<float> material;
+    std::vector<float> window;          // Hann, WindowSize + 1 entries so interpolation never reads past the end
+    std::vector<float> sourceScratch;
+    std::vector<float> windowScratch;
+
+    std::array<Grain, MaxGrains> grains;
+    std::mt19937 random;
+    double framesUntilGrain;            // Audio thread
+
+    std::atomic<float> grainMs;
+    std::atomic<float> density;
+    std::atomic<float> pitchJitter;
+    std::atomic<float> amplitude;
+    std::atomic<ma_uint32> activeGrains;
+    std::atomic<ma_uint64> droppedGrains;
+};
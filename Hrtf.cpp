@@ -0,0 +1,541 @@
+#include "miniaudio.h"
+#include "Hrtf.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+#include <cmath>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const size_t HrtfDataset::IrLength;
+const size_t HrtfDataset::FftSize;
+const size_t HrtfDataset::BinCount;
+
+static const float g_pi = 3.14159265358979323846f;
+static const float g_degreesToRadians = g_pi / 180.0f;
+
+// Spherical head model constants (Brown & Duda, "A Structural Model for Binaural Sound Synthesis")
+static const float g_headRadius = 0.0875f;
+static const float g_speedOfSound = 343.0f;
+static const float g_minShadowAlpha = 0.1f;
+static const float g_minShadowAngle = 150.0f;
+
+// Pinna reflections: gain, azimuth scale, offset (in 44.1kHz samples) and elevation scale
+static const float g_pinnaGain[] = { 0.5f, -1.0f, 0.5f, -0.25f, 0.25f };
+static const float g_pinnaA[] = { 1.0f, 5.0f, 5.0f, 5.0f, 5.0f };
+static const float g_pinnaB[] = { 2.0f, 4.0f, 7.0f, 11.0f, 13.0f };
+static const float g_pinnaD[] = { 1.0f, 0.5f, 0.5f, 0.5f, 0.5f };
+
+static float WrapDegrees(float degrees) {
+    degrees = std::fmod(degrees, 360.0f);
+    return (degrees < 0.0f) ? degrees + 360.0f : degrees;
+}
+
+static void DirectionFromAngles(float azimuth, float elevation, float& right, float& up, float& front) {
+    float az = azimuth * g_degreesToRadians;
+    float el = elevation * g_degreesToRadians;
+    right = std::sin(az) * std::cos(el);
+    up = std::sin(el);
+    front = std::cos(az) * std::cos(el);
+
+    // Snap rounding noise so directions on the interaural axis stay symmetric
+    if (std::fabs(right) < 1e-6f) right = 0.0f;
+    if (std::fabs(up) < 1e-6f) up = 0.0f;
+    if (std::fabs(front) < 1e-6f) front = 0.0f;
+}
+
+// Synthesises one ear's delay-free impulse response; returns the ear's delay in frames
+static float SynthesizeEar(float azimuth, float elevation, bool rightEar, ma_uint32 sampleRate, float* ir) {
+    float right, up, front;
+    DirectionFromAngles(azimuth, elevation, right, up, front);
+
+    // Angle between the source and the ear's axis: 0 = facing the ear, pi = behind the head
+    float cosAngle = std::max(-1.0f, std::min(rightEar ? right : -right, 1.0f));
+    float earAngle = std::acos(cosAngle);
+
+    // Pinna echoes depend on the lateral angle and the angle around the interaural axis
+    float lateral = std::asin(std::max(-1.0f, std::min(right, 1.0f)));
+    float polar = std::atan2(up, front) / g_degreesToRadians;
+    float rateScale = sampleRate / 44100.0f;
+
+    std::fill(ir, ir + HrtfDataset::IrLength, 0.0f);
+    ir[0] = 1.0f;
+    for (size_t k = 0; k < 5; k++) {
+        float tau = g_pinnaA[k] * std::cos(lateral * 0.5f) * std::sin(g_pinnaD[k] * (90.0f - polar) * g_degreesToRadians) + g_pinnaB[k];
+        float position = std::max(1.0f, tau * rateScale);
+        size_t index = static_cast<size_t>(position);
+        float frac = position - index;
+        if (index + 1 < HrtfDataset::IrLength) {
+            ir[index] += g_pinnaGain[k] * (1.0f - frac);
+            ir[index + 1] += g_pinnaGain[k] * frac;
+        }
+    }
+
+    // Head shadow: one-pole/one-zero shelf whose high-frequency gain depends on the ear angle
+    float shadowAngle = earAngle / g_degreesToRadians;
+    float alpha = (1.0f + g_minShadowAlpha * 0.5f) + (1.0f - g_minShadowAlpha * 0.5f) * std::cos(shadowAngle / g_minShadowAngle * g_pi);
+    float beta = 2.0f * g_speedOfSound / g_headRadius;
+    float fs2 = 2.0f * sampleRate;
+    float b0 = (beta + alpha * fs2) / (beta + fs2);
+    float b1 = (beta - alpha * fs2) / (beta + fs2);
+    float a1 = (beta - fs2) / (beta + fs2);
+
+    // Sources behind the head lose some top end to the pinna
+    float rear = std::max(0.0f, -front) * 0.35f;
+
+    float x1 = 0.0f, y1 = 0.0f, r1 = 0.0f;
+    for (size_t i = 0; i < HrtfDataset::IrLength; i++) {
+        float x = ir[i];
+        float y = b0 * x + b1 * x1 - a1 * y1;
+        x1 = x;
+        y1 = y;
+        r1 = (1.0f - rear) * y + rear * r1;
+        ir[i] = r1;
+    }
+
+    // Fade out the truncated tail
+    const size_t fadeLength = 16;
+    for (size_t i = 0; i < fadeLength; i++) {
+        ir[HrtfDataset::IrLength - fadeLength + i] *= 0.5f * (1.0f + std::cos(g_pi * (i + 1) / fadeLength));
+    }
+
+    // Interaural time difference from the spherical head
+    float delaySeconds = (earAngle < g_pi * 0.5f)
+        ? (g_headRadius / g_speedOfSound) * (1.0f - std::cos(earAngle))
+        : (g_headRadius / g_speedOfSound) * (1.0f + earAngle - g_pi * 0.5f);
+    return delaySeconds * sampleRate;
+}
+
+// ---------------------------------------------------------------------------
+// HrtfDataset
+// ---------------------------------------------------------------------------
+
+HrtfDataset::HrtfDataset(ma_uint32 sampleRate)
+    : sampleRate(sampleRate)
+    , fft(FftSize)
+{
+    size_t points = GetAzimuthCount() * GetElevationCount();
+    spectraRe.assign(points * 2 * BinCount, 0.0f);
+    spectraIm.assign(points * 2 * BinCount, 0.0f);
+    delays.assign(points * 2, 0.0f);
+}
+
+std::shared_ptr<HrtfDataset> HrtfDataset::CreateBuiltIn(ma_uint32 sampleRate) {
+    if (sampleRate == 0) return nullptr;
+
+    std::shared_ptr<HrtfDataset> dataset(new HrtfDataset(sampleRate));
+    size_t points = dataset->GetAzimuthCount() * dataset->GetElevationCount();
+    std::vector<float> irs(points * 2 * IrLength);
+    std::vector<float> pointDelays(points * 2);
+
+    for (size_t e = 0; e < dataset->GetElevationCount(); e++) {
+        for (size_t a = 0; a < dataset->GetAzimuthCount(); a++) {
+            float azimuth = static_cast<float>(a * AzimuthStep);
+            float elevation = static_cast<float>(MinElevation + static_cast<int>(e) * ElevationStep);
+            size_t point = dataset->GetPointIndex(a, e);
+            for (int ear = 0; ear < 2; ear++) {
+                pointDelays[point * 2 + ear] = SynthesizeEar(azimuth, elevation, ear == 1, sampleRate,
+                    &irs[(point * 2 + ear) * IrLength]);
+            }
+        }
+    }
+
+    dataset->Build(irs, pointDelays);
+    return dataset;
+}
+
+std::shared_ptr<HrtfDataset> HrtfDataset::CreateFromMeasurements(const std::vector<HrtfMeasurement>& measurements,
+    ma_uint32 measurementSampleRate, ma_uint32 sampleRate) {
+    if (measurements.empty() || measurementSampleRate == 0 || sampleRate == 0) return nullptr;
+
+    struct Prepared {
+        float right, up, front;
+        std::vector<float> ir[2];
+        float delay[2];
+    };
+
+    // Resample to the engine rate and split each ear into onset delay + delay-free response
+    std::vector<Prepared> prepared(measurements.size());
+    for (size_t m = 0; m < measurements.size(); m++) {
+        const HrtfMeasurement& source = measurements[m];
+        Prepared& target = prepared[m];
+        DirectionFromAngles(source.azimuth, source.elevation, target.right, target.up, target.front);
+
+        const std::vector<float>* ears[2] = { &source.left, &source.right };
+        for (int ear = 0; ear < 2; ear++) {
+            std::vector<float> resampled = *ears[ear];
+            if (measurementSampleRate != sampleRate && !resampled.empty()) {
+                ma_uint64 frames = ma_convert_frames(NULL, 0, ma_format_f32, 1, sampleRate,
+                    resampled.data(), resampled.size(), ma_format_f32, 1, measurementSampleRate);
+                std::vector<float> converted(static_cast<size_t>(frames));
+                ma_convert_frames(converted.data(), frames, ma_format_f32, 1, sampleRate,
+                    resampled.data(), resampled.size(), ma_format_f32, 1, measurementSampleRate);
+                resampled.swap(converted);
+            }
+
+            float peak = 0.0f;
+            for (float sample : resampled) peak = std::max(peak, std::fabs(sample));
+
+            size_t onset = 0;
+            while (onset < resampled.size() && std::fabs(resampled[onset]) < peak * 0.1f) onset++;
+            size_t shift = (onset > 2) ? onset - 2 : 0;
+
+            target.ir[ear].assign(IrLength, 0.0f);
+            for (size_t i = 0; i < IrLength && shift + i < resampled.size(); i++) {
+                target.ir[ear][i] = resampled[shift + i];
+            }
+            target.delay[ear] = static_cast<float>(shift);
+        }
+    }
+
+    std::shared_ptr<HrtfDataset> dataset(new HrtfDataset(sampleRate));
+    size_t points = dataset->GetAzimuthCount() * dataset->GetElevationCount();
+    std::vector<float> irs(points * 2 * IrLength, 0.0f);
+    std::vector<float> pointDelays(points * 2, 0.0f);
+
+    for (size_t e = 0; e < dataset->GetElevationCount(); e++) {
+        for (size_t a = 0; a < dataset->GetAzimuthCount(); a++) {
+            float right, up, front;
+            DirectionFromAngles(static_cast<float>(a * AzimuthStep),
+                static_cast<float>(MinElevation + static_cast<int>(e) * ElevationStep), right, up, front);
+
+            // Three nearest measurements by great-circle angle
+            size_t nearest[3] = { 0, 0, 0 };
+            float nearestAngle[3] = { 1e9f, 1e9f, 1e9f };
+            for (size_t m = 0; m < prepared.size(); m++) {
+                float dot = right * prepared[m].right + up * prepared[m].up + front * prepared[m].front;
+                float angle = std::acos(std::max(-1.0f, std::min(dot, 1.0f)));
+                for (int slot = 0; slot < 3; slot++) {
+                    if (angle < nearestAngle[slot]) {
+                        for (int move = 2; move > slot; move--) {
+                            nearest[move] = nearest[move - 1];
+                            nearestAngle[move] = nearestAngle[move - 1];
+                        }
+                        nearest[slot] = m;
+                        nearestAngle[slot] = angle;
+                        break;
+                    }
+                }
+            }
+
+            float weights[3] = { 0.0f, 0.0f, 0.0f };
+            float weightSum = 0.0f;
+            for (int slot = 0; slot < 3 && slot < static_cast<int>(prepared.size()); slot++) {
+                weights[slot] = 1.0f / std::max(nearestAngle[slot], 1e-4f);
+                weightSum += weights[slot];
+            }
+
+            size_t point = dataset->GetPointIndex(a, e);
+            for (int ear = 0; ear < 2; ear++) {
+                for (int slot = 0; slot < 3; slot++) {
+                    if (weights[slot] == 0.0f) continue;
+                    float w = weights[slot] / weightSum;
+                    AudioSIMD::MultiplyAdd(&irs[(point * 2 + ear) * IrLength], prepared[nearest[slot]].ir[ear].data(), w, IrLength);
+                    pointDelays[point * 2 + ear] += prepared[nearest[slot]].delay[ear] * w;
+                }
+            }
+        }
+    }
+
+    dataset->Build(irs, pointDelays);
+    return dataset;
+}
+
+ma_uint32 HrtfDataset::GetSampleRate() const {
+    return sampleRate;
+}
+
+size_t HrtfDataset::GetAzimuthCount() const {
+    return 360 / AzimuthStep;
+}
+
+size_t HrtfDataset::GetElevationCount() const {
+    return (MaxElevation - MinElevation) / ElevationStep + 1;
+}
+
+size_t HrtfDataset::GetPointIndex(size_t azimuthIndex, size_t elevationIndex) const {
+    return elevationIndex * GetAzimuthCount() + azimuthIndex;
+}
+
+void HrtfDataset::Build(const std::vector<float>& irs, const std::vector<float>& pointDelays) {
+    // Diffuse-field normalization: averaged over every direction, each ear passes
+    // half the input power, so HRTF and panned sounds sit at similar levels
+    double energy = 0.0;
+    for (float sample : irs) energy += static_cast<double>(sample) * sample;
+    size_t responses = irs.size() / IrLength;
+    float scale = (energy > 0.0) ? static_cast<float>(std::sqrt(0.5 * responses / energy)) : 1.0f;
+
+    // Zero-padded to the FFT size so the spectra can be used for overlap-save directly
+    std::vector<float> padded(FftSize, 0.0f);
+    for (size_t response = 0; response < responses; response++) {
+        for (size_t i = 0; i < IrLength; i++) {
+            padded[i] = irs[response * IrLength + i] * scale;
+        }
+        fft.Forward(padded.data(), &spectraRe[response * BinCount], &spectraIm[response * BinCount]);
+    }
+
+    delays = pointDelays;
+}
+
+void HrtfDataset::Interpolate(float azimuth, float elevation, float* leftRe, float* leftIm,
+    float* rightRe, float* rightIm, float& leftDelay, float& rightDelay) const {
+    const size_t azimuthCount = GetAzimuthCount();
+    const size_t elevationCount = GetElevationCount();
+
+    float azimuthPosition = WrapDegrees(azimuth) / AzimuthStep;
+    size_t a0 = static_cast<size_t>(azimuthPosition) % azimuthCount;
+    size_t a1 = (a0 + 1) % azimuthCount;
+    float ta = azimuthPosition - std::floor(azimuthPosition);
+
+    float elevationPosition = (std::max(static_cast<float>(MinElevation), std::min(elevation, static_cast<float>(MaxElevation))) - MinElevation) / ElevationStep;
+    size_t e0 = std::min(static_cast<size_t>(elevationPosition), elevationCount - 1);
+    size_t e1 = std::min(e0 + 1, elevationCount - 1);
+    float te = elevationPosition - e0;
+
+    const size_t points[4] = { GetPointIndex(a0, e0), GetPointIndex(a1, e0), GetPointIndex(a0, e1), GetPointIndex(a1, e1) };
+    const float weights[4] = { (1 - ta) * (1 - te), ta * (1 - te), (1 - ta) * te, ta * te };
+
+    float* outRe[2] = { leftRe, rightRe };
+    float* outIm[2] = { leftIm, rightIm };
+    float delay[2] = { 0.0f, 0.0f };
+
+    for (int ear = 0; ear < 2; ear++) {
+        std::fill(outRe[ear], outRe[ear] + BinCount, 0.0f);
+        std::fill(outIm[ear], outIm[ear] + BinCount, 0.0f);
+
+        for (int p = 0; p < 4; p++) {
+            if (weights[p] == 0.0f) continue;
+            size_t base = (points[p] * 2 + ear) * BinCount;
+            AudioSIMD::MultiplyAdd(outRe[ear], &spectraRe[base], weights[p], BinCount);
+            AudioSIMD::MultiplyAdd(outIm[ear], &spectraIm[base], weights[p], BinCount);
+            delay[ear] += delays[points[p] * 2 + ear] * weights[p];
+        }
+    }
+
+    leftDelay = delay[0];
+    rightDelay = delay[1];
+}
+
+// ---------------------------------------------------------------------------
+// HrtfSpatializer
+// ---------------------------------------------------------------------------
+
+HrtfSpatializer::HrtfSpatializer(std::shared_ptr<HrtfDataset> dataset, ma_sound* source)
+    : dataset(dataset)
+    , source(source)
+    , fft(HrtfDataset::FftSize)
+    , delayMask(0)
+    , delayWrite(0)
+    , fill(0)
+    , hasFilter(false)
+    , azimuth(0.0f)
+    , elevation(0.0f)
+    , gain(0.0f)
+{
+    delay[0] = 0.0f;
+    delay[1] = 0.0f;
+
+    if (channels == 0 || !dataset || !source || dataset->GetSampleRate() != sampleRate) return;
+
+    const size_t blockSize = HrtfDataset::IrLength;
+    const size_t bins = HrtfDataset::BinCount;
+
+    inputBlock.assign(blockSize, 0.0f);
+    window.assign(blockSize * 2, 0.0f);
+    inputRe.assign(bins, 0.0f);
+    inputIm.assign(bins, 0.0f);
+    accRe.assign(bins, 0.0f);
+    accIm.assign(bins, 0.0f);
+    timeBuffer.assign(blockSize * 2, 0.0f);
+    filterRe.assign(bins * 2, 0.0f);
+    filterIm.assign(bins * 2, 0.0f);
+    previousRe.assign(bins * 2, 0.0f);
+    previousIm.assign(bins * 2, 0.0f);
+    earBlock.assign(blockSize * 2, 0.0f);
+    outputBlock.assign(blockSize * 2, 0.0f);
+
+    // Room for a block plus the largest interaural delay at any sensible rate
+    size_t delaySize = 1;
+    while (delaySize < blockSize + sampleRate / 1000 + 4) delaySize <<= 1;
+    delayMask = delaySize - 1;
+    delayLine.assign(delaySize * 2, 0.0f);
+
+    InitNode();
+}
+
+HrtfSpatializer::~HrtfSpatializer() {
+    UninitNode();
+}
+
+void HrtfSpatializer::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pFramesIn = ppFramesIn[0];
+    const float downmix = 1.0f / channels;
+
+    for (ma_uint32 frame = 0; frame < frameCount; frame++) {
+        const float* pIn = &pFramesIn[frame * channels];
+        float* pOut = &pFramesOut[frame * channels];
+
+        float mono = 0.0f;
+        for (ma_uint32 c = 0; c < channels; c++) {
+            mono += pIn[c];
+        }
+        inputBlock[fill] = mono * downmix;
+
+        float left = outputBlock[fill * 2 + 0];
+        float right = outputBlock[fill * 2 + 1];
+        if (channels == 1) {
+            pOut[0] = (left + right) * 0.5f;
+        }
+        else {
+            pOut[0] = left;
+            pOut[1] = right;
+            for (ma_uint32 c = 2; c < channels; c++) {
+                pOut[c] = 0.0f;
+            }
+        }
+
+        if (++fill == HrtfDataset::IrLength) {
+            ProcessBlock();
+            fill = 0;
+        }
+    }
+}
+
+float HrtfSpatializer::ComputeDistanceGain(float distance) const {
+    float minDistance = ma_sound_get_min_distance(source);
+    float maxDistance = ma_sound_get_max_distance(source);
+    float rolloff = ma_sound_get_rolloff(source);
+    float d = std::max(minDistance, std::min(distance, maxDistance));
+    float result = 1.0f;
+
+    // Same curves as miniaudio's spatializer, which is bypassed while this is active
+    switch (ma_sound_get_attenuation_model(source)) {
+    case ma_attenuation_model_inverse:
+        if (minDistance < maxDistance) {
+            result = minDistance / (minDistance + rolloff * (d - minDistance));
+        }
+        break;
+    case ma_attenuation_model_linear:
+        if (minDistance < maxDistance) {
+            result = 1.0f - rolloff * (d - minDistance) / (maxDistance - minDistance);
+        }
+        break;
+    case ma_attenuation_model_exponential:
+        if (minDistance < maxDistance && minDistance > 0.0f) {
+            result = std::pow(d / minDistance, -rolloff);
+        }
+        break;
+    default:
+        break;
+    }
+
+    return std::max(ma_sound_get_min_gain(source), std::min(result, ma_sound_get_max_gain(source)));
+}
+
+void HrtfSpatializer::ProcessBlock() {
+    const size_t blockSize = HrtfDataset::IrLength;
+    const size_t bins = HrtfDataset::BinCount;
+
+    std::copy(window.begin() + blockSize, window.end(), window.begin());
+    std::copy(inputBlock.begin(), inputBlock.end(), window.begin() + blockSize);
+    fft.Forward(window.data(), inputRe.data(), inputIm.data());
+
+    // Where is the sound relative to its listener? Listener space is right-handed with -Z forward.
+    ma_engine* soundEngine = ma_sound_get_engine(source);
+    ma_uint32 listenerIndex = ma_sound_get_listener_index(source);
+    ma_vec3f relative;
+    ma_spatializer_get_relative_position_and_direction(&source->engineNode.spatializer,
+        &soundEngine->listeners[listenerIndex], &relative, NULL);
+
+    float distance = std::sqrt(relative.x * relative.x + relative.y * relative.y + relative.z * relative.z);
+    float targetAzimuth = azimuth;
+    float targetElevation = elevation;
+    if (distance > 1e-4f) {
+        targetAzimuth = std::atan2(relative.x, -relative.z) / g_degreesToRadians;
+        targetElevation = std::asin(std::max(-1.0f, std::min(relative.y / distance, 1.0f))) / g_degreesToRadians;
+    }
+    float targetGain = ComputeDistanceGain(distance);
+
+    float azimuthChange = std::fabs(WrapDegrees(targetAzimuth - azimuth + 180.0f) - 180.0f);
+    bool changed = !hasFilter || azimuthChange > 0.5f || std::fabs(targetElevation - elevation) > 0.5f;
+    bool crossfade = changed && hasFilter;
+
+    float targetDelay[2] = { delay[0], delay[1] };
+    if (changed) {
+        previousRe.swap(filterRe);
+        previousIm.swap(filterIm);
+        dataset->Interpolate(targetAzimuth, targetElevation, &filterRe[0], &filterIm[0],
+            &filterRe[bins], &filterIm[bins], targetDelay[0], targetDelay[1]);
+        azimuth = targetAzimuth;
+        elevation = targetElevation;
+    }
+
+    if (!hasFilter) {
+        delay[0] = targetDelay[0];
+        delay[1] = targetDelay[1];
+        gain = targetGain;
+        hasFilter = true;
+    }
+
+    for (int ear = 0; ear < 2; ear++) {
+        float* pEar = &earBlock[ear * blockSize];
+
+        if (crossfade) {
+            std::fill(accRe.begin(), accRe.end(), 0.0f);
+            std::fill(accIm.begin(), accIm.end(), 0.0f);
+            AudioSIMD::ComplexMultiplyAccumulate(accRe.data(), accIm.data(), inputRe.data(), inputIm.data(),
+                &previousRe[ear * bins], &previousIm[ear * bins], bins);
+            fft.Inverse(accRe.data(), accIm.data(), timeBuffer.data());
+            std::copy(timeBuffer.begin() + blockSize, timeBuffer.end(), pEar);
+        }
+
+        std::fill(accRe.begin(), accRe.end(), 0.0f);
+        std::fill(accIm.begin(), accIm.end(), 0.0f);
+        AudioSIMD::ComplexMultiplyAccumulate(accRe.data(), accIm.data(), inputRe.data(), inputIm.data(),
+            &filterRe[ear * bins], &filterIm[ear * bins], bins);
+        fft.Inverse(accRe.data(), accIm.data(), timeBuffer.data());
+
+        if (crossfade) {
+            for (size_t i = 0; i < blockSize; i++) {
+                float t = (i + 1.0f) / blockSize;
+                pEar[i] += (timeBuffer[blockSize + i] - pEar[i]) * t;
+            }
+        }
+        else {
+            std::copy(timeBuffer.begin() + blockSize, timeBuffer.end(), pEar);
+        }
+    }
+
+    // Interaural delays and distance gain, both ramped across the block
+    const size_t delaySize = delayMask + 1;
+    for (int ear = 0; ear < 2; ear++) {
+        float* pLine = &delayLine[ear * delaySize];
+        const float* pEar = &earBlock[ear * blockSize];
+
+        for (size_t i = 0; i < blockSize; i++) {
+            float t = (i + 1.0f) / blockSize;
+            pLine[(delayWrite + i) & delayMask] = pEar[i];
+
+            float d = delay[ear] + (targetDelay[ear] - delay[ear]) * t;
+            float readPosition = static_cast<float>(delayWrite + i + delaySize) - d;
+            size_t index = static_cast<size_t>(readPosition);
+            float frac = readPosition - index;
+            float a = pLine[index & delayMask];
+            float b = pLine[(index + 1) & delayMask];
+
+            float g = gain + (targetGain - gain) * t;
+            outputBlock[i * 2 + ear] = (a + (b - a) * frac) * g;
+        }
+    }
+
+    delayWrite = (delayWrite + blockSize) & delayMask;
+    delay[0] = targetDelay[0];
+    delay[1] = targetDelay[1];
+    gain = targetGain;
+}
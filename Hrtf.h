@@ -0,0 +1,117 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEffect.h"
+#include "FFT.h"
+
+#include <memory>
+#include <vector>
+
+// One measured head-related impulse response pair
+struct HrtfMeasurement {
+    float azimuth;              // Degrees, 0 = front, positive to the right
+    float elevation;            // Degrees, positive up
+    std::vector<float> left;
+    std::vector<float> right;
+};
+
+// HRTF set resampled onto a regular azimuth/elevation grid at the engine sample
+// rate. Interaural time differences are split out of the impulse responses and
+// stored as per-ear delays, so the remaining filters are close to minimum phase
+// and can be interpolated directly in the frequency domain. Immutable once built,
+// so it can be shared by every spatializer.
+class HrtfDataset {
+public:
+    static const size_t IrLength = 128;
+    static const size_t FftSize = IrLength * 2;
+    static const size_t BinCount = IrLength + 1;
+
+    // Structural spherical-head model (head shadow, ITD and pinna reflections)
+    static std::shared_ptr<HrtfDataset> CreateBuiltIn(ma_uint32 sampleRate);
+
+    // Builds a dataset from measured HRIRs (e.g. read from a SOFA file by tooling).
+    // Grid points are filled by inverse-distance weighting of the nearest measurements.
+    static std::shared_ptr<HrtfDataset> CreateFromMeasurements(const std::vector<HrtfMeasurement>& measurements,
+        ma_uint32 measurementSampleRate, ma_uint32 sampleRate);
+
+    ma_uint32 GetSampleRate() const;
+
+    // Bilinearly interpolated filter spectra (BinCount bins each) and per-ear delays in frames
+    void Interpolate(float azimuth, float elevation, float* leftRe, float* leftIm,
+        float* rightRe, float* rightIm, float& leftDelay, float& rightDelay) const;
+
+private:
+    static const int AzimuthStep = 10;
+    static const int ElevationStep = 10;
+    static const int MinElevation = -40;
+    static const int MaxElevation = 90;
+
+    explicit HrtfDataset(ma_uint32 sampleRate);
+
+    size_t GetAzimuthCount() const;
+    size_t GetElevationCount() const;
+    size_t GetPointIndex(size_t azimuthIndex, size_t elevationIndex) const;
+    // Normalizes and transforms delay-free responses laid out [point][ear][IrLength]
+    void Build(const std::vector<float>& irs, const std::vector<float>& pointDelays);
+
+    ma_uint32 sampleRate;
+    RealFFT fft;
+
+    // [point][ear][bin]
+    std::vector<float> spectraRe;
+    std::vector<float> spectraIm;
+    // [point][ear]
+    std::vector<float> delays;
+};
+
+// Binaural spatializer for a single sound. Sits in the sound's voice effect chain
+// in place of miniaudio's panner: each block it reads the sound's position
+// relative to its listener, looks up the interpolated HRTF, filters a mono downmix
+// with one forward and two inverse FFTs, applies the per-ear delays and distance
+// attenuation, and crossfades whenever the direction changes.
+//
+// Output lags the input by HrtfDataset::IrLength frames.
+class HrtfSpatializer : public AudioEffect {
+public:
+    HrtfSpatializer(std::shared_ptr<HrtfDataset> dataset, ma_sound* source);
+    ~HrtfSpatializer() override;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    void ProcessBlock();
+    float ComputeDistanceGain(float distance) const;
+
+    std::shared_ptr<HrtfDataset> dataset;
+    ma_sound* source;
+    RealFFT fft;
+
+    std::vector<float> inputBlock;
+    std::vector<float> window;
+    std::vector<float> inputRe;
+    std::vector<float> inputIm;
+    std::vector<float> accRe;
+    std::vector<float> accIm;
+    std::vector<float> timeBuffer;
+
+    // Current and previous filters, [ear][bin]
+    std::vector<float> filterRe;
+    std::vector<float> filterIm;
+    std::vector<float> previousRe;
+    std::vector<float> previousIm;
+
+    std::vector<float> earBlock;        // [ear][frame]
+    std::vector<float> delayLine;       // [ear][frame]
+    size_t delayMask;
+    size_t delayWrite;
+
+    std::vector<float> outputBlock;     // Interleaved L/R, played during the next block
+    size_t fill;
+
+    bool hasFilter;
+    float azimuth;
+    float elevation;
+    float delay[2];
+    float gain;
+};
@@ -0,0 +1,210 @@
+#include "miniaudio.h"
+#include "LatencyHarness.h"
+#include "SoundComponent.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <memory>
+#include <random>
+#include <thread>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+static const char* g_probeSoundName = "latency_probe";
+static const float g_probeTimeoutMs = 1000.0f;
+static const float g_loopbackDrainMs = 50.0f;     // Allowance for the rest of the OS output path
+static const unsigned g_trialSeed = 1234;
+
+static void LoopbackDataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+    (void)pOutput;
+
+    LatencyProbe* probe = static_cast<LatencyProbe*>(pDevice->pUserData);
+    probe->Process(static_cast<const float*>(pInput), frameCount, pDevice->capture.channels, pDevice->sampleRate);
+}
+
+static void PrintStats(const char* label, const LatencyProbe::Stats& stats, std::ostream& out) {
+    out << "    " << label << ": min " << stats.minMs << "  mean " << stats.meanMs
+        << "  p50 " << stats.p50Ms << "  p95 " << stats.p95Ms << "  p99 " << stats.p99Ms
+        << "  max " << stats.maxMs << " ms";
+    if (stats.missed > 0) {
+        out << "  (" << stats.missed << " missed)";
+    }
+    out << "\n";
+}
+
+LatencyHarness::LatencyHarness(const LatencyHarnessConfig& config)
+    : config(config)
+{
+}
+
+std::vector<LatencyHarness::Result> LatencyHarness::Run() {
+    std::vector<Result> results;
+    AudioEngine& engine = AudioEngine::Instance();
+
+    // The tone has to reach the mixer at full scale
+    const bool normalization = engine.IsLoudnessNormalizationEnabled();
+    const float loudnessTarget = engine.GetLoudnessTarget();
+    engine.SetLoudnessNormalization(false);
+
+    for (ma_uint32 periodSize : config.periodSizes) {
+        engine.Shutdown();
+
+        AudioEngineConfig engineConfig;
+        engineConfig.periodSizeInFrames = periodSize;
+        engineConfig.nullDevice = config.nullDevice;
+        if (!engine.Initialize(engineConfig) || !WriteProbeSound(ma_engine_get_sample_rate(engine.GetEngine()))) {
+            continue;
+        }
+
+        for (ma_uint32 voices : config.voiceCounts) {
+            Result result = Measure(voices);
+            result.periodSize = periodSize;
+            results.push_back(result);
+        }
+    }
+
+    engine.Shutdown();
+    std::remove(config.probePath.c_str());
+    engine.SetLoudnessNormalization(normalization, loudnessTarget);
+    return results;
+}
+
+void LatencyHarness::Print(const std::vector<Result>& results, std::ostream& out) {
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+    out << std::fixed << std::setprecision(2);
+
+    for (const Result& result : results) {
+        out << "period " << result.periodSize << " (device " << result.device.periodSizeInFrames
+            << " x" << result.device.periods << " @ " << result.device.sampleRate << " Hz, "
+            << result.device.bufferMs << " ms buffered), " << result.voices << " load voices\n";
+        PrintStats("mixer   ", result.mixer, out);
+        if (result.loopback.count > 0 || result.loopback.missed > 0) {
+            PrintStats("loopback", result.loopback, out);
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+bool LatencyHarness::WriteProbeSound(ma_uint32 sampleRate) const {
+    ma_encoder_config encoderConfig = ma_encoder_config_init(ma_encoding_format_wav, ma_format_f32, 1, sampleRate);
+    ma_encoder encoder;
+    if (ma_encoder_init_file(config.probePath.c_str(), &encoderConfig, &encoder) != MA_SUCCESS) {
+        return false;
+    }
+
+    // 100 ms of a 1 kHz square wave: loud from the first frame
+    std::vector<float> tone(sampleRate / 10);
+    const ma_uint32 halfCycle = std::max(1u, sampleRate / 2000);
+    for (size_t i = 0; i < tone.size(); i++) {
+        tone[i] = ((i / halfCycle) % 2 == 0) ? 0.5f : -0.5f;
+    }
+
+    ma_result result = ma_encoder_write_pcm_frames(&encoder, tone.data(), tone.size(), NULL);
+    ma_encoder_uninit(&encoder);
+    return result == MA_SUCCESS;
+}
+
+LatencyHarness::Result LatencyHarness::Measure(ma_uint32 voices) {
+    AudioEngine& engine = AudioEngine::Instance();
+    Result result;
+    result.voices = voices;
+    result.device = engine.GetDeviceLatency();
+
+    SoundComponent component;
+    SoundComponent::AddSound(g_probeSoundName, config.probePath, AudioCategory::SFX, LoadPolicy::Decode);
+
+    // Load voices: silent, looping and slightly pitched so they go through the resampler
+    std::vector<std::string> loadNames;
+    for (ma_uint32 i = 0; i < voices; i++) {
+        loadNames.push_back("latency_load_" + std::to_string(i));
+        SoundComponent::AddSound(loadNames.back(), config.probePath, AudioCategory::SFX, LoadPolicy::Decode);
+        component.SetRandomPitchRange(loadNames.back(), 0.9f, 1.1f);
+        component.PlaySound(loadNames.back(), true);
+        component.SetSoundVolume(loadNames.back(), 0.0f);
+    }
+
+    LatencyProbe mixerProbe(LatencyProbe::Tap::Mixer);
+    engine.SetLatencyProbe(&mixerProbe);
+
+    LatencyProbe loopbackProbe(LatencyProbe::Tap::Capture);
+    ma_device loopbackDevice;
+    bool loopback = false;
+    if (config.loopback && !config.nullDevice) {
+        ma_device_config deviceConfig = ma_device_config_init(ma_device_type_loopback);
+        deviceConfig.capture.format = ma_format_f32;
+        deviceConfig.dataCallback = &LoopbackDataCallback;
+        deviceConfig.pUserData = &loopbackProbe;
+        loopback = ma_device_init(NULL, &deviceConfig, &loopbackDevice) == MA_SUCCESS;
+        if (loopback && ma_device_start(&loopbackDevice) != MA_SUCCESS) {
+            ma_device_uninit(&loopbackDevice);
+            loopback = false;
+        }
+    }
+
+    // Triggers land at random points in the period, so the spread covers it
+    std::mt19937 random(g_trialSeed);
+    std::uniform_real_distribution<float> jitterMs(0.0f, std::max(1.0f, result.device.periodMs));
+    const float drainMs = result.device.bufferMs * 2.0f + (loopback ? g_loopbackDrainMs : 0.0f);
+
+    std::vector<float> mixerLatencies;
+    std::vector<float> loopbackLatencies;
+    size_t mixerMissed = 0;
+    size_t loopbackMissed = 0;
+    for (ma_uint32 trial = 0; trial < config.trials; trial++) {
+        mixerProbe.Arm();
+        if (loopback) {
+            loopbackProbe.Arm();
+        }
+
+        component.PlaySound(g_probeSoundName);
+        const auto requestTime = std::chrono::steady_clock::now();
+
+        const float mixerMs = mixerProbe.Wait(requestTime, g_probeTimeoutMs);
+        if (mixerMs >= 0.0f) {
+            mixerLatencies.push_back(mixerMs);
+        }
+        else {
+            mixerMissed++;
+        }
+        if (loopback) {
+            const float loopbackMs = loopbackProbe.Wait(requestTime, g_probeTimeoutMs);
+            if (loopbackMs >= 0.0f) {
+                loopbackLatencies.push_back(loopbackMs);
+            }
+            else {
+                loopbackMissed++;
+            }
+        }
+
+        // Let the tone drain out of the device before the next trigger
+        component.StopSound(g_probeSoundName);
+        std::this_thread::sleep_for(std::chrono::microseconds(
+            static_cast<long long>((drainMs + jitterMs(random)) * 1000.0f)));
+    }
+
+    if (loopback) {
+        ma_device_uninit(&loopbackDevice);
+    }
+    engine.SetLatencyProbe(nullptr);
+
+    SoundComponent::RemoveSound(g_probeSoundName);
+    for (const auto& name : loadNames) {
+        SoundComponent::RemoveSound(name);
+    }
+
+    result.mixer = LatencyProbe::Summarize(mixerLatencies, mixerMissed);
+    if (loopback) {
+        result.loopback = LatencyProbe::Summarize(loopbackLatencies, loopbackMissed);
+    }
+    return result;
+}
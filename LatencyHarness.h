@@ -0,0 +1,48 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEngine.h"
+#include "LatencyProbe.h"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct LatencyHarnessConfig {
+    std::vector<ma_uint32> periodSizes = { 128, 256, 512, 1024 };
+    std::vector<ma_uint32> voiceCounts = { 0, 32, 128 };   // Load levels
+    ma_uint32 trials = 50;
+    bool nullDevice = true;         // Otherwise the default hardware device
+    bool loopback = false;          // Also time a loopback capture of the output (WASAPI only)
+    std::string probePath = "latency_probe.wav";           // Written for the run, then removed
+};
+
+// Trigger-to-output latency: from SoundComponent::PlaySound returning on a short
+// tone to its first non-silent frame leaving the mixer, and optionally to that
+// frame coming back through a loopback capture of the output. Every period size
+// is measured at every load level, where the load is that many extra voices
+// playing silently.
+//
+// The run restarts the audio engine for each period size and leaves it shut down,
+// so it is meant for a dedicated process (see "--latency-test" in main).
+class LatencyHarness {
+public:
+    struct Result {
+        ma_uint32 periodSize = 0;       // Requested
+        ma_uint32 voices = 0;
+        AudioDeviceLatency device;      // Negotiated
+        LatencyProbe::Stats mixer;
+        LatencyProbe::Stats loopback;   // Empty when not measured
+    };
+
+    explicit LatencyHarness(const LatencyHarnessConfig& config = LatencyHarnessConfig());
+
+    std::vector<Result> Run();
+    static void Print(const std::vector<Result>& results, std::ostream& out);
+
+private:
+    bool WriteProbeSound(ma_uint32 sampleRate) const;
+    Result Measure(ma_uint32 voices);
+
+    LatencyHarnessConfig config;
+};
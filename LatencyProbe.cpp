@@ -0,0 +1,100 @@
+#include "LatencyProbe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+using ProbeClock = std::chrono::steady_clock;
+
+LatencyProbe::LatencyProbe(Tap tap, float threshold)
+    : tap(tap)
+    , threshold(threshold)
+    , armed(false)
+    , onset(0)
+{
+}
+
+void LatencyProbe::Arm() {
+    onset.store(0, std::memory_order_relaxed);
+    armed.store(true, std::memory_order_release);
+}
+
+float LatencyProbe::Wait(ProbeClock::time_point requestTime, float timeoutMs) {
+    const auto deadline = requestTime + std::chrono::microseconds(static_cast<long long>(timeoutMs * 1000.0f));
+    long long found = 0;
+    while ((found = onset.load(std::memory_order_acquire)) == 0) {
+        if (ProbeClock::now() > deadline) {
+            armed.store(false, std::memory_order_relaxed);
+            return -1.0f;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    // An onset rendered before the trigger returned counts as no delay
+    const ProbeClock::time_point onsetTime{ ProbeClock::duration(found) };
+    const float latencyMs = std::chrono::duration<float, std::milli>(onsetTime - requestTime).count();
+    return std::max(0.0f, latencyMs);
+}
+
+void LatencyProbe::Process(const float* frames, ma_uint32 frameCount, ma_uint32 channels, ma_uint32 sampleRate) {
+    if (!armed.load(std::memory_order_acquire) || sampleRate == 0) {
+        return;
+    }
+
+    const ProbeClock::time_point now = ProbeClock::now();
+    for (ma_uint32 frame = 0; frame < frameCount; frame++) {
+        for (ma_uint32 c = 0; c < channels; c++) {
+            if (std::fabs(frames[frame * channels + c]) <= threshold) {
+                continue;
+            }
+
+            // Mixed periods leave all at once and play out in order; captured frames
+            // were recorded before the period was delivered
+            const double offsetSeconds = (tap == Tap::Mixer)
+                ? static_cast<double>(frame) / sampleRate
+                : -static_cast<double>(frameCount - frame) / sampleRate;
+            const ProbeClock::time_point frameTime = now
+                + std::chrono::duration_cast<ProbeClock::duration>(std::chrono::duration<double>(offsetSeconds));
+
+            // Ticks are never 0 on a running clock, which keeps 0 free for "not found"
+            armed.store(false, std::memory_order_relaxed);
+            onset.store(frameTime.time_since_epoch().count(), std::memory_order_release);
+            return;
+        }
+    }
+}
+
+LatencyProbe::Stats LatencyProbe::Summarize(std::vector<float> latenciesMs, size_t missed) {
+    Stats stats;
+    stats.count = latenciesMs.size();
+    stats.missed = missed;
+    if (latenciesMs.empty()) {
+        return stats;
+    }
+
+    std::sort(latenciesMs.begin(), latenciesMs.end());
+    auto percentile = [&latenciesMs](float p) {
+        const size_t index = static_cast<size_t>(std::ceil(p * latenciesMs.size())) - 1;
+        return latenciesMs[std::min(index, latenciesMs.size() - 1)];
+    };
+
+    double sum = 0.0;
+    for (float latency : latenciesMs) {
+        sum += latency;
+    }
+    stats.minMs = latenciesMs.front();
+    stats.meanMs = static_cast<float>(sum / latenciesMs.size());
+    stats.p50Ms = percentile(0.50f);
+    stats.p95Ms = percentile(0.95f);
+    stats.p99Ms = percentile(0.99f);
+    stats.maxMs = latenciesMs.back();
+    return stats;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// Times how long a sound takes to come out of a tap point: arm the probe, trigger
+// the sound, then wait for the first frame above the threshold. The output must
+// be otherwise silent while the probe is armed.
+//
+// The Mixer tap is fed by AudioEngine (see SetLatencyProbe) with each period as it
+// leaves the mixer; a frame counts from when its period was handed to the device,
+// plus its offset in the period. The Capture tap is fed from a capture or loopback
+// device, where a frame counts from when it was recorded.
+class LatencyProbe {
+public:
+    enum class Tap {
+        Mixer,
+        Capture
+    };
+
+    struct Stats {
+        size_t count = 0;
+        size_t missed = 0;      // Trials that timed out
+        float minMs = 0.0f;
+        float meanMs = 0.0f;
+        float p50Ms = 0.0f;
+        float p95Ms = 0.0f;
+        float p99Ms = 0.0f;
+        float maxMs = 0.0f;
+    };
+
+    explicit LatencyProbe(Tap tap, float threshold = 0.01f);
+
+    // Game thread. Arm before triggering the sound, then Wait with the time the
+    // trigger returned; Wait gives the latency in ms, or a negative value if nothing
+    // arrived within timeoutMs.
+    void Arm();
+    float Wait(std::chrono::steady_clock::time_point requestTime, float timeoutMs);
+
+    // Audio thread
+    void Process(const float* frames, ma_uint32 frameCount, ma_uint32 channels, ma_uint32 sampleRate);
+
+    static Stats Summarize(std::vector<float> latenciesMs, size_t missed);
+
+private:
+    Tap tap;
+    float threshold;
+    std::atomic<bool> armed;
+    std::atomic<long long> onset;      // steady_clock ticks, 0 until found
+};
@@ -0,0 +1,235 @@
+#include "miniaudio.h"
+#include "Loudness.h"
+#include "AssetCache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+static const double g_pi = 3.14159265358979323846;
+
+// Gating thresholds from EBU R128
+static const double g_absoluteGateLufs = -70.0;
+static const double g_relativeGateLu = -10.0;
+static const double g_loudnessOffset = -0.691;
+
+static double PowerToLufs(double power) {
+    return g_loudnessOffset + 10.0 * std::log10(power);
+}
+
+static double LufsToPower(double lufs) {
+    return std::pow(10.0, (lufs - g_loudnessOffset) / 10.0);
+}
+
+LoudnessMeter::LoudnessMeter(ma_uint32 channels, ma_uint32 sampleRate)
+    : channels(channels)
+    , subBlockFrames(std::max<ma_uint64>(1, (sampleRate + 5) / 10))
+    , subBlockFill(0)
+    , subBlockCount(0)
+    , totalPower(0.0)
+    , totalFrames(0)
+{
+    // BS.1770 specifies the filters at 48kHz; derive them for any rate from their analog prototypes
+    double rate = (sampleRate > 0) ? sampleRate : 48000.0;
+    {
+        double f0 = 1681.974450955533;
+        double gainDb = 3.999843853973347;
+        double q = 0.7071752369554196;
+        double k = std::tan(g_pi * f0 / rate);
+        double vh = std::pow(10.0, gainDb / 20.0);
+        double vb = std::pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        shelf.b0 = (vh + vb * k / q + k * k) / a0;
+        shelf.b1 = 2.0 * (k * k - vh) / a0;
+        shelf.b2 = (vh - vb * k / q + k * k) / a0;
+        shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+        shelf.a2 = (1.0 - k / q + k * k) / a0;
+    }
+    {
+        double f0 = 38.13547087602444;
+        double q = 0.5003270373238773;
+        double k = std::tan(g_pi * f0 / rate);
+        double a0 = 1.0 + k / q + k * k;
+        highPass.b0 = 1.0;
+        highPass.b1 = -2.0;
+        highPass.b2 = 1.0;
+        highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+        highPass.a2 = (1.0 - k / q + k * k) / a0;
+    }
+
+    filterState.assign(channels * 8, 0.0);
+    subBlockSums.assign(channels, 0.0);
+    std::fill(recentSubBlocks, recentSubBlocks + 4, 0.0);
+
+    // 5.1 (L R C LFE Ls Rs): the LFE is ignored and surrounds are weighted up
+    channelWeights.assign(channels, 1.0);
+    if (channels == 6) {
+        channelWeights[3] = 0.0;
+        channelWeights[4] = 1.41;
+        channelWeights[5] = 1.41;
+    }
+}
+
+void LoudnessMeter::Process(const float* pFrames, ma_uint64 frameCount) {
+    if (channels == 0) return;
+
+    for (ma_uint64 frame = 0; frame < frameCount; frame++) {
+        double weighted = 0.0;
+
+        for (ma_uint32 c = 0; c < channels; c++) {
+            double* state = &filterState[c * 8];
+            double x = pFrames[frame * channels + c];
+
+            // Direct form I, two cascaded biquads
+            double y = shelf.b0 * x + shelf.b1 * state[0] + shelf.b2 * state[1] - shelf.a1 * state[2] - shelf.a2 * state[3];
+            state[1] = state[0];
+            state[0] = x;
+            state[3] = state[2];
+            state[2] = y;
+
+            double z = highPass.b0 * y + highPass.b1 * state[4] + highPass.b2 * state[5] - highPass.a1 * state[6] - highPass.a2 * state[7];
+            state[5] = state[4];
+            state[4] = y;
+            state[7] = state[6];
+            state[6] = z;
+
+            subBlockSums[c] += z * z;
+            weighted += channelWeights[c] * z * z;
+        }
+
+        totalPower += weighted;
+        totalFrames++;
+
+        if (++subBlockFill == subBlockFrames) {
+            double power = 0.0;
+            for (ma_uint32 c = 0; c < channels; c++) {
+                power += channelWeights[c] * subBlockSums[c] / subBlockFrames;
+                subBlockSums[c] = 0.0;
+            }
+            subBlockFill = 0;
+
+            recentSubBlocks[subBlockCount % 4] = power;
+            subBlockCount++;
+
+            // A 400 ms block completes every 100 ms once four sub-blocks are in
+            if (subBlockCount >= 4) {
+                blockPowers.push_back((recentSubBlocks[0] + recentSubBlocks[1] + recentSubBlocks[2] + recentSubBlocks[3]) * 0.25);
+            }
+        }
+    }
+}
+
+bool LoudnessMeter::GetIntegratedLoudness(float& lufs) const {
+    const double absoluteGate = LufsToPower(g_absoluteGateLufs);
+
+    // Too short for a single block: measure everything as one
+    if (blockPowers.empty()) {
+        if (totalFrames == 0) return false;
+        double power = totalPower / totalFrames;
+        if (power < absoluteGate) return false;
+        lufs = static_cast<float>(PowerToLufs(power));
+        return true;
+    }
+
+    double sum = 0.0;
+    size_t count = 0;
+    for (double power : blockPowers) {
+        if (power >= absoluteGate) {
+            sum += power;
+            count++;
+        }
+    }
+    if (count == 0) return false;
+
+    const double relativeGate = (sum / count) * std::pow(10.0, g_relativeGateLu / 10.0);
+    sum = 0.0;
+    count = 0;
+    for (double power : blockPowers) {
+        if (power >= absoluteGate && power >= relativeGate) {
+            sum += power;
+            count++;
+        }
+    }
+    if (count == 0) return false;
+
+    lufs = static_cast<float>(PowerToLufs(sum / count));
+    return true;
+}
+
+bool LoudnessMeter::AnalyzeFile(const std::string& filePath, float& lufs) {
+    // Native channel count and rate, so the measurement doesn't depend on the device
+    ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, 0);
+    ma_decoder decoder;
+    if (ma_decoder_init_file(filePath.c_str(), &config, &decoder) != MA_SUCCESS) {
+        return false;
+    }
+
+    LoudnessMeter meter(decoder.outputChannels, decoder.outputSampleRate);
+    std::vector<float> buffer(4096 * decoder.outputChannels);
+
+    for (;;) {
+        ma_uint64 framesRead = 0;
+        ma_result result = ma_decoder_read_pcm_frames(&decoder, buffer.data(), 4096, &framesRead);
+        meter.Process(buffer.data(), framesRead);
+        if (result != MA_SUCCESS || framesRead == 0) break;
+    }
+
+    ma_decoder_uninit(&decoder);
+    return meter.GetIntegratedLoudness(lufs);
+}
+
+bool LoudnessMeter::GetFileLoudness(const std::string& filePath, const std::string& cacheDirectory, float& lufs) {
+    AssetCache::FileStamp stamp;
+    if (!AssetCache::GetFileStamp(filePath, stamp)) {
+        return false;
+    }
+
+    // Sidecar format: "size=<bytes>", "mtime=<seconds>" and "lufs=<value>" lines
+    const std::string sidecarPath = AssetCache::GetCachePath(cacheDirectory, filePath, ".loudness");
+    {
+        std::ifstream sidecar(sidecarPath);
+        std::string line;
+        AssetCache::FileStamp cachedStamp;
+        bool haveLoudness = false;
+        float cached = 0.0f;
+        while (std::getline(sidecar, line)) {
+            std::istringstream value(line.substr(std::min<size_t>(line.find('=') + 1, line.size())));
+            if (line.compare(0, 5, "size=") == 0) {
+                value >> cachedStamp.size;
+            }
+            else if (line.compare(0, 6, "mtime=") == 0) {
+                value >> cachedStamp.modifiedTime;
+            }
+            else if (line.compare(0, 5, "lufs=") == 0) {
+                haveLoudness = static_cast<bool>(value >> cached);
+            }
+        }
+        if (cachedStamp == stamp && haveLoudness) {
+            lufs = cached;
+            return true;
+        }
+    }
+
+    if (!AnalyzeFile(filePath, lufs)) {
+        return false;
+    }
+
+    // Best effort; a read-only cache just means analysing again next run
+    AssetCache::CreateDirectories(cacheDirectory);
+    std::ofstream sidecar(sidecarPath, std::ios::trunc);
+    if (sidecar) {
+        sidecar << "size=" << stamp.size << "\n";
+        sidecar << "mtime=" << stamp.modifiedTime << "\n";
+        sidecar << "lufs=" << lufs << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <string>
+#include <vector>
+
+// Integrated loudness meter following ITU-R BS.1770-4 / EBU R128: K-weighting,
+// 400 ms blocks with 75% overlap, and absolute (-70 LUFS) plus relative (-10 LU)
+// gating. Feed interleaved f32 frames, then read the result.
+class LoudnessMeter {
+public:
+    LoudnessMeter(ma_uint32 channels, ma_uint32 sampleRate);
+
+    void Process(const float* pFrames, ma_uint64 frameCount);
+
+    // LUFS; returns false for silence or empty input
+    bool GetIntegratedLoudness(float& lufs) const;
+
+    // Decodes the whole file and measures it
+    static bool AnalyzeFile(const std::string& filePath, float& lufs);
+
+    // Same as AnalyzeFile, but remembers the result in a ".loudness" file in
+    // cacheDirectory, keyed by the source's size and modification time, so each
+    // asset is analysed only once
+    static bool GetFileLoudness(const std::string& filePath, const std::string& cacheDirectory, float& lufs);
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    ma_uint32 channels;
+    Biquad shelf;                       // Stage 1: head acoustics
+    Biquad highPass;                    // Stage 2: revised low-frequency B-curve
+    std::vector<double> filterState;    // Four values per stage per channel
+    std::vector<double> channelWeights;
+
+    ma_uint64 subBlockFrames;           // 100 ms
+    ma_uint64 subBlockFill;
+    std::vector<double> subBlockSums;   // Per channel
+    double recentSubBlocks[4];          // Weighted mean squares of the last four sub-blocks
+    size_t subBlockCount;
+
+    std::vector<double> blockPowers;    // One per 400 ms block, every 100 ms
+    double totalPower;                  // Fallback for inputs shorter than one block
+    ma_uint64 totalFrames;
+};
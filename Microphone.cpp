@@ -0,0 +1,418 @@
+#include "miniaudio.h"
+#include "Microphone.h"
+
+#include <algorithm>
+#include <cstring>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+// The voice is mono; the bus spreads it over the output channels
+static const ma_uint32 g_captureChannels = 1;
+
+// Room in the ring buffer beyond the target, for capture bursts and drift
+static const ma_uint32 g_bufferTargets = 8;
+
+// Processed capture kept for ReadProcessed()
+static const float g_tapSeconds = 1.0f;
+
+const ma_data_source_vtable MicrophoneInput::SourceVTable = {
+    &MicrophoneInput::OnRead,
+    &MicrophoneInput::OnSeek,
+    &MicrophoneInput::OnGetDataFormat,
+    NULL,               // onGetCursor; live input has no position
+    NULL,               // onGetLength; or end
+    NULL,
+    0
+};
+
+// ---------------------------------------------------------------------------
+// MicrophoneMonitorEffect
+// ---------------------------------------------------------------------------
+
+MicrophoneMonitorEffect::MicrophoneMonitorEffect(float tapSeconds)
+    : tapInitialized(false)
+    , tapEnabled(false)
+    , tapDroppedFrames(0)
+    , gain(0.0f)
+    , appliedGain(0.0f)
+{
+    if (!InitNode()) {
+        return;
+    }
+
+    const ma_uint32 tapFrames = std::max(static_cast<ma_uint32>(tapSeconds * sampleRate), 1u);
+    tapInitialized = (ma_pcm_rb_init(ma_format_f32, channels, tapFrames, NULL, NULL, &tapBuffer) == MA_SUCCESS);
+}
+
+MicrophoneMonitorEffect::~MicrophoneMonitorEffect() {
+    UninitNode();
+    if (tapInitialized) {
+        ma_pcm_rb_uninit(&tapBuffer);
+    }
+}
+
+void MicrophoneMonitorEffect::SetGain(float value) {
+    gain.store(std::max(value, 0.0f));
+}
+
+void MicrophoneMonitorEffect::SetTapEnabled(bool enabled) {
+    if (!tapInitialized) return;
+
+    // The reader owns the read side, so it can discard stale frames itself. Nothing
+    // new arrives until the flag is set.
+    if (enabled && !tapEnabled.load()) {
+        ma_uint32 available = ma_pcm_rb_available_read(&tapBuffer);
+        for (int part = 0; part < 2 && available > 0; part++) {
+            ma_uint32 count = available;
+            void* pRead = nullptr;
+            if (ma_pcm_rb_acquire_read(&tapBuffer, &count, &pRead) != MA_SUCCESS || count == 0) break;
+            ma_pcm_rb_commit_read(&tapBuffer, count);
+            available -= count;
+        }
+    }
+    tapEnabled.store(enabled);
+}
+
+ma_uint32 MicrophoneMonitorEffect::ReadTap(float* frames, ma_uint32 frameCount) {
+    if (!tapInitialized) return 0;
+
+    // The buffered frames may wrap around the end of the buffer
+    ma_uint32 offset = 0;
+    for (int part = 0; part < 2 && offset < frameCount; part++) {
+        ma_uint32 count = frameCount - offset;
+        void* pRead = nullptr;
+        if (ma_pcm_rb_acquire_read(&tapBuffer, &count, &pRead) != MA_SUCCESS || count == 0) {
+            break;
+        }
+        std::memcpy(&frames[static_cast<size_t>(offset) * channels], pRead, sizeof(float) * count * channels);
+        ma_pcm_rb_commit_read(&tapBuffer, count);
+        offset += count;
+    }
+    return offset;
+}
+
+ma_uint32 MicrophoneMonitorEffect::GetChannels() const {
+    return channels;
+}
+
+ma_uint64 MicrophoneMonitorEffect::GetTapDroppedFrames() const {
+    return tapDroppedFrames.load(std::memory_order_relaxed);
+}
+
+void MicrophoneMonitorEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    const float* pIn = ppFramesIn[0];
+
+    if (tapInitialized && tapEnabled.load(std::memory_order_relaxed)) {
+        ma_uint32 offset = 0;
+        for (int part = 0; part < 2 && offset < frameCount; part++) {
+            ma_uint32 count = frameCount - offset;
+            void* pWrite = nullptr;
+            if (ma_pcm_rb_acquire_write(&tapBuffer, &count, &pWrite) != MA_SUCCESS || count == 0) {
+                break;
+            }
+            std::memcpy(pWrite, &pIn[static_cast<size_t>(offset) * channels], sizeof(float) * count * channels);
+            ma_pcm_rb_commit_write(&tapBuffer, count);
+            offset += count;
+        }
+        if (offset < frameCount) {
+            tapDroppedFrames.fetch_add(frameCount - offset, std::memory_order_relaxed);
+        }
+    }
+
+    // Ramped over the block, so muting and unmuting don't click
+    const float target = gain.load(std::memory_order_relaxed);
+    const float step = (target - appliedGain) / frameCount;
+    float current = appliedGain;
+    for (ma_uint32 i = 0; i < frameCount; i++) {
+        current += step;
+        for (ma_uint32 c = 0; c < channels; c++) {
+            pFramesOut[i * channels + c] = pIn[i * channels + c] * current;
+        }
+    }
+    appliedGain = target;
+}
+
+// ---------------------------------------------------------------------------
+// MicrophoneInput
+// ---------------------------------------------------------------------------
+
+MicrophoneInput::MicrophoneInput(ma_context* context, ma_device_config deviceConfig, ma_engine* engine,
+    ma_sound_group* group, float targetBufferMs)
+    : deviceInitialized(false)
+    , bufferInitialized(false)
+    , sourceInitialized(false)
+    , soundInitialized(false)
+    , sampleRate(ma_engine_get_sample_rate(engine))
+    , targetFrames(0)
+    , primed(false)
+    , monitoring(false)
+    , volume(1.0f)
+    , bufferedFrames(0)
+    , overrunFrames(0)
+    , underrunFrames(0)
+{
+    // Captured at the engine rate, so the voice never resamples
+    deviceConfig.capture.format = ma_format_f32;
+    deviceConfig.capture.channels = g_captureChannels;
+    deviceConfig.sampleRate = sampleRate;
+    deviceConfig.dataCallback = &MicrophoneInput::CaptureCallback;
+    deviceConfig.notificationCallback = NULL;
+    deviceConfig.pUserData = this;
+    if (ma_device_init(context, &deviceConfig, &device) != MA_SUCCESS) {
+        return;
+    }
+    deviceInitialized = true;
+
+    // Never less than a capture period, or every period would overrun the target
+    targetFrames = std::max(static_cast<ma_uint32>(std::max(targetBufferMs, 0.0f) * sampleRate / 1000.0f),
+        device.capture.internalPeriodSizeInFrames);
+    targetFrames = std::max(targetFrames, 1u);
+    if (ma_pcm_rb_init(ma_format_f32, g_captureChannels, targetFrames * g_bufferTargets, NULL, NULL, &ringBuffer) != MA_SUCCESS) {
+        return;
+    }
+    bufferInitialized = true;
+
+    ma_data_source_config sourceConfig = ma_data_source_config_init();
+    sourceConfig.vtable = &SourceVTable;
+    source.owner = this;
+    if (ma_data_source_init(&sourceConfig, &source) != MA_SUCCESS) {
+        return;
+    }
+    sourceInitialized = true;
+
+    ma_uint32 flags = MA_SOUND_FLAG_NO_SPATIALIZATION | MA_SOUND_FLAG_NO_PITCH;
+    if (ma_sound_init_from_data_source(engine, &source, flags, group, &sound) != MA_SUCCESS) {
+        return;
+    }
+    // The voice stays at unity; muting happens after the processing chain
+    monitor.reset(new MicrophoneMonitorEffect(g_tapSeconds));
+    if (!monitor->IsInitialized()) {
+        ma_sound_uninit(&sound);
+        return;
+    }
+    soundInitialized = true;
+
+    // Processing sits between the voice and its bus, like a sound's voice effects
+    ma_node* bus = group ? reinterpret_cast<ma_node*>(group) : ma_engine_get_endpoint(engine);
+    ma_node_attach_output_bus(monitor->GetNode(), 0, bus, 0);
+    effects.Connect(&sound, monitor->GetNode());
+}
+
+MicrophoneInput::~MicrophoneInput() {
+    // Capture first, so nothing writes into the buffer while the voice goes
+    if (deviceInitialized) {
+        ma_device_uninit(&device);
+    }
+    if (soundInitialized) {
+        effects.Disconnect();
+        ma_sound_uninit(&sound);
+    }
+    monitor.reset();
+    if (sourceInitialized) {
+        ma_data_source_uninit(&source);
+    }
+    if (bufferInitialized) {
+        ma_pcm_rb_uninit(&ringBuffer);
+    }
+}
+
+bool MicrophoneInput::IsInitialized() const {
+    return soundInitialized;
+}
+
+bool MicrophoneInput::Start() {
+    if (!soundInitialized || ma_device_start(&device) != MA_SUCCESS) {
+        return false;
+    }
+    return ma_sound_start(&sound) == MA_SUCCESS;
+}
+
+void MicrophoneInput::Stop() {
+    if (!soundInitialized) return;
+
+    ma_device_stop(&device);
+    ma_sound_stop(&sound);
+}
+
+std::string MicrophoneInput::GetDeviceName() const {
+    return deviceInitialized ? device.capture.name : std::string();
+}
+
+void MicrophoneInput::SetMonitoring(bool enabled) {
+    monitoring.store(enabled);
+    if (soundInitialized) {
+        monitor->SetGain(enabled ? volume.load() : 0.0f);
+    }
+}
+
+bool MicrophoneInput::IsMonitoring() const {
+    return monitoring.load();
+}
+
+void MicrophoneInput::SetVolume(float value) {
+    volume.store(std::max(0.0f, value));
+    SetMonitoring(monitoring.load());
+}
+
+float MicrophoneInput::GetVolume() const {
+    return volume.load();
+}
+
+EffectChain& MicrophoneInput::GetEffects() {
+    return effects;
+}
+
+void MicrophoneInput::SetCaptureTap(bool enabled) {
+    if (soundInitialized) {
+        monitor->SetTapEnabled(enabled);
+    }
+}
+
+ma_uint32 MicrophoneInput::ReadProcessed(float* frames, ma_uint32 frameCount) {
+    return soundInitialized ? monitor->ReadTap(frames, frameCount) : 0;
+}
+
+ma_uint32 MicrophoneInput::GetProcessedChannels() const {
+    return soundInitialized ? monitor->GetChannels() : 0;
+}
+
+MicrophoneStats MicrophoneInput::GetStats(const AudioDeviceLatency& outputLatency) const {
+    MicrophoneStats stats;
+    if (!deviceInitialized) {
+        return stats;
+    }
+
+    stats.device.sampleRate = device.capture.internalSampleRate;
+    stats.device.channels = device.capture.internalChannels;
+    stats.device.periodSizeInFrames = device.capture.internalPeriodSizeInFrames;
+    stats.device.periods = device.capture.internalPeriods;
+    if (stats.device.sampleRate > 0) {
+        stats.device.periodMs = 1000.0f * stats.device.periodSizeInFrames / stats.device.sampleRate;
+        stats.device.bufferMs = stats.device.periodMs * stats.device.periods;
+    }
+
+    stats.bufferedMs = 1000.0f * bufferedFrames.load(std::memory_order_relaxed) / sampleRate;
+    stats.targetBufferMs = 1000.0f * targetFrames / sampleRate;
+
+    // A captured frame waits out, on average, a capture period before the callback
+    // hands it over, then the jitter buffer, then the output device's buffer
+    stats.latencyMs = stats.device.periodMs + stats.bufferedMs + outputLatency.bufferMs;
+    stats.overrunFrames = overrunFrames.load(std::memory_order_relaxed);
+    stats.underrunFrames = underrunFrames.load(std::memory_order_relaxed);
+    stats.tapDroppedFrames = soundInitialized ? monitor->GetTapDroppedFrames() : 0;
+    return stats;
+}
+
+void MicrophoneInput::CaptureCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+    (void)pOutput;
+
+    MicrophoneInput* self = static_cast<MicrophoneInput*>(pDevice->pUserData);
+    self->Write(static_cast<const float*>(pInput), frameCount);
+}
+
+void MicrophoneInput::Write(const float* frames, ma_uint32 frameCount) {
+    // The free space may wrap around the end of the buffer
+    ma_uint32 offset = 0;
+    for (int part = 0; part < 2 && offset < frameCount; part++) {
+        ma_uint32 count = frameCount - offset;
+        void* pWrite = nullptr;
+        if (ma_pcm_rb_acquire_write(&ringBuffer, &count, &pWrite) != MA_SUCCESS || count == 0) {
+            break;
+        }
+        std::memcpy(pWrite, &frames[offset * g_captureChannels], sizeof(float) * count * g_captureChannels);
+        ma_pcm_rb_commit_write(&ringBuffer, count);
+        offset += count;
+    }
+
+    if (offset < frameCount) {
+        overrunFrames.fetch_add(frameCount - offset, std::memory_order_relaxed);
+    }
+}
+
+ma_result MicrophoneInput::OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+    MicrophoneInput* self = reinterpret_cast<SourceBase*>(pDataSource)->owner;
+
+    // Live input never ends; a short read would make the voice finish
+    self->Read(static_cast<float*>(pFramesOut), static_cast<ma_uint32>(frameCount));
+    if (pFramesRead) {
+        *pFramesRead = frameCount;
+    }
+    return MA_SUCCESS;
+}
+
+ma_result MicrophoneInput::OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+    (void)pDataSource;
+    (void)frameIndex;
+    return MA_SUCCESS;
+}
+
+ma_result MicrophoneInput::OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+    ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+    MicrophoneInput* self = reinterpret_cast<SourceBase*>(pDataSource)->owner;
+
+    *pFormat = ma_format_f32;
+    *pChannels = g_captureChannels;
+    *pSampleRate = self->sampleRate;
+    ma_channel_map_init_standard(ma_standard_channel_map_default, pChannelMap, channelMapCap, g_captureChannels);
+    return MA_SUCCESS;
+}
+
+void MicrophoneInput::Read(float* pFramesOut, ma_uint32 frameCount) {
+    ma_uint32 available = ma_pcm_rb_available_read(&ringBuffer);
+
+    // Capture running ahead of the output clock: drop back to the target in one go
+    // rather than carry the extra latency
+    if (available > targetFrames * 2 + frameCount) {
+        ma_uint32 excess = available - targetFrames - frameCount;
+        Skip(excess);
+        overrunFrames.fetch_add(excess, std::memory_order_relaxed);
+        available -= excess;
+    }
+
+    // Wait for the target before playing, so a little jitter doesn't run it dry again
+    if (!primed && available >= targetFrames) {
+        primed = true;
+    }
+
+    ma_uint32 offset = 0;
+    if (primed) {
+        for (int part = 0; part < 2 && offset < frameCount; part++) {
+            ma_uint32 count = frameCount - offset;
+            void* pRead = nullptr;
+            if (ma_pcm_rb_acquire_read(&ringBuffer, &count, &pRead) != MA_SUCCESS || count == 0) {
+                break;
+            }
+            std::memcpy(&pFramesOut[offset * g_captureChannels], pRead, sizeof(float) * count * g_captureChannels);
+            ma_pcm_rb_commit_read(&ringBuffer, count);
+            offset += count;
+        }
+
+        if (offset < frameCount) {
+            underrunFrames.fetch_add(frameCount - offset, std::memory_order_relaxed);
+            primed = false;
+        }
+    }
+
+    if (offset < frameCount) {
+        ma_silence_pcm_frames(&pFramesOut[offset * g_captureChannels], frameCount - offset, ma_format_f32, g_captureChannels);
+    }
+    bufferedFrames.store(ma_pcm_rb_available_read(&ringBuffer), std::memory_order_relaxed);
+}
+
+void MicrophoneInput::Skip(ma_uint32 frameCount) {
+    for (int part = 0; part < 2 && frameCount > 0; part++) {
+        ma_uint32 count = frameCount;
+        void* pRead = nullptr;
+        if (ma_pcm_rb_acquire_read(&ringBuffer, &count, &pRead) != MA_SUCCESS || count == 0) {
+            break;
+        }
+        ma_pcm_rb_commit_read(&ringBuffer, count);
+        frameCount -= count;
+    }
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEngine.h"
+#include "EffectChain.h"
+
+#include <atomic>
+#include <memory>
+
+// How the microphone is opened and buffered
+struct MicrophoneConfig {
+    std::string deviceName;             // Empty for the default capture device
+    AudioCategory category = AudioCategory::VOICE;
+    float targetBufferMs = 10.0f;       // Jitter buffer between the capture and output clocks
+    bool monitor = false;               // Hear yourself through the bus
+};
+
+// Snapshot of the capture path, comparable to AudioEngine::GetDeviceLatency()
+struct MicrophoneStats {
+    AudioDeviceLatency device;          // What the capture device negotiated
+    float bufferedMs = 0.0f;            // In the jitter buffer right now
+    float targetBufferMs = 0.0f;
+    float latencyMs = 0.0f;             // Capture buffer + jitter buffer + output buffer
+    ma_uint64 overrunFrames = 0;        // Dropped: buffer full, or trimmed back to the target
+    ma_uint64 underrunFrames = 0;       // Silence played because capture hadn't delivered
+    ma_uint64 tapDroppedFrames = 0;     // Processed frames the tap had no room for
+};
+
+// Last stage of the microphone path, after the effect chain: copies the processed
+// signal into the tap, then applies the monitor gain. Keeping the gain here rather
+// than on the voice means the chain always runs on the signal at unity.
+class MicrophoneMonitorEffect : public AudioEffect {
+public:
+    explicit MicrophoneMonitorEffect(float tapSeconds);
+    ~MicrophoneMonitorEffect() override;
+
+    void SetGain(float gain);
+
+    // Game thread, one reader. Enabling drops whatever was left over from before.
+    void SetTapEnabled(bool enabled);
+    ma_uint32 ReadTap(float* frames, ma_uint32 frameCount);
+    ma_uint32 GetChannels() const;
+    ma_uint64 GetTapDroppedFrames() const;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    ma_pcm_rb tapBuffer;
+    bool tapInitialized;
+    std::atomic<bool> tapEnabled;
+    std::atomic<ma_uint64> tapDroppedFrames;
+    std::atomic<float> gain;
+    float appliedGain;          // Audio thread; ramped to gain over a block
+};
+
+// Capture device feeding a voice on a category bus. The capture callback writes
+// into a lock-free ring buffer and the voice reads it as a data source on the
+// mixer thread, so neither device thread waits on the other. The two devices run
+// on separate clocks; the reader trims the buffer back to its target when it grows
+// and re-primes it after running dry, so drift costs a few dropped or silent
+// frames rather than growing latency.
+//
+// Monitoring only sets whether the voice is heard: the mute is applied after the
+// processing chain, which runs at unity either way, so effects such as a noise gate
+// stay settled when it is turned on. The processed signal can also be read back
+// through the capture tap, e.g. to send as voice chat, monitored or not.
+class MicrophoneInput {
+public:
+    // deviceConfig is a capture config; its callbacks, format and channels are replaced
+    MicrophoneInput(ma_context* context, ma_device_config deviceConfig, ma_engine* engine,
+        ma_sound_group* group, float targetBufferMs);
+    ~MicrophoneInput();
+
+    bool IsInitialized() const;
+    bool Start();
+    void Stop();
+    std::string GetDeviceName() const;
+
+    void SetMonitoring(bool monitor);
+    bool IsMonitoring() const;
+    void SetVolume(float volume);
+    float GetVolume() const;
+
+    // Processing between the capture and the bus (gate, filters, compressor)
+    EffectChain& GetEffects();
+
+    // Processed capture (after the effects, before the monitor gain) at the engine's
+    // rate and channel count, interleaved. Off by default; while on, up to a second is
+    // buffered for the reader and what doesn't fit is dropped and counted. Returns
+    // the frames read, which may be fewer than asked for.
+    void SetCaptureTap(bool enabled);
+    ma_uint32 ReadProcessed(float* frames, ma_uint32 frameCount);
+    ma_uint32 GetProcessedChannels() const;
+
+    // outputLatency is the playback device's, added to the end-to-end estimate
+    MicrophoneStats GetStats(const AudioDeviceLatency& outputLatency) const;
+
+private:
+    MicrophoneInput(const MicrophoneInput&) = delete;
+    MicrophoneInput& operator=(const MicrophoneInput&) = delete;
+
+    struct SourceBase {
+        ma_data_source_base base;
+        MicrophoneInput* owner;
+    };
+
+    static void CaptureCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+    static ma_result OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+    static ma_result OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex);
+    static ma_result OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+        ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap);
+    static const ma_data_source_vtable SourceVTable;
+
+    // Capture thread
+    void Write(const float* frames, ma_uint32 frameCount);
+
+    // Mixer thread
+    void Read(float* pFramesOut, ma_uint32 frameCount);
+    void Skip(ma_uint32 frameCount);
+
+    ma_device device;
+    ma_pcm_rb ringBuffer;
+    SourceBase source;
+    ma_sound sound;
+    EffectChain effects;
+    std::unique_ptr<MicrophoneMonitorEffect> monitor;
+    bool deviceInitialized;
+    bool bufferInitialized;
+    bool sourceInitialized;
+    bool soundInitialized;
+
+    ma_uint32 sampleRate;
+    ma_uint32 targetFrames;
+    bool primed;                // Mixer thread; false until the buffer first reaches the target
+
+    std::atomic<bool> monitoring;
+    std::atomic<float> volume;
+    std::atomic<ma_uint32> bufferedFrames;     // Published by the reader
+    std::atomic<ma_uint64> overrunFrames;
+    std::atomic<ma_uint64> underrunFrames;
+};
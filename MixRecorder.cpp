@@ -0,0 +1,213 @@
+#include "miniaudio.h"
+#include "MixRecorder.h"
+#include "AudioEngine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+// How often the writer wakes to drain the ring buffer; the tap never signals it
+static const std::chrono::milliseconds g_writerInterval(20);
+
+// Frames converted and encoded per write
+static const ma_uint32 g_writeChunkFrames = 4096;
+
+// ---------------------------------------------------------------------------
+// RecorderTapEffect
+// ---------------------------------------------------------------------------
+
+RecorderTapEffect::RecorderTapEffect(MixRecorder* owner)
+    : recorder(owner)
+    , busy(false)
+{
+    InitNode();
+}
+
+RecorderTapEffect::~RecorderTapEffect() {
+    UninitNode();
+}
+
+void RecorderTapEffect::Detach() {
+    recorder.store(nullptr);
+    WaitIdle();
+}
+
+void RecorderTapEffect::WaitIdle() const {
+    // Sequentially consistent with Process(): either it sees the change made before
+    // this call, or this sees it busy and waits out the block
+    while (busy.load()) {
+        std::this_thread::yield();
+    }
+}
+
+void RecorderTapEffect::Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) {
+    std::memcpy(pFramesOut, ppFramesIn[0], sizeof(float) * frameCount * channels);
+
+    busy.store(true);
+    MixRecorder* owner = recorder.load();
+    if (owner && owner->recording.load()) {
+        owner->Push(pFramesOut, frameCount);
+    }
+    busy.store(false);
+}
+
+// ---------------------------------------------------------------------------
+// MixRecorder
+// ---------------------------------------------------------------------------
+
+MixRecorder::MixRecorder(float bufferSeconds)
+    : initialized(false)
+    , channels(0)
+    , sampleRate(0)
+    , format(RecordingFormat::Pcm16)
+    , recording(false)
+    , framesWritten(0)
+    , framesDropped(0)
+    , writerStop(false)
+{
+    tap = std::make_shared<RecorderTapEffect>(this);
+    if (!tap->IsInitialized()) {
+        return;
+    }
+
+    ma_engine* engine = AudioEngine::Instance().GetEngine();
+    channels = ma_engine_get_channels(engine);
+    sampleRate = ma_engine_get_sample_rate(engine);
+
+    ma_uint32 bufferFrames = static_cast<ma_uint32>(std::max(bufferSeconds, 0.1f) * sampleRate);
+    if (ma_pcm_rb_init(ma_format_f32, channels, bufferFrames, NULL, NULL, &ringBuffer) != MA_SUCCESS) {
+        return;
+    }
+    convertBuffer.resize(static_cast<size_t>(g_writeChunkFrames) * channels);
+    initialized = true;
+}
+
+MixRecorder::~MixRecorder() {
+    Stop();
+    tap->Detach();
+
+    if (initialized) {
+        ma_pcm_rb_uninit(&ringBuffer);
+    }
+}
+
+bool MixRecorder::IsInitialized() const {
+    return initialized;
+}
+
+std::shared_ptr<AudioEffect> MixRecorder::GetTap() {
+    return tap;
+}
+
+bool MixRecorder::Start(const std::string& filePath, RecordingFormat recordingFormat) {
+    if (!initialized || IsRecording()) {
+        return false;
+    }
+
+    format = recordingFormat;
+    ma_format encoderFormat = (format == RecordingFormat::Pcm16) ? ma_format_s16 : ma_format_f32;
+    ma_encoder_config encoderConfig = ma_encoder_config_init(ma_encoding_format_wav, encoderFormat, channels, sampleRate);
+    if (ma_encoder_init_file(filePath.c_str(), &encoderConfig, &encoder) != MA_SUCCESS) {
+        return false;
+    }
+
+    framesWritten = 0;
+    framesDropped = 0;
+    writerStop = false;
+    writer = std::thread(&MixRecorder::WriterLoop, this);
+
+    recording.store(true);
+    return true;
+}
+
+void MixRecorder::Stop() {
+    if (!IsRecording()) {
+        return;
+    }
+
+    // After this no more frames arrive, so the writer's last drain empties the buffer
+    recording.store(false);
+    tap->WaitIdle();
+
+    {
+        std::lock_guard<std::mutex> lock(writerMutex);
+        writerStop = true;
+    }
+    writerCondition.notify_one();
+    writer.join();
+
+    ma_encoder_uninit(&encoder);
+}
+
+bool MixRecorder::IsRecording() const {
+    return writer.joinable();
+}
+
+MixRecorder::Stats MixRecorder::GetStats() const {
+    Stats stats;
+    stats.framesWritten = framesWritten.load(std::memory_order_relaxed);
+    stats.framesDropped = framesDropped.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MixRecorder::Push(const float* frames, ma_uint32 frameCount) {
+    // The free space may wrap around the end of the buffer
+    ma_uint32 offset = 0;
+    for (int part = 0; part < 2 && offset < frameCount; part++) {
+        ma_uint32 count = frameCount - offset;
+        void* pWrite = nullptr;
+        if (ma_pcm_rb_acquire_write(&ringBuffer, &count, &pWrite) != MA_SUCCESS || count == 0) {
+            break;
+        }
+        std::memcpy(pWrite, &frames[static_cast<size_t>(offset) * channels], sizeof(float) * count * channels);
+        ma_pcm_rb_commit_write(&ringBuffer, count);
+        offset += count;
+    }
+
+    if (offset < frameCount) {
+        framesDropped.fetch_add(frameCount - offset, std::memory_order_relaxed);
+    }
+}
+
+void MixRecorder::WriterLoop() {
+    std::unique_lock<std::mutex> lock(writerMutex);
+
+    while (true) {
+        bool stopping = writerCondition.wait_for(lock, g_writerInterval, [this] { return writerStop; });
+
+        lock.unlock();
+        Drain();
+        lock.lock();
+
+        if (stopping) return;
+    }
+}
+
+void MixRecorder::Drain() {
+    while (true) {
+        ma_uint32 count = g_writeChunkFrames;
+        void* pRead = nullptr;
+        if (ma_pcm_rb_acquire_read(&ringBuffer, &count, &pRead) != MA_SUCCESS || count == 0) {
+            return;
+        }
+
+        const void* pFrames = pRead;
+        if (format == RecordingFormat::Pcm16) {
+            ma_pcm_f32_to_s16(convertBuffer.data(), pRead, static_cast<ma_uint64>(count) * channels, ma_dither_mode_none);
+            pFrames = convertBuffer.data();
+        }
+
+        ma_uint64 written = 0;
+        ma_encoder_write_pcm_frames(&encoder, pFrames, count, &written);
+        ma_pcm_rb_commit_read(&ringBuffer, count);
+        framesWritten.fetch_add(written, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEffect.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MixRecorder;
+
+// Pass-through effect that copies its bus into a MixRecorder's ring buffer. Put it
+// at the end of a bus's chain to record what the bus sends on. A chain may keep the
+// tap after its recorder is gone; it then just passes audio through.
+class RecorderTapEffect : public AudioEffect {
+public:
+    explicit RecorderTapEffect(MixRecorder* recorder);
+    ~RecorderTapEffect() override;
+
+    // Game thread. Waits for a block already being copied, so once these return
+    // the recorder is no longer touched (Detach) or fed the old state (WaitIdle).
+    void Detach();
+    void WaitIdle() const;
+
+protected:
+    void Process(const float** ppFramesIn, float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    std::atomic<MixRecorder*> recorder;
+    std::atomic<bool> busy;
+};
+
+enum class RecordingFormat {
+    Pcm16,      // 16-bit WAV
+    Float32     // 32-bit float WAV
+};
+
+// Records a bus to a WAV file without touching the audio thread's timing. The tap
+// copies each block into a lock-free ring buffer and a background thread drains it
+// into the encoder; if the writer falls behind, the frames that don't fit are
+// dropped and counted rather than waited for.
+//
+// AudioEngine::StartRecording() records the master bus. For any other bus, add
+// GetTap() to its effect chain and call Start().
+class MixRecorder {
+public:
+    struct Stats {
+        ma_uint64 framesWritten = 0;
+        ma_uint64 framesDropped = 0;    // Lost because the ring buffer was full
+    };
+
+    // The ring buffer holds bufferSeconds of audio at the engine's format
+    explicit MixRecorder(float bufferSeconds = 2.0f);
+    ~MixRecorder();
+
+    bool IsInitialized() const;
+    std::shared_ptr<AudioEffect> GetTap();
+
+    // Game thread. Stop() writes out what is buffered and closes the file.
+    bool Start(const std::string& filePath, RecordingFormat format = RecordingFormat::Pcm16);
+    void Stop();
+    bool IsRecording() const;
+
+    // Counts of the current recording, or of the last one once stopped
+    Stats GetStats() const;
+
+private:
+    MixRecorder(const MixRecorder&) = delete;
+    MixRecorder& operator=(const MixRecorder&) = delete;
+
+    friend class RecorderTapEffect;
+
+    // Audio thread
+    void Push(const float* frames, ma_uint32 frameCount);
+
+    void WriterLoop();
+    void Drain();
+
+    std::shared_ptr<RecorderTapEffect> tap;
+    ma_pcm_rb ringBuffer;
+    bool initialized;
+    ma_uint32 channels;
+    ma_uint32 sampleRate;
+
+    ma_encoder encoder;
+    RecordingFormat format;
+    std::vector<ma_int16> convertBuffer;
+
+    // The tap only pushes while this is set; Stop() clears it, then waits out the tap
+    std::atomic<bool> recording;
+
+    std::atomic<ma_uint64> framesWritten;
+    std::atomic<ma_uint64> framesDropped;
+
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerCondition;
+    bool writerStop;
+};
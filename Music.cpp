@@ -1,11 +1,15 @@
 #include "miniaudio.h"
 #include "Music.h"
 #include "AudioEngine.h"
+#include "Resampler.h"
 
-Music::Music(const std::string& filePath)
+Music::Music(const std::string& filePath, LoadPolicy policy)
     : filePath(filePath)
+    , loadPolicy(policy)
     , loaded(false)
     , volume(1.0f)
+    , loudness(0.0f)
+    , hasLoudness(false)
     , category(AudioCategory::MUSIC)
     , playing(false)
     , paused(false)
@@ -18,20 +22,57 @@ Music::Music(const std::string& filePath)
 {
     engine = AudioEngine::Instance().GetEngine();
 
-    // Initialize the music - use MA_SOUND_FLAG_STREAM for efficient streaming
-    ma_result result = ma_sound_init_from_file(engine, filePath.c_str(), MA_SOUND_FLAG_STREAM, NULL, NULL, &sound);
+    if (loadPolicy == LoadPolicy::Auto) {
+        loadPolicy = AudioEngine::Instance().ChooseLoadPolicy(filePath);
+    }
+
+    // Initialize the music - streaming by default, so long tracks cost almost no memory
+    ma_uint32 flags = MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_STREAM;
+    if (loadPolicy == LoadPolicy::Decode) {
+        flags = MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_DECODE;
+    }
+    else if (loadPolicy == LoadPolicy::CompressedInMemory) {
+        flags = 0;
+    }
+    fileSource = std::make_unique<ma_resource_manager_data_source>();
+    if (ma_resource_manager_data_source_init(ma_engine_get_resource_manager(engine), filePath.c_str(), flags, NULL, fileSource.get()) != MA_SUCCESS) {
+        fileSource.reset();
+        return;
+    }
+
+    // Read through the resampler like sounds, so pitch follows the category's resampler quality
+    ma_result result;
+    resampler = std::make_unique<ResamplingSource>(fileSource.get(), ma_engine_get_sample_rate(engine));
+    if (resampler->IsInitialized()) {
+        result = ma_sound_init_from_data_source(engine, resampler->GetDataSource(), MA_SOUND_FLAG_NO_PITCH,
+            AudioEngine::Instance().GetCategoryGroup(category), &sound);
+    }
+    else {
+        resampler.reset();
+        result = ma_sound_init_from_data_source(engine, fileSource.get(), 0,
+            AudioEngine::Instance().GetCategoryGroup(category), &sound);
+    }
     loaded = (result == MA_SUCCESS);
 
     if (loaded) {
+        UpdateResampler();
+
         // Register with the audio engine
         AudioEngine::Instance().RegisterMusic(this);
     }
+    else {
+        resampler.reset();
+        ma_resource_manager_data_source_uninit(fileSource.get());
+        fileSource.reset();
+    }
 }
 
 Music::~Music() {
     if (loaded) {
         Stop(); // Ensure the music is stopped
         ma_sound_uninit(&sound);
+        resampler.reset();
+        ma_resource_manager_data_source_uninit(fileSource.get());
         AudioEngine::Instance().UnregisterMusic(this);
     }
 }
@@ -86,13 +127,18 @@ void Music::SetPitch(float pitch) {
 
     // Clamp pitch to reasonable values
     pitch = std::max(0.5f, std::min(pitch, 2.0f));
-    ma_sound_set_pitch(&sound, pitch);
+    if (resampler) {
+        resampler->SetPitch(pitch);
+    }
+    else {
+        ma_sound_set_pitch(&sound, pitch);
+    }
 }
 
 float Music::GetPitch() const {
     if (!loaded) return 1.0f;
 
-    return ma_sound_get_pitch(&sound);
+    return resampler ? resampler->GetPitch() : ma_sound_get_pitch(&sound);
 }
 
 void Music::SetPan(float pan) {
@@ -133,7 +179,7 @@ void Music::FadeIn(float durationInSeconds) {
     fadeDuration = durationInSeconds;
     fadeTimer = 0.0f;
     fadeStartVolume = 0.0f;
-    fadeTargetVolume = volume;
+    fadeTargetVolume = hasLoudness ? volume * AudioEngine::Instance().GetLoudnessGain(loudness) : volume;
 
     // Start with zero volume
     float effectiveVolume = 0.0f;
@@ -193,6 +239,10 @@ bool Music::IsFading() const {
     return fadeState != FadeState::None;
 }
 
+LoadPolicy Music::GetLoadPolicy() const {
+    return loadPolicy;
+}
+
 float Music::GetDuration() const {
     if (!loaded) return 0.0f;
 
@@ -225,18 +275,47 @@ void Music::SetPlaybackPosition(float positionInSeconds) {
 
 void Music::SetCategory(AudioCategory cat) {
     category = cat;
+
+    // Route the output into the category's bus
+    if (loaded) {
+        ma_sound_group* group = AudioEngine::Instance().GetCategoryGroup(category);
+        if (group) {
+            ma_node_attach_output_bus(&sound, 0, group, 0);
+        }
+    }
+
     UpdateVolume();
+    UpdateResampler();
 }
 
 AudioCategory Music::GetCategory() const {
     return category;
 }
 
+void Music::SetLoudness(float lufs) {
+    loudness = lufs;
+    hasLoudness = true;
+    UpdateVolume();
+}
+
+float Music::GetLoudness() const {
+    return loudness;
+}
+
+bool Music::HasLoudness() const {
+    return hasLoudness;
+}
+
 void Music::UpdateVolume() {
     if (!loaded) return;
 
     float effectiveVolume = volume;
 
+    // Apply loudness normalization
+    if (hasLoudness) {
+        effectiveVolume *= AudioEngine::Instance().GetLoudnessGain(loudness);
+    }
+
     // Apply category volume
     effectiveVolume *= AudioEngine::Instance().GetCategoryVolume(category);
 
@@ -255,6 +334,12 @@ void Music::UpdateVolume() {
     }
 }
 
+void Music::UpdateResampler() {
+    if (!resampler) return;
+
+    resampler->SetQuality(AudioEngine::Instance().GetCategoryResamplerQuality(category));
+}
+
 void Music::SetFinishedCallback(std::function<void()> callback) {
     finishedCallback = callback;
 }
@@ -4,6 +4,9 @@
 #include <algorithm>
 #include <string>
 #include <functional>
+#include <memory>
+
+class ResamplingSource;
 
 // On Windows, prevent macros from colliding
 #ifdef max
@@ -16,7 +19,7 @@
 // Music class for streaming background music
 class Music {
 public:
-    Music(const std::string& filePath);
+    Music(const std::string& filePath, LoadPolicy policy = LoadPolicy::Stream);
     virtual ~Music();
 
     // Basic operations
@@ -49,6 +52,9 @@ public:
     bool IsLoaded() const;
     bool IsFading() const;
 
+    // How the audio data is held; never Auto once loaded
+    LoadPolicy GetLoadPolicy() const;
+
     // Get the duration of the music in seconds
     float GetDuration() const;
 
@@ -62,9 +68,17 @@ public:
     void SetCategory(AudioCategory category);
     AudioCategory GetCategory() const;
 
+    // Measured integrated loudness in LUFS, used by loudness normalization
+    void SetLoudness(float lufs);
+    float GetLoudness() const;
+    bool HasLoudness() const;
+
     // Called when the audio engine changes volumes
     void UpdateVolume();
 
+    // Called when the audio engine changes resampler settings
+    void UpdateResampler();
+
     // Set a callback to be called when the music finishes playing
     void SetFinishedCallback(std::function<void()> callback);
 
@@ -75,10 +89,15 @@ private:
     friend class AudioEngine;
 
     ma_sound sound;
+    std::unique_ptr<ma_resource_manager_data_source> fileSource;
+    std::unique_ptr<ResamplingSource> resampler;       // Reads fileSource
     ma_engine* engine;
     std::string filePath;
+    LoadPolicy loadPolicy;
     bool loaded;
     float volume;
+    float loudness;
+    bool hasLoudness;
     AudioCategory category;
     std::function<void()> finishedCallback;
 
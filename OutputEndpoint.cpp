@@ -0,0 +1,110 @@
+#include "miniaudio.h"
+#include "OutputEndpoint.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_uint32 OutputEndpoint::ChunkFrames;
+
+OutputEndpoint::OutputEndpoint(ma_context* context, ma_device_config deviceConfig)
+    : initialized(false)
+    , channels(deviceConfig.playback.channels)
+    , graphLock(0)
+    , volume(1.0f)
+{
+    deviceConfig.dataCallback = &OutputEndpoint::DataCallback;
+    deviceConfig.notificationCallback = NULL;
+    deviceConfig.pUserData = this;
+    deviceConfig.noPreSilencedOutputBuffer = MA_TRUE;  // Every frame is written
+
+    if (ma_device_init(context, &deviceConfig, &device) != MA_SUCCESS) {
+        return;
+    }
+    channels = device.playback.channels;
+    scratch.assign(static_cast<size_t>(ChunkFrames) * channels, 0.0f);
+    initialized = true;
+}
+
+OutputEndpoint::~OutputEndpoint() {
+    // Waits for the last callback, so no graph is read past this point
+    if (initialized) {
+        ma_device_uninit(&device);
+    }
+}
+
+bool OutputEndpoint::IsInitialized() const {
+    return initialized;
+}
+
+bool OutputEndpoint::Start() {
+    return initialized && ma_device_start(&device) == MA_SUCCESS;
+}
+
+std::string OutputEndpoint::GetDeviceName() const {
+    return initialized ? device.playback.name : std::string();
+}
+
+void OutputEndpoint::AddGraph(ma_node_graph* graph) {
+    if (!graph || std::find(graphs.begin(), graphs.end(), graph) != graphs.end()) {
+        return;
+    }
+
+    std::vector<ma_node_graph*> next = graphs;
+    next.push_back(graph);
+    SwapGraphs(next);
+}
+
+void OutputEndpoint::RemoveGraph(ma_node_graph* graph) {
+    std::vector<ma_node_graph*> next = graphs;
+    next.erase(std::remove(next.begin(), next.end(), graph), next.end());
+    SwapGraphs(next);
+}
+
+void OutputEndpoint::SwapGraphs(std::vector<ma_node_graph*>& next) {
+    // Built outside the lock so the audio thread never waits on an allocation;
+    // the old list is freed by the caller's copy
+    ma_spinlock_lock(&graphLock);
+    graphs.swap(next);
+    ma_spinlock_unlock(&graphLock);
+}
+
+void OutputEndpoint::SetVolume(float value) {
+    volume.store(std::max(0.0f, std::min(value, 1.0f)), std::memory_order_relaxed);
+}
+
+float OutputEndpoint::GetVolume() const {
+    return volume.load(std::memory_order_relaxed);
+}
+
+void OutputEndpoint::DataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount) {
+    (void)pInput;
+
+    OutputEndpoint* self = static_cast<OutputEndpoint*>(pDevice->pUserData);
+    self->Process(static_cast<float*>(pOutput), frameCount);
+}
+
+void OutputEndpoint::Process(float* pFramesOut, ma_uint32 frameCount) {
+    ma_silence_pcm_frames(pFramesOut, frameCount, ma_format_f32, channels);
+    const float gain = volume.load(std::memory_order_relaxed);
+
+    ma_spinlock_lock(&graphLock);
+    for (ma_uint32 offset = 0; offset < frameCount; offset += ChunkFrames) {
+        const ma_uint32 count = std::min(ChunkFrames, frameCount - offset);
+        float* pOut = &pFramesOut[static_cast<size_t>(offset) * channels];
+
+        for (ma_node_graph* graph : graphs) {
+            ma_uint64 framesRead = 0;
+            ma_node_graph_read_pcm_frames(graph, scratch.data(), count, &framesRead);
+            AudioSIMD::MultiplyAdd(pOut, scratch.data(), gain, static_cast<size_t>(framesRead) * channels);
+        }
+    }
+    ma_spinlock_unlock(&graphLock);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// A second output device (e.g. a headset for voice chat next to the speakers) that
+// mixes isolated bus subgraphs (see AudioBus::SetIsolated) on its own audio thread.
+// The sounds in those buses stay in the engine's node graph, so they share its
+// resource manager and PCM cache; the endpoint only adds the mixing of what is
+// routed to it. Its device runs at the engine's rate and channel count and converts
+// to the hardware format itself.
+//
+// A graph must only be read from one thread at a time: take it away from whatever
+// else reads it (the parallel mixer, another endpoint) before adding it here.
+class OutputEndpoint {
+public:
+    // Opens the device from deviceConfig, replacing its callbacks; Start() to play
+    OutputEndpoint(ma_context* context, ma_device_config deviceConfig);
+    ~OutputEndpoint();
+
+    bool IsInitialized() const;
+    bool Start();
+    std::string GetDeviceName() const;
+
+    // Graphs this endpoint mixes. Both wait for a callback already mixing, so once
+    // RemoveGraph returns the graph is no longer being read.
+    void AddGraph(ma_node_graph* graph);
+    void RemoveGraph(ma_node_graph* graph);
+
+    // Applied after mixing; the engine's master volume does not reach endpoints
+    void SetVolume(float volume);
+    float GetVolume() const;
+
+private:
+    OutputEndpoint(const OutputEndpoint&) = delete;
+    OutputEndpoint& operator=(const OutputEndpoint&) = delete;
+
+    static const ma_uint32 ChunkFrames = 512;
+
+    static void DataCallback(ma_device* pDevice, void* pOutput, const void* pInput, ma_uint32 frameCount);
+    void Process(float* pFramesOut, ma_uint32 frameCount);
+    void SwapGraphs(std::vector<ma_node_graph*>& graphs);
+
+    ma_device device;
+    bool initialized;
+    ma_uint32 channels;
+
+    ma_spinlock graphLock;      // Held by the callback while mixing; guards swapping the list
+    std::vector<ma_node_graph*> graphs;
+    std::vector<float> scratch;
+    std::atomic<float> volume;
+};
@@ -0,0 +1,352 @@
+#include "miniaudio.h"
+#include "ParallelMixer.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+#include <chrono>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_uint32 ParallelMixer::ChunkFrames;
+
+// How long the callback thread waits for jobs still on workers once it has run out
+// of jobs to claim, as a fraction of the chunk's duration
+static const float g_joinDeadline = 0.25f;
+
+// Chunks mixed without waking workers after one misses the deadline
+static const ma_uint32 g_inlineFallbackChunks = 64;
+
+static const ma_uint32 g_ticketMask = 0xFFFFF;
+
+const ma_node_vtable ParallelMixer::NodeVTable = {
+    &ParallelMixer::ProcessNode,
+    NULL,   // onGetRequiredInputFrameCount
+    0,      // No input buses; the subgraphs are read directly
+    1,
+    0
+};
+
+static ma_uint64 PackDispatch(ma_uint32 ticket, ma_uint32 frameCount, ma_uint32 jobCount) {
+    return (static_cast<ma_uint64>(ticket & g_ticketMask) << 44)
+        | (static_cast<ma_uint64>(frameCount & 0xFFF) << 32)
+        | (static_cast<ma_uint64>(jobCount & 0xFFFF) << 16);
+}
+
+ParallelMixer::ParallelMixer(ma_engine* engine, ma_uint32 workerCount, const std::vector<std::vector<ma_node_graph*>>& groups)
+    : initialized(false)
+    , channels(ma_engine_get_channels(engine))
+    , sampleRate(ma_engine_get_sample_rate(engine))
+    , pendingJobs(nullptr)
+    , retiredJobs(nullptr)
+    , currentJobs(nullptr)
+    , dispatchedJobs(nullptr)
+    , dispatch(0)
+    , claimers(0)
+    , ticket(0)
+    , inlineChunks(0)
+    , lateJobs(0)
+    , wakePermits(0)
+    , stopping(false)
+{
+    ma_node_config nodeConfig = ma_node_config_init();
+    nodeConfig.vtable = &NodeVTable;
+    nodeConfig.inputBusCount = 0;
+    nodeConfig.outputBusCount = 1;
+    nodeConfig.pOutputChannels = &channels;
+
+    // Not attached yet, so no handover needed
+    currentJobs = CreateJobList(groups);
+
+    node.mixer = this;
+    if (ma_node_init(ma_engine_get_node_graph(engine), &nodeConfig, NULL, &node) != MA_SUCCESS) {
+        return;
+    }
+    initialized = true;
+
+    for (ma_uint32 i = 0; i < workerCount; i++) {
+        workers.emplace_back(&ParallelMixer::WorkerLoop, this);
+    }
+}
+
+ParallelMixer::~ParallelMixer() {
+    // Blocks until the audio thread is no longer processing the node, so no job is in flight
+    if (initialized) {
+        ma_node_uninit(&node, NULL);
+        initialized = false;
+    }
+
+    stopping.store(true);
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakeCondition.notify_all();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    delete currentJobs;
+    delete pendingJobs.exchange(nullptr);
+    delete retiredJobs.exchange(nullptr);
+}
+
+bool ParallelMixer::IsInitialized() const {
+    return initialized;
+}
+
+ma_node* ParallelMixer::GetNode() {
+    return initialized ? &node : nullptr;
+}
+
+ma_uint32 ParallelMixer::GetWorkerCount() const {
+    return static_cast<ma_uint32>(workers.size());
+}
+
+ma_uint64 ParallelMixer::GetLateJobCount() const {
+    return lateJobs.load(std::memory_order_relaxed);
+}
+
+void ParallelMixer::SetGroups(const std::vector<std::vector<ma_node_graph*>>& groups) {
+    std::lock_guard<std::mutex> lock(groupsMutex);
+
+    JobList* list = CreateJobList(groups);
+
+    // The audio thread only adopts a new list once the previous one has been
+    // collected; a list it never picked up is simply replaced
+    DeleteRetiredJobs();
+    delete pendingJobs.exchange(list);
+}
+
+bool ParallelMixer::CompleteHandover() {
+    std::lock_guard<std::mutex> lock(groupsMutex);
+
+    DeleteRetiredJobs();
+    return pendingJobs.load() == nullptr;
+}
+
+ParallelMixer::JobList* ParallelMixer::CreateJobList(const std::vector<std::vector<ma_node_graph*>>& groups) const {
+    size_t jobCount = 0;
+    for (const auto& group : groups) {
+        if (!group.empty()) jobCount++;
+    }
+
+    // Sized once; jobs hold atomics, so they can't be moved
+    JobList* list = new JobList();
+    list->jobs = std::vector<Job>(jobCount);
+
+    size_t index = 0;
+    for (const auto& group : groups) {
+        if (group.empty()) continue;
+
+        Job& job = list->jobs[index++];
+        job.graphs = group;
+        job.buffer.assign(static_cast<size_t>(ChunkFrames) * channels, 0.0f);
+        if (group.size() > 1) {
+            job.scratch.assign(static_cast<size_t>(ChunkFrames) * channels, 0.0f);
+        }
+    }
+    return list;
+}
+
+void ParallelMixer::DeleteRetiredJobs() {
+    delete retiredJobs.exchange(nullptr);
+}
+
+bool ParallelMixer::HasUnreadJobs(const JobList& list) {
+    for (const Job& job : list.jobs) {
+        if (job.unread.load(std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ParallelMixer::ProcessNode(ma_node* pNode, const float** ppFramesIn, ma_uint32* pFrameCountIn,
+    float** ppFramesOut, ma_uint32* pFrameCountOut) {
+    (void)ppFramesIn;
+    (void)pFrameCountIn;
+
+    MixerNode* mixerNode = static_cast<MixerNode*>(pNode);
+    mixerNode->mixer->Process(ppFramesOut[0], *pFrameCountOut);
+}
+
+void ParallelMixer::Process(float* pFramesOut, ma_uint32 frameCount) {
+    // A worker that missed a deadline may still be reading the current list, and
+    // a late job's mix is played before its list goes
+    if (retiredJobs.load(std::memory_order_acquire) == nullptr && claimers.load() == 0 &&
+        (!currentJobs || !HasUnreadJobs(*currentJobs))) {
+        JobList* next = pendingJobs.exchange(nullptr, std::memory_order_acq_rel);
+        if (next) {
+            // Freeing is left to the game thread
+            retiredJobs.store(currentJobs, std::memory_order_release);
+            currentJobs = next;
+        }
+    }
+
+    JobList* list = currentJobs;
+    if (!list || list->jobs.empty()) {
+        ma_silence_pcm_frames(pFramesOut, frameCount, ma_format_f32, channels);
+        return;
+    }
+
+    const ma_uint32 jobCount = static_cast<ma_uint32>(list->jobs.size());
+
+    for (ma_uint32 offset = 0; offset < frameCount; offset += ChunkFrames) {
+        const ma_uint32 count = std::min(ChunkFrames, frameCount - offset);
+        const auto deadline = std::chrono::steady_clock::now() +
+            std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<float>(g_joinDeadline * count / sampleRate));
+
+        ticket = (ticket + 1) & g_ticketMask;
+        if (ticket == 0) ticket = 1;
+        dispatchedJobs = list;
+        dispatch.store(PackDispatch(ticket, count, jobCount));
+
+        if (!workers.empty() && jobCount > 1 && inlineChunks == 0) {
+            WakeWorkers(std::min(static_cast<ma_uint32>(workers.size()), jobCount - 1));
+        }
+        else if (inlineChunks > 0) {
+            inlineChunks--;
+        }
+
+        // The callback thread claims jobs until none are left, so the block finishes
+        // even if no worker wakes. Whatever is still on a worker is waited for, but
+        // never past the deadline.
+        ClaimJobs();
+        for (;;) {
+            bool done = true;
+            for (const Job& job : list->jobs) {
+                if (job.doneTicket.load(std::memory_order_acquire) != ticket &&
+                    job.skippedTicket.load(std::memory_order_acquire) != ticket) {
+                    done = false;
+                    break;
+                }
+            }
+            if (done || std::chrono::steady_clock::now() >= deadline) break;
+            std::this_thread::yield();
+        }
+
+        // Claims from here on miss, so a worker waking late can't start on this chunk
+        dispatch.store(PackDispatch(ticket, 0, 0));
+
+        float* pOut = &pFramesOut[static_cast<size_t>(offset) * channels];
+        ma_silence_pcm_frames(pOut, count, ma_format_f32, channels);
+
+        // Whatever a job has finished is played, on time or not: a mix that missed
+        // an earlier chunk goes into this one, so its graphs lag instead of dropping
+        ma_uint32 late = 0;
+        for (Job& job : list->jobs) {
+            if (job.doneTicket.load(std::memory_order_acquire) != ticket &&
+                job.skippedTicket.load(std::memory_order_acquire) != ticket) {
+                late++;
+            }
+            if (!job.unread.load(std::memory_order_acquire)) {
+                continue;
+            }
+
+            const ma_uint32 frames = std::min(job.frameCount - job.readOffset, count);
+            AudioSIMD::MultiplyAdd(pOut, &job.buffer[static_cast<size_t>(job.readOffset) * channels],
+                1.0f, static_cast<size_t>(frames) * channels);
+            job.readOffset += frames;
+            if (job.readOffset == job.frameCount) {
+                job.readOffset = 0;
+                job.unread.store(false, std::memory_order_release);
+            }
+        }
+
+        // Still rendering; stop relying on workers until the late one catches up
+        if (late > 0) {
+            lateJobs.fetch_add(late, std::memory_order_relaxed);
+            inlineChunks = g_inlineFallbackChunks;
+        }
+    }
+}
+
+void ParallelMixer::ClaimJobs() {
+    claimers.fetch_add(1);
+
+    for (;;) {
+        ma_uint64 claim = dispatch.fetch_add(1);
+        ma_uint32 claimTicket = static_cast<ma_uint32>(claim >> 44);
+        ma_uint32 frameCount = static_cast<ma_uint32>((claim >> 32) & 0xFFF);
+        ma_uint32 jobCount = static_cast<ma_uint32>((claim >> 16) & 0xFFFF);
+        ma_uint32 index = static_cast<ma_uint32>(claim & 0xFFFF);
+        if (index >= jobCount) {
+            break;
+        }
+
+        // Still being read by a worker that missed an earlier deadline (a graph can
+        // only be read by one thread at a time), or holding a late mix not played yet:
+        // this chunk plays that mix instead of a new one
+        Job& job = dispatchedJobs->jobs[index];
+        if (job.running.exchange(true, std::memory_order_acquire)) {
+            job.skippedTicket.store(claimTicket, std::memory_order_release);
+            continue;
+        }
+        if (job.unread.load(std::memory_order_acquire)) {
+            job.running.store(false, std::memory_order_release);
+            job.skippedTicket.store(claimTicket, std::memory_order_release);
+            continue;
+        }
+
+        RunJob(job, frameCount);
+        job.frameCount = frameCount;
+        job.unread.store(true, std::memory_order_release);
+        job.doneTicket.store(claimTicket, std::memory_order_release);
+        job.running.store(false, std::memory_order_release);
+    }
+
+    claimers.fetch_sub(1);
+}
+
+void ParallelMixer::RunJob(Job& job, ma_uint32 frameCount) {
+    const size_t sampleCount = static_cast<size_t>(frameCount) * channels;
+
+    for (size_t g = 0; g < job.graphs.size(); g++) {
+        float* pTarget = (g == 0) ? job.buffer.data() : job.scratch.data();
+
+        ma_uint64 framesRead = 0;
+        ma_node_graph_read_pcm_frames(job.graphs[g], pTarget, frameCount, &framesRead);
+        if (framesRead < frameCount) {
+            ma_silence_pcm_frames(&pTarget[framesRead * channels], frameCount - framesRead, ma_format_f32, channels);
+        }
+
+        if (g > 0) {
+            AudioSIMD::MultiplyAdd(job.buffer.data(), pTarget, 1.0f, sampleCount);
+        }
+    }
+}
+
+void ParallelMixer::WakeWorkers(ma_uint32 count) {
+    // Never blocks the audio thread
+    if (!wakeMutex.try_lock()) {
+        return;
+    }
+    wakePermits += count;
+    wakeMutex.unlock();
+
+    for (ma_uint32 i = 0; i < count; i++) {
+        wakeCondition.notify_one();
+    }
+}
+
+void ParallelMixer::WorkerLoop() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wakeCondition.wait(lock, [&]() { return stopping.load() || wakePermits > 0; });
+            if (stopping.load()) {
+                return;
+            }
+            wakePermits--;
+        }
+
+        // A wake-up for a chunk the callback thread already finished just misses
+        ClaimJobs();
+    }
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Source node that mixes several independent node graphs (isolated bus subgraphs)
+// on multiple cores. Each audio block is split into jobs, one per group of graphs;
+// worker threads and the audio callback thread claim jobs with a single atomic
+// fetch-add, so the callback thread keeps mixing until every job is taken. It then
+// waits for the jobs still on workers, but only until a deadline well inside the
+// block: a job that misses it is played from the next block on instead (its graphs
+// fall a block behind rather than losing audio), and the next blocks are mixed on
+// the callback thread alone while the late worker catches up. Nothing on the audio
+// path allocates, and idle workers sleep until woken.
+//
+// A graph must only be read from one thread at a time, so graphs that share nodes
+// (e.g. a sidechain send and its ducker) have to be in the same group.
+class ParallelMixer {
+public:
+    // workerCount threads run alongside the audio callback thread. Attach the node
+    // to the graph after construction; the initial groups are live immediately.
+    ParallelMixer(ma_engine* engine, ma_uint32 workerCount, const std::vector<std::vector<ma_node_graph*>>& groups);
+    ~ParallelMixer();
+
+    bool IsInitialized() const;
+    ma_node* GetNode();
+    ma_uint32 GetWorkerCount() const;
+
+    // Jobs that missed their block's deadline and were played a block late
+    ma_uint64 GetLateJobCount() const;
+
+    // Replaces the job list without waiting; the audio thread picks it up at the
+    // start of a later block. Until CompleteHandover() returns true the old groups
+    // may still be read, so graphs they split must not be wired together yet.
+    void SetGroups(const std::vector<std::vector<ma_node_graph*>>& groups);
+
+    // Frees lists the audio thread is done with, and returns whether it has picked
+    // up the last SetGroups() list. Call it from the thread that calls SetGroups().
+    bool CompleteHandover();
+
+private:
+    ParallelMixer(const ParallelMixer&) = delete;
+    ParallelMixer& operator=(const ParallelMixer&) = delete;
+
+    static const ma_uint32 ChunkFrames = 512;
+
+    struct Job {
+        std::vector<ma_node_graph*> graphs;
+        std::vector<float> buffer;
+        std::vector<float> scratch;
+        std::atomic<bool> running{ false };         // A thread is reading the graphs
+        std::atomic<bool> unread{ false };          // buffer holds a mix not played yet
+        std::atomic<ma_uint32> doneTicket{ 0 };     // Block whose mix is in buffer
+        std::atomic<ma_uint32> skippedTicket{ 0 };  // Block that found the job busy or unread
+        ma_uint32 frameCount = 0;                   // Frames in buffer, published by unread
+        ma_uint32 readOffset = 0;                   // Audio thread; frames of buffer played
+    };
+
+    struct JobList {
+        std::vector<Job> jobs;
+    };
+
+    struct MixerNode {
+        ma_node_base base;
+        ParallelMixer* mixer;
+    };
+
+    static void ProcessNode(ma_node* pNode, const float** ppFramesIn, ma_uint32* pFrameCountIn,
+        float** ppFramesOut, ma_uint32* pFrameCountOut);
+    static const ma_node_vtable NodeVTable;
+
+    void Process(float* pFramesOut, ma_uint32 frameCount);
+    void RunJob(Job& job, ma_uint32 frameCount);
+    void ClaimJobs();
+    void WakeWorkers(ma_uint32 count);
+    void WorkerLoop();
+    JobList* CreateJobList(const std::vector<std::vector<ma_node_graph*>>& groups) const;
+    void DeleteRetiredJobs();
+    static bool HasUnreadJobs(const JobList& list);
+
+    MixerNode node;
+    bool initialized;
+    ma_uint32 channels;
+    ma_uint32 sampleRate;
+
+    // Handed from the game thread to the audio thread and back; a retired list is
+    // freed by the next SetGroups() or CompleteHandover()
+    std::atomic<JobList*> pendingJobs;
+    std::atomic<JobList*> retiredJobs;
+    JobList* currentJobs;   // Audio thread only
+
+    // Published by the audio thread before dispatch is stored
+    JobList* dispatchedJobs;
+
+    // Ticket (high 20 bits), chunk frames (next 12), job count (next 16) and next job
+    // index (low 16). Claiming a job is one fetch-add; a claim whose index is past the
+    // count is a miss. The frame count travels in the claim because a late worker may
+    // read it after the audio thread has moved on to the next chunk.
+    std::atomic<ma_uint64> dispatch;
+    std::atomic<ma_uint32> claimers;    // Threads inside ClaimJobs(); the list can't change while any are
+    ma_uint32 ticket;
+    ma_uint32 inlineChunks;     // Audio thread; chunks left to mix without workers after a miss
+    std::atomic<ma_uint64> lateJobs;
+
+    // Counting semaphore the workers park on. The audio thread only ever try-locks
+    // it; a wake-up lost to contention costs that chunk its parallelism, nothing more.
+    std::vector<std::thread> workers;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;
+    ma_uint32 wakePermits;
+    std::atomic<bool> stopping;
+    std::mutex groupsMutex;
+};
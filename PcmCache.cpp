@@ -0,0 +1,438 @@
+#include "miniaudio.h"
+#include "PcmCache.h"
+#include "AssetImporter.h"
+
+#include <algorithm>
+#include <thread>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+static const ma_uint32 g_decodeFlags = MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_DECODE;
+static const ma_uint32 g_streamFlags = MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_STREAM;
+
+// ---------------------------------------------------------------------------
+// PcmCache
+// ---------------------------------------------------------------------------
+
+PcmCache::PcmCache()
+    : resourceManager(nullptr)
+    , importSampleRate(0)
+    , budget(0)
+    , usage(0)
+    , useCounter(0)
+{
+}
+
+PcmCache::~PcmCache() {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    for (auto& pair : assets) {
+        EvictLocked(*pair.second);
+    }
+}
+
+void PcmCache::SetResourceManager(ma_resource_manager* manager, ma_uint32 sampleRate, const std::string& directory) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (manager == resourceManager && sampleRate == importSampleRate && directory == importDirectory) return;
+
+    // Cached data and open streams belong to the old resource manager; sounds still
+    // playing from them end
+    for (auto& pair : assets) {
+        for (CachedSoundSource* source : pair.second->sources) {
+            source->DetachBacking();
+        }
+        EvictLocked(*pair.second);
+    }
+    resourceManager = manager;
+    importSampleRate = sampleRate;
+    importDirectory = directory;
+}
+
+void PcmCache::SetBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    budget = bytes;
+    if (usage > budget) {
+        EvictIdleLocked(usage - budget, nullptr);
+    }
+}
+
+size_t PcmCache::GetBudget() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return budget;
+}
+
+size_t PcmCache::GetUsage() const {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    return usage;
+}
+
+PcmCache::Asset* PcmCache::Register(CachedSoundSource* source, const std::string& filePath) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    std::unique_ptr<Asset>& slot = assets[filePath];
+    if (!slot) {
+        slot.reset(new Asset());
+        slot->filePath = filePath;
+    }
+
+    Asset* asset = slot.get();
+    asset->sources.push_back(source);
+    asset->lastUsed = ++useCounter;
+    if (!asset->resident) {
+        AdmitLocked(*asset);
+    }
+    return asset;
+}
+
+void PcmCache::Unregister(CachedSoundSource* source, Asset* asset) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto it = std::find(asset->sources.begin(), asset->sources.end(), source);
+    if (it != asset->sources.end()) {
+        asset->sources.erase(it);
+    }
+
+    // Stays cached for the next load of the same file until the space is needed
+}
+
+void PcmCache::Pin(Asset* asset) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    asset->pinCount++;
+    asset->lastUsed = ++useCounter;
+    if (!asset->resident) {
+        AdmitLocked(*asset);
+    }
+}
+
+bool PcmCache::Unpin(Asset* asset) {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    if (asset->pinCount > 0) {
+        asset->pinCount--;
+    }
+    return asset->resident;
+}
+
+bool PcmCache::AdmitLocked(Asset& asset) {
+    if (!resourceManager || budget == 0) {
+        return false;
+    }
+
+    // Size is known after the first decode; make room up front so peak usage stays in budget
+    if (asset.bytes > 0) {
+        if (asset.bytes > budget) return false;
+        if (usage + asset.bytes > budget && !EvictIdleLocked(usage + asset.bytes - budget, &asset)) {
+            return false;
+        }
+    }
+
+    // A current import is read straight into memory and handed over under its own
+    // name, so nothing else loading the source file can end up sharing our buffer
+    const std::string importedPath = AssetImporter::GetImportedPath(importDirectory, asset.filePath);
+    const char* name = asset.filePath.c_str();
+    ma_uint32 importedChannels = 0;
+    if (importSampleRate > 0 && AssetImporter::LoadImported(importDirectory, asset.filePath, importSampleRate, asset.importedFrames, importedChannels)) {
+        if (ma_resource_manager_register_decoded_data(resourceManager, importedPath.c_str(), asset.importedFrames.data(),
+            asset.importedFrames.size() / importedChannels, ma_format_f32, importedChannels, importSampleRate) == MA_SUCCESS) {
+            name = importedPath.c_str();
+        }
+        else {
+            std::vector<float>().swap(asset.importedFrames);
+        }
+    }
+
+    if (ma_resource_manager_data_source_init(resourceManager, name, g_decodeFlags, NULL, &asset.anchor) != MA_SUCCESS) {
+        if (!asset.importedFrames.empty()) {
+            ma_resource_manager_unregister_data(resourceManager, importedPath.c_str());
+            std::vector<float>().swap(asset.importedFrames);
+        }
+        return false;
+    }
+
+    ma_format format;
+    ma_uint32 channels;
+    ma_uint32 sampleRate;
+    ma_uint64 length = 0;
+    ma_resource_manager_data_source_get_data_format(&asset.anchor, &format, &channels, &sampleRate, NULL, 0);
+    ma_resource_manager_data_source_get_length_in_pcm_frames(&asset.anchor, &length);
+    asset.bytes = static_cast<size_t>(length * ma_get_bytes_per_frame(format, channels));
+    asset.resident = true;
+    usage += asset.bytes;
+
+    if (usage > budget && !EvictIdleLocked(usage - budget, &asset)) {
+        EvictLocked(asset);
+        return false;
+    }
+    return true;
+}
+
+bool PcmCache::EvictIdleLocked(size_t bytesNeeded, const Asset* keep) {
+    size_t freed = 0;
+    while (freed < bytesNeeded) {
+        Asset* oldest = nullptr;
+        for (auto& pair : assets) {
+            Asset* candidate = pair.second.get();
+            if (candidate == keep || !candidate->resident || candidate->pinCount > 0) continue;
+            if (!oldest || candidate->lastUsed < oldest->lastUsed) {
+                oldest = candidate;
+            }
+        }
+        if (!oldest) {
+            return false;
+        }
+
+        freed += oldest->bytes;
+        EvictLocked(*oldest);
+    }
+    return true;
+}
+
+void PcmCache::EvictLocked(Asset& asset) {
+    if (!asset.resident) return;
+
+    // Idle sources drop their reference so the decoded data is actually freed. Playing
+    // ones keep theirs, which holds the data alive, and let go when they stop.
+    for (CachedSoundSource* source : asset.sources) {
+        if (source->activeBacking >= 0 && !source->streaming && !source->pinned) {
+            source->DetachBacking();
+        }
+    }
+
+    ma_resource_manager_data_source_uninit(&asset.anchor);
+    if (!asset.importedFrames.empty()) {
+        ma_resource_manager_unregister_data(resourceManager, AssetImporter::GetImportedPath(importDirectory, asset.filePath).c_str());
+        std::vector<float>().swap(asset.importedFrames);
+    }
+    asset.resident = false;
+    usage -= asset.bytes;
+}
+
+// ---------------------------------------------------------------------------
+// CachedSoundSource
+// ---------------------------------------------------------------------------
+
+const ma_data_source_vtable CachedSoundSource::SourceVTable = {
+    &CachedSoundSource::OnRead,
+    &CachedSoundSource::OnSeek,
+    &CachedSoundSource::OnGetDataFormat,
+    &CachedSoundSource::OnGetCursor,
+    &CachedSoundSource::OnGetLength,
+    NULL,                           // onSetLooping; looping is handled by the base
+    0
+};
+
+CachedSoundSource::CachedSoundSource(PcmCache& cache, const std::string& filePath)
+    : cache(cache)
+    , asset(nullptr)
+    , filePath(filePath)
+    , activeBacking(-1)
+    , streaming(false)
+    , backingLock(false)
+    , cursor(0)
+    , format(ma_format_f32)
+    , channels(0)
+    , sampleRate(0)
+    , length(0)
+    , initialized(false)
+    , pinned(false)
+{
+    if (!cache.resourceManager) return;
+
+    asset = cache.Register(this, filePath);
+
+    // The first backing tells us the format; a stream is only kept while playing
+    if (!AttachBacking(asset->resident)) {
+        cache.Unregister(this, asset);
+        asset = nullptr;
+        return;
+    }
+    ma_resource_manager_data_source_get_data_format(&backings[activeBacking], &format, &channels, &sampleRate, NULL, 0);
+    ma_resource_manager_data_source_get_length_in_pcm_frames(&backings[activeBacking], &length);
+    if (streaming) {
+        DetachBacking();
+    }
+
+    ma_data_source_config config = ma_data_source_config_init();
+    config.vtable = &SourceVTable;
+    source.owner = this;
+    initialized = (ma_data_source_init(&config, &source) == MA_SUCCESS);
+}
+
+CachedSoundSource::~CachedSoundSource() {
+    if (initialized) {
+        ma_data_source_uninit(&source);
+    }
+    if (pinned) {
+        cache.Unpin(asset);
+    }
+    DetachBacking();
+    if (asset) {
+        cache.Unregister(this, asset);
+    }
+}
+
+bool CachedSoundSource::IsInitialized() const {
+    return initialized;
+}
+
+ma_data_source* CachedSoundSource::GetDataSource() {
+    return initialized ? &source : nullptr;
+}
+
+bool CachedSoundSource::IsStreaming() const {
+    if (activeBacking >= 0) return streaming;
+    return !asset || !asset->resident;
+}
+
+void CachedSoundSource::BeginPlayback() {
+    if (!initialized || pinned) return;
+
+    cache.Pin(asset);
+    pinned = true;
+
+    // Switch to the cached PCM if it was (re-)admitted, otherwise stream
+    bool decoded = asset->resident;
+    if (activeBacking < 0 || streaming == decoded) {
+        AttachBacking(decoded);
+    }
+}
+
+void CachedSoundSource::EndPlayback() {
+    if (!initialized || !pinned) return;
+
+    pinned = false;
+    const bool resident = cache.Unpin(asset);
+
+    // Streams hold a couple of pages of decoded audio; don't keep them idle. Nor the
+    // cached PCM of an asset evicted while this played, so its memory is freed.
+    if (streaming || !resident) {
+        DetachBacking();
+    }
+}
+
+bool CachedSoundSource::AttachBacking(bool decoded) {
+    const int slot = (activeBacking == 0) ? 1 : 0;
+    ma_resource_manager_data_source* next = &backings[slot];
+
+    ma_result result;
+    if (decoded) {
+        result = ma_resource_manager_data_source_init_copy(cache.resourceManager, &asset->anchor, next);
+    }
+    else {
+        result = ma_resource_manager_data_source_init(cache.resourceManager, filePath.c_str(), g_streamFlags, NULL, next);
+    }
+    if (result != MA_SUCCESS) {
+        return false;
+    }
+
+    // Pick up where the sound was, e.g. after a seek applied while stopped
+    ma_resource_manager_data_source_seek_to_pcm_frame(next, cursor.load());
+
+    LockBacking();
+    const int previous = activeBacking;
+    activeBacking = slot;
+    streaming = !decoded;
+    UnlockBacking();
+
+    if (previous >= 0) {
+        ma_resource_manager_data_source_uninit(&backings[previous]);
+    }
+    return true;
+}
+
+void CachedSoundSource::DetachBacking() {
+    if (activeBacking < 0) return;
+
+    LockBacking();
+    const int previous = activeBacking;
+    activeBacking = -1;
+    UnlockBacking();
+
+    ma_resource_manager_data_source_uninit(&backings[previous]);
+}
+
+void CachedSoundSource::LockBacking() {
+    while (backingLock.exchange(true, std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void CachedSoundSource::UnlockBacking() {
+    backingLock.store(false, std::memory_order_release);
+}
+
+ma_result CachedSoundSource::OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+    CachedSoundSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    // Never wait on the game thread; a block that overlaps a swap is silent
+    if (self->backingLock.exchange(true, std::memory_order_acquire)) {
+        if (pFramesOut) {
+            ma_silence_pcm_frames(pFramesOut, frameCount, self->format, self->channels);
+        }
+        *pFramesRead = frameCount;
+        return MA_SUCCESS;
+    }
+
+    // Nothing to read from means the sound can't continue, so it ends rather than
+    // playing silence that never finishes
+    ma_result result = MA_AT_END;
+    ma_uint64 framesRead = 0;
+    if (self->activeBacking >= 0) {
+        result = ma_resource_manager_data_source_read_pcm_frames(&self->backings[self->activeBacking], pFramesOut, frameCount, &framesRead);
+    }
+    self->UnlockBacking();
+
+    self->cursor.fetch_add(framesRead, std::memory_order_relaxed);
+    *pFramesRead = framesRead;
+    return result;
+}
+
+ma_result CachedSoundSource::OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+    CachedSoundSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    // Remembered even without a backing, so the next one starts in the right place
+    self->cursor.store(frameIndex, std::memory_order_relaxed);
+
+    if (self->backingLock.exchange(true, std::memory_order_acquire)) {
+        return MA_SUCCESS;
+    }
+    if (self->activeBacking >= 0) {
+        ma_resource_manager_data_source_seek_to_pcm_frame(&self->backings[self->activeBacking], frameIndex);
+    }
+    self->UnlockBacking();
+    return MA_SUCCESS;
+}
+
+ma_result CachedSoundSource::OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+    ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+    CachedSoundSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    *pFormat = self->format;
+    *pChannels = self->channels;
+    *pSampleRate = self->sampleRate;
+    ma_channel_map_init_standard(ma_standard_channel_map_default, pChannelMap, channelMapCap, self->channels);
+    return MA_SUCCESS;
+}
+
+ma_result CachedSoundSource::OnGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+    CachedSoundSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+    *pCursor = self->cursor.load(std::memory_order_relaxed);
+    return MA_SUCCESS;
+}
+
+ma_result CachedSoundSource::OnGetLength(ma_data_source* pDataSource, ma_uint64* pLength) {
+    CachedSoundSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+    if (self->length == 0) {
+        return MA_NOT_IMPLEMENTED;
+    }
+    *pLength = self->length;
+    return MA_SUCCESS;
+}
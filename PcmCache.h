@@ -0,0 +1,136 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class CachedSoundSource;
+
+// Byte-budgeted cache of decoded PCM, shared by every sound that plays the same
+// file. Assets nobody is playing are evicted least recently used first when a new
+// asset needs room; their sounds stay loaded and stream from disk until a later
+// play finds room to decode them again.
+//
+// Decoding and streaming both go through the resource manager, so the two paths
+// produce the same format and a sound can switch between them while stopped.
+// Assets with a current import (see AssetImporter) are read from it instead of
+// being decoded.
+class PcmCache {
+public:
+    PcmCache();
+    ~PcmCache();
+
+    // Must be set before any source is created. Changing it drops everything cached.
+    // Imports are read from importDirectory and only used when they match sampleRate
+    // (the resource manager's decode rate); 0 never uses them.
+    void SetResourceManager(ma_resource_manager* resourceManager, ma_uint32 sampleRate = 0,
+        const std::string& importDirectory = std::string());
+
+    void SetBudget(size_t bytes);
+    size_t GetBudget() const;
+    size_t GetUsage() const;
+
+private:
+    friend class CachedSoundSource;
+
+    struct Asset {
+        std::string filePath;
+        ma_resource_manager_data_source anchor;    // Keeps the decoded data resident
+        bool resident = false;
+        size_t bytes = 0;                           // Decoded size, once known
+        std::vector<float> importedFrames;          // Registered with the resource manager while resident
+        size_t pinCount = 0;                        // Sources currently playing
+        ma_uint64 lastUsed = 0;
+        std::vector<CachedSoundSource*> sources;
+    };
+
+    // Called by CachedSoundSource
+    Asset* Register(CachedSoundSource* source, const std::string& filePath);
+    void Unregister(CachedSoundSource* source, Asset* asset);
+    void Pin(Asset* asset);
+    bool Unpin(Asset* asset);   // False if the asset was evicted while pinned
+
+    bool AdmitLocked(Asset& asset);
+    bool EvictIdleLocked(size_t bytesNeeded, const Asset* keep);
+    void EvictLocked(Asset& asset);
+
+    ma_resource_manager* resourceManager;
+    ma_uint32 importSampleRate;
+    std::string importDirectory;
+    std::unordered_map<std::string, std::unique_ptr<Asset>> assets;
+    size_t budget;
+    size_t usage;
+    ma_uint64 useCounter;
+    mutable std::mutex cacheMutex;
+};
+
+// Data source a sound plays through. Reads the cached PCM while the asset is
+// resident and a resource-manager stream while it isn't. The backing only changes
+// between plays, and the audio thread never waits for the game thread: it outputs
+// silence for the rare block that overlaps a swap. A sound whose backing was taken
+// away while it played (the resource manager changed) ends instead of playing
+// silence forever.
+class CachedSoundSource {
+public:
+    CachedSoundSource(PcmCache& cache, const std::string& filePath);
+    ~CachedSoundSource();
+
+    bool IsInitialized() const;
+    ma_data_source* GetDataSource();
+
+    // Bracket each playback. Begin pins the asset (re-decoding it if it fits) and
+    // picks the backing; End unpins it and releases a stream.
+    void BeginPlayback();
+    void EndPlayback();
+    bool IsStreaming() const;
+
+private:
+    CachedSoundSource(const CachedSoundSource&) = delete;
+    CachedSoundSource& operator=(const CachedSoundSource&) = delete;
+
+    friend class PcmCache;
+
+    struct SourceBase {
+        ma_data_source_base base;
+        CachedSoundSource* owner;
+    };
+
+    static ma_result OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+    static ma_result OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex);
+    static ma_result OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+        ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap);
+    static ma_result OnGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor);
+    static ma_result OnGetLength(ma_data_source* pDataSource, ma_uint64* pLength);
+    static const ma_data_source_vtable SourceVTable;
+
+    // Game thread, while the sound isn't playing
+    bool AttachBacking(bool decoded);
+    void DetachBacking();
+    void LockBacking();
+    void UnlockBacking();
+
+    SourceBase source;
+    PcmCache& cache;
+    PcmCache::Asset* asset;
+    std::string filePath;
+
+    // Two slots so a new backing can be opened before the old one is dropped;
+    // data sources can't be moved once initialized
+    ma_resource_manager_data_source backings[2];
+    int activeBacking;      // -1 when there is none
+    bool streaming;
+    std::atomic<bool> backingLock;
+    std::atomic<ma_uint64> cursor;
+
+    ma_format format;
+    ma_uint32 channels;
+    ma_uint32 sampleRate;
+    ma_uint64 length;
+    bool initialized;
+    bool pinned;
+};
@@ -0,0 +1,329 @@
+#include "miniaudio.h"
+#include "Procedural.h"
+#include "AudioEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+static const double g_twoPi = 6.283185307179586;
+
+const ma_data_source_vtable ProceduralSource::SourceVTable = {
+    &ProceduralSource::OnRead,
+    &ProceduralSource::OnSeek,
+    &ProceduralSource::OnGetDataFormat,
+    &ProceduralSource::OnGetCursor,
+    &ProceduralSource::OnGetLength,
+    NULL,                           // onSetLooping; ma_data_source handles looping by seeking
+    0
+};
+
+// ---------------------------------------------------------------------------
+// ProceduralSource
+// ---------------------------------------------------------------------------
+
+ProceduralSource::ProceduralSource(float durationSeconds)
+    : sampleRate(0)
+    , initialized(false)
+    , lengthFrames(0)
+    , cursor(0)
+    , attackSeconds(0.0f)
+    , releaseSeconds(0.0f)
+{
+    sampleRate = ma_engine_get_sample_rate(AudioEngine::Instance().GetEngine());
+    if (sampleRate == 0) {
+        return;
+    }
+    lengthFrames = static_cast<ma_uint64>(std::max(durationSeconds, 0.0f) * sampleRate);
+
+    ma_data_source_config config = ma_data_source_config_init();
+    config.vtable = &SourceVTable;
+    base.owner = this;
+    initialized = (ma_data_source_init(&config, &base) == MA_SUCCESS);
+}
+
+ProceduralSource::~ProceduralSource() {
+    if (initialized) {
+        ma_data_source_uninit(&base);
+    }
+}
+
+bool ProceduralSource::IsInitialized() const {
+    return initialized;
+}
+
+ma_data_source* ProceduralSource::GetDataSource() {
+    return initialized ? &base : nullptr;
+}
+
+void ProceduralSource::SetEnvelope(float attack, float release) {
+    attackSeconds.store(std::max(attack, 0.0f));
+    releaseSeconds.store(std::max(release, 0.0f));
+}
+
+ma_result ProceduralSource::OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+    ProceduralSource* self = reinterpret_cast<SourceBase*>(pDataSource)->owner;
+    return self->Read(static_cast<float*>(pFramesOut), frameCount, pFramesRead);
+}
+
+ma_result ProceduralSource::OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+    ProceduralSource* self = reinterpret_cast<SourceBase*>(pDataSource)->owner;
+    if (self->lengthFrames > 0 && frameIndex > self->lengthFrames) {
+        return MA_INVALID_ARGS;
+    }
+
+    self->cursor = frameIndex;
+    self->Restart();
+    return MA_SUCCESS;
+}
+
+ma_result ProceduralSource::OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+    ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+    ProceduralSource* self = reinterpret_cast<SourceBase*>(pDataSource)->owner;
+
+    *pFormat = ma_format_f32;
+    *pChannels = 1;
+    *pSampleRate = self->sampleRate;
+    ma_channel_map_init_standard(ma_standard_channel_map_default, pChannelMap, channelMapCap, 1);
+    return MA_SUCCESS;
+}
+
+ma_result ProceduralSource::OnGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+    *pCursor = reinterpret_cast<SourceBase*>(pDataSource)->owner->cursor;
+    return MA_SUCCESS;
+}
+
+ma_result ProceduralSource::OnGetLength(ma_data_source* pDataSource, ma_uint64* pLength) {
+    // Endless sources report no length, which miniaudio treats as unknown
+    ProceduralSource* self = reinterpret_cast<SourceBase*>(pDataSource)->owner;
+    *pLength = self->lengthFrames;
+    return self->lengthFrames > 0 ? MA_SUCCESS : MA_NOT_IMPLEMENTED;
+}
+
+ma_result ProceduralSource::Read(float* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+    if (lengthFrames > 0) {
+        frameCount = std::min(frameCount, lengthFrames - cursor);
+    }
+
+    ma_uint64 done = 0;
+    while (done < frameCount) {
+        const ma_uint32 count = static_cast<ma_uint32>(std::min<ma_uint64>(frameCount - done, 0xFFFFFFFF));
+        Generate(&pFramesOut[done], count);
+        if (lengthFrames > 0) {
+            ApplyEnvelope(&pFramesOut[done], count);
+        }
+        cursor += count;
+        done += count;
+    }
+
+    if (pFramesRead) {
+        *pFramesRead = done;
+    }
+    return (done == 0 && frameCount == 0 && lengthFrames > 0) ? MA_AT_END : MA_SUCCESS;
+}
+
+void ProceduralSource::ApplyEnvelope(float* pFrames, ma_uint32 frameCount) const {
+    const float attackFrames = attackSeconds.load(std::memory_order_relaxed) * sampleRate;
+    const float releaseFrames = releaseSeconds.load(std::memory_order_relaxed) * sampleRate;
+
+    // Most blocks sit between the ramps
+    const ma_uint64 last = cursor + frameCount;
+    if (cursor >= attackFrames && static_cast<float>(lengthFrames - last) >= releaseFrames) {
+        return;
+    }
+
+    for (ma_uint32 i = 0; i < frameCount; i++) {
+        const float position = static_cast<float>(cursor + i);
+        const float remaining = static_cast<float>(lengthFrames - (cursor + i));
+        float gain = 1.0f;
+        if (position < attackFrames) gain = std::min(gain, position / attackFrames);
+        if (remaining < releaseFrames) gain = std::min(gain, remaining / releaseFrames);
+        pFrames[i] *= gain;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// OscillatorSource
+// ---------------------------------------------------------------------------
+
+// Smooths the step at a waveform edge across one sample either side of it
+static float PolyBlep(double t, double dt) {
+    if (t < dt) {
+        t /= dt;
+        return static_cast<float>(t + t - t * t - 1.0);
+    }
+    if (t > 1.0 - dt) {
+        t = (t - 1.0) / dt;
+        return static_cast<float>(t * t + t + t + 1.0);
+    }
+    return 0.0f;
+}
+
+OscillatorSource::OscillatorSource(Shape shape, float frequencyHz, float amplitudeValue, float durationSeconds)
+    : ProceduralSource(durationSeconds)
+    , shape(shape)
+    , frequency(frequencyHz)
+    , amplitude(amplitudeValue)
+    , phase(0.0)
+{
+}
+
+void OscillatorSource::SetFrequency(float frequencyHz) {
+    frequency.store(std::max(frequencyHz, 0.0f));
+}
+
+float OscillatorSource::GetFrequency() const {
+    return frequency.load();
+}
+
+void OscillatorSource::SetAmplitude(float value) {
+    amplitude.store(std::max(value, 0.0f));
+}
+
+float OscillatorSource::GetAmplitude() const {
+    return amplitude.load();
+}
+
+void OscillatorSource::Restart() {
+    phase = 0.0;
+}
+
+void OscillatorSource::Generate(float* pFramesOut, ma_uint32 frameCount) {
+    const double dt = std::min(static_cast<double>(frequency.load(std::memory_order_relaxed)) / sampleRate, 0.5);
+    const float gain = amplitude.load(std::memory_order_relaxed);
+
+    for (ma_uint32 i = 0; i < frameCount; i++) {
+        float value = 0.0f;
+        switch (shape) {
+        case Shape::Sine:
+            value = static_cast<float>(std::sin(g_twoPi * phase));
+            break;
+        case Shape::Square:
+            value = (phase < 0.5) ? 1.0f : -1.0f;
+            value += PolyBlep(phase, dt);
+            value -= PolyBlep(std::fmod(phase + 0.5, 1.0), dt);
+            break;
+        case Shape::Triangle:
+            // Harmonics fall off at 12dB/octave, so aliasing stays well down
+            value = static_cast<float>(4.0 * std::fabs(phase - 0.5) - 1.0);
+            break;
+        case Shape::Sawtooth:
+            value = static_cast<float>(2.0 * phase - 1.0);
+            value -= PolyBlep(phase, dt);
+            break;
+        }
+        pFramesOut[i] = value * gain;
+
+        phase += dt;
+        if (phase >= 1.0) phase -= 1.0;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// NoiseSource
+// ---------------------------------------------------------------------------
+
+NoiseSource::NoiseSource(Color color, float amplitudeValue, float durationSeconds)
+    : ProceduralSource(durationSeconds)
+    , noiseInitialized(false)
+    , amplitude(amplitudeValue)
+{
+    ma_noise_type type = ma_noise_type_white;
+    if (color == Color::Pink) type = ma_noise_type_pink;
+    if (color == Color::Brown) type = ma_noise_type_brownian;
+
+    // Full scale here; the amplitude is applied per block so it can change while playing.
+    // Seeded per instance, or every noise source would play the same sequence.
+    const ma_int32 seed = static_cast<ma_int32>(std::random_device{}());
+    ma_noise_config config = ma_noise_config_init(ma_format_f32, 1, type, seed, 1.0);
+    noiseInitialized = (ma_noise_init(&config, NULL, &noise) == MA_SUCCESS);
+}
+
+NoiseSource::~NoiseSource() {
+    if (noiseInitialized) {
+        ma_noise_uninit(&noise, NULL);
+    }
+}
+
+void NoiseSource::SetAmplitude(float value) {
+    amplitude.store(std::max(value, 0.0f));
+}
+
+float NoiseSource::GetAmplitude() const {
+    return amplitude.load();
+}
+
+void NoiseSource::Generate(float* pFramesOut, ma_uint32 frameCount) {
+    if (!noiseInitialized) {
+        ma_silence_pcm_frames(pFramesOut, frameCount, ma_format_f32, 1);
+        return;
+    }
+
+    ma_noise_read_pcm_frames(&noise, pFramesOut, frameCount, NULL);
+
+    const float gain = amplitude.load(std::memory_order_relaxed);
+    for (ma_uint32 i = 0; i < frameCount; i++) {
+        pFramesOut[i] *= gain;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// FmSource
+// ---------------------------------------------------------------------------
+
+FmSource::FmSource(float carrierHz, float ratioValue, float indexValue, float amplitudeValue, float durationSeconds)
+    : ProceduralSource(durationSeconds)
+    , carrier(carrierHz)
+    , ratio(ratioValue)
+    , index(indexValue)
+    , amplitude(amplitudeValue)
+    , carrierPhase(0.0)
+    , modulatorPhase(0.0)
+{
+}
+
+void FmSource::SetCarrier(float carrierHz) {
+    carrier.store(std::max(carrierHz, 0.0f));
+}
+
+void FmSource::SetRatio(float value) {
+    ratio.store(std::max(value, 0.0f));
+}
+
+void FmSource::SetIndex(float value) {
+    index.store(std::max(value, 0.0f));
+}
+
+void FmSource::SetAmplitude(float value) {
+    amplitude.store(std::max(value, 0.0f));
+}
+
+void FmSource::Restart() {
+    carrierPhase = 0.0;
+    modulatorPhase = 0.0;
+}
+
+void FmSource::Generate(float* pFramesOut, ma_uint32 frameCount) {
+    const double carrierStep = static_cast<double>(carrier.load(std::memory_order_relaxed)) / sampleRate;
+    const double modulatorStep = carrierStep * ratio.load(std::memory_order_relaxed);
+    const double depth = index.load(std::memory_order_relaxed);
+    const float gain = amplitude.load(std::memory_order_relaxed);
+
+    for (ma_uint32 i = 0; i < frameCount; i++) {
+        const double modulator = std::sin(g_twoPi * modulatorPhase);
+        pFramesOut[i] = static_cast<float>(std::sin(g_twoPi * carrierPhase + depth * modulator)) * gain;
+
+        carrierPhase += carrierStep;
+        carrierPhase -= std::floor(carrierPhase);
+        modulatorPhase += modulatorStep;
+        modulatorPhase -= std::floor(modulatorPhase);
+    }
+}
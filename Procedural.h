@@ -0,0 +1,139 @@
+#pragma once
+
+#include "miniaudio.h"
+
+#include <atomic>
+
+// Base for synthesized sounds. A procedural source is a mono f32 data source at the
+// engine rate that generates its samples as the voice reads them, so it costs no
+// memory beyond its own state. Wrap it in a Sound (AudioEngine::CreateSound or
+// SoundComponent::AddSound) to play, pitch, spatialize and route it like a file.
+//
+// A source with a duration ends like a file, with an optional linear attack and
+// release so one-shots (UI blips) don't click; an endless one (duration 0) plays
+// until stopped. Parameters are atomics read once per block on the audio thread.
+// Each source feeds a single Sound.
+class ProceduralSource {
+public:
+    explicit ProceduralSource(float durationSeconds = 0.0f);
+    virtual ~ProceduralSource();
+
+    virtual bool IsInitialized() const;
+    ma_data_source* GetDataSource();
+
+    // Seconds; only applied to sources with a duration
+    void SetEnvelope(float attackSeconds, float releaseSeconds);
+
+protected:
+    // Audio thread. Writes frameCount mono frames.
+    virtual void Generate(float* pFramesOut, ma_uint32 frameCount) = 0;
+
+    // Audio thread. Called when the voice seeks (restarts or loops), to reset phases.
+    virtual void Restart() {}
+
+    ma_uint32 sampleRate;
+
+private:
+    ProceduralSource(const ProceduralSource&) = delete;
+    ProceduralSource& operator=(const ProceduralSource&) = delete;
+
+    struct SourceBase {
+        ma_data_source_base base;
+        ProceduralSource* owner;
+    };
+
+    static ma_result OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+    static ma_result OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex);
+    static ma_result OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+        ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap);
+    static ma_result OnGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor);
+    static ma_result OnGetLength(ma_data_source* pDataSource, ma_uint64* pLength);
+    static const ma_data_source_vtable SourceVTable;
+
+    // Audio thread
+    ma_result Read(float* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+    void ApplyEnvelope(float* pFrames, ma_uint32 frameCount) const;
+
+    SourceBase base;
+    bool initialized;
+    ma_uint64 lengthFrames;     // 0 for endless
+    ma_uint64 cursor;           // Audio thread
+    std::atomic<float> attackSeconds;
+    std::atomic<float> releaseSeconds;
+};
+
+// Classic waveforms; square and sawtooth edges are band-limited (PolyBLEP)
+class OscillatorSource : public ProceduralSource {
+public:
+    enum class Shape {
+        Sine,
+        Square,
+        Triangle,
+        Sawtooth
+    };
+
+    OscillatorSource(Shape shape, float frequencyHz, float amplitude = 0.5f, float durationSeconds = 0.0f);
+
+    void SetFrequency(float frequencyHz);
+    float GetFrequency() const;
+    void SetAmplitude(float amplitude);
+    float GetAmplitude() const;
+
+protected:
+    void Generate(float* pFramesOut, ma_uint32 frameCount) override;
+    void Restart() override;
+
+private:
+    Shape shape;
+    std::atomic<float> frequency;
+    std::atomic<float> amplitude;
+    double phase;               // 0 to 1
+};
+
+// White, pink or brown noise (wind, rain, engine rumble under a filter)
+class NoiseSource : public ProceduralSource {
+public:
+    enum class Color {
+        White,
+        Pink,
+        Brown
+    };
+
+    NoiseSource(Color color, float amplitude = 0.5f, float durationSeconds = 0.0f);
+    ~NoiseSource() override;
+
+    void SetAmplitude(float amplitude);
+    float GetAmplitude() const;
+
+protected:
+    void Generate(float* pFramesOut, ma_uint32 frameCount) override;
+
+private:
+    ma_noise noise;
+    bool noiseInitialized;
+    std::atomic<float> amplitude;
+};
+
+// Two-operator FM: a sine modulator at carrier * ratio varies the carrier's phase
+// by up to index radians. Ratio and index shape the timbre (bells, engines, zaps).
+class FmSource : public ProceduralSource {
+public:
+    FmSource(float carrierHz, float ratio, float index, float amplitude = 0.5f, float durationSeconds = 0.0f);
+
+    void SetCarrier(float carrierHz);
+    void SetRatio(float ratio);
+    void SetIndex(float index);
+    void SetAmplitude(float amplitude);
+
+protected:
+    void Generate(float* pFramesOut, ma_uint32 frameCount) override;
+    void Restart() override;
+
+private:
+    std::atomic<float> carrier;
+    std::atomic<float> ratio;
+    std::atomic<float> index;
+    std::atomic<float> amplitude;
+    double carrierPhase;        // 0 to 1
+    double modulatorPhase;
+};
@@ -0,0 +1,379 @@
+#include "miniaudio.h"
+#include "Resampler.h"
+#include "AudioSIMD.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// On Windows, prevent macros from colliding
+#ifdef max
+#undef max
+#endif
+#ifdef min
+#undef min
+#endif
+
+const ma_uint32 ResamplingSource::SincTaps;
+const ma_uint32 ResamplingSource::ChunkFrames;
+
+static const double g_pi = 3.14159265358979323846;
+
+// Filter positions between input frames; coefficients are interpolated in between
+static const ma_uint32 g_sincPhases = 64;
+
+// One filter per eighth of a step above 1 (reading faster than the output rate),
+// each cut off low enough for that range. Steps past the last band alias a little.
+static const ma_uint32 g_sincBands = 25;
+static const double g_sincBandWidth = 0.125;
+
+// Cutoff as a fraction of the output Nyquist rate, leaving room for the transition band
+static const double g_sincPassband = 0.9;
+
+static const ma_uint32 g_sincReach = ResamplingSource::SincTaps / 2;
+
+// Blackman-Harris window over [-1, 1]
+static double Window(double x) {
+    double n = (x + 1.0) * 0.5;
+    return 0.35875 - 0.48829 * std::cos(2.0 * g_pi * n) + 0.14128 * std::cos(4.0 * g_pi * n)
+        - 0.01168 * std::cos(6.0 * g_pi * n);
+}
+
+// Every band's taps for every phase, plus one extra phase (a whole frame on) so
+// the last phase has a neighbour to interpolate towards. Built once, read-only after.
+static const std::vector<float>& GetSincFilterBank() {
+    static const std::vector<float> bank = []() {
+        const ma_uint32 taps = ResamplingSource::SincTaps;
+        std::vector<float> coefficients(static_cast<size_t>(g_sincBands) * (g_sincPhases + 1) * taps);
+
+        for (ma_uint32 band = 0; band < g_sincBands; band++) {
+            const double cutoff = g_sincPassband / (1.0 + band * g_sincBandWidth);
+
+            for (ma_uint32 phase = 0; phase <= g_sincPhases; phase++) {
+                float* pTaps = &coefficients[(static_cast<size_t>(band) * (g_sincPhases + 1) + phase) * taps];
+                const double fraction = static_cast<double>(phase) / g_sincPhases;
+
+                double sum = 0.0;
+                for (ma_uint32 j = 0; j < taps; j++) {
+                    // Distance from the read position to the input frame under tap j
+                    double x = static_cast<double>(j) - (g_sincReach - 1) - fraction;
+                    double y = cutoff * x;
+                    double sinc = (std::fabs(y) < 1e-9) ? 1.0 : std::sin(g_pi * y) / (g_pi * y);
+                    double value = cutoff * sinc * Window(x / g_sincReach);
+                    pTaps[j] = static_cast<float>(value);
+                    sum += value;
+                }
+
+                // Unity gain at DC for every phase
+                for (ma_uint32 j = 0; j < taps; j++) {
+                    pTaps[j] = static_cast<float>(pTaps[j] / sum);
+                }
+            }
+        }
+        return coefficients;
+    }();
+    return bank;
+}
+
+const ma_data_source_vtable ResamplingSource::SourceVTable = {
+    &ResamplingSource::OnRead,
+    &ResamplingSource::OnSeek,
+    &ResamplingSource::OnGetDataFormat,
+    &ResamplingSource::OnGetCursor,
+    &ResamplingSource::OnGetLength,
+    NULL,                           // onSetLooping; forwarded at read time
+    0
+};
+
+ResamplingSource::ResamplingSource(ma_data_source* source, ma_uint32 outputSampleRate)
+    : source(source)
+    , channels(0)
+    , inputSampleRate(0)
+    , outputSampleRate(outputSampleRate)
+    , inputLength(0)
+    , initialized(false)
+    , pitch(1.0f)
+    , quality(ResamplerQuality::Linear)
+    , dopplerPitch(nullptr)
+    , cursor(0)
+    , historyFrames(0)
+    , position(0.0)
+    , inputEnded(false)
+    , endFrame(0)
+{
+    ma_format format;
+    if (!source || outputSampleRate == 0
+        || ma_data_source_get_data_format(source, &format, &channels, &inputSampleRate, NULL, 0) != MA_SUCCESS
+        || format != ma_format_f32 || channels == 0 || inputSampleRate == 0) {
+        return;
+    }
+    ma_data_source_get_length_in_pcm_frames(source, &inputLength);
+
+    GetSincFilterBank();
+    history.assign(static_cast<size_t>(SincTaps + ChunkFrames) * channels, 0.0f);
+    interleaved.assign(static_cast<size_t>(ChunkFrames) * channels, 0.0f);
+    coefficients.assign(SincTaps, 0.0f);
+
+    ma_uint64 inputCursor = 0;
+    ma_data_source_get_cursor_in_pcm_frames(source, &inputCursor);
+    Reset(inputCursor);
+
+    ma_data_source_config config = ma_data_source_config_init();
+    config.vtable = &SourceVTable;
+    base.owner = this;
+    initialized = (ma_data_source_init(&config, &base) == MA_SUCCESS);
+}
+
+ResamplingSource::~ResamplingSource() {
+    if (initialized) {
+        ma_data_source_uninit(&base);
+    }
+}
+
+bool ResamplingSource::IsInitialized() const {
+    return initialized;
+}
+
+ma_data_source* ResamplingSource::GetDataSource() {
+    return initialized ? &base : nullptr;
+}
+
+void ResamplingSource::SetPitch(float pitch) {
+    this->pitch.store(std::max(pitch, 0.0f));
+}
+
+float ResamplingSource::GetPitch() const {
+    return pitch.load();
+}
+
+void ResamplingSource::SetQuality(ResamplerQuality quality) {
+    this->quality.store(quality == ResamplerQuality::Sinc ? ResamplerQuality::Sinc : ResamplerQuality::Linear);
+}
+
+ResamplerQuality ResamplingSource::GetQuality() const {
+    return quality.load();
+}
+
+void ResamplingSource::SetDopplerSource(const float* dopplerPitch) {
+    this->dopplerPitch = dopplerPitch;
+}
+
+void ResamplingSource::Reset(ma_uint64 inputFrame) {
+    // Silence behind the first frame, so the filter never reaches before the history
+    std::fill(history.begin(), history.end(), 0.0f);
+    historyFrames = g_sincReach - 1;
+    position = static_cast<double>(g_sincReach - 1);
+    inputEnded = false;
+    endFrame = 0;
+    cursor.store(inputFrame * outputSampleRate / inputSampleRate);
+}
+
+bool ResamplingSource::Fill(size_t frameCount) {
+    const size_t capacity = SincTaps + ChunkFrames;
+
+    while (historyFrames < frameCount) {
+        // Drop frames the filter can no longer reach
+        const size_t discard = static_cast<size_t>(position) - (g_sincReach - 1);
+        if (discard > 0) {
+            for (ma_uint32 c = 0; c < channels; c++) {
+                float* pChannel = &history[c * capacity];
+                std::memmove(pChannel, pChannel + discard, sizeof(float) * (historyFrames - discard));
+            }
+            historyFrames -= discard;
+            frameCount -= discard;
+            position -= discard;
+            endFrame = (endFrame > discard) ? endFrame - discard : 0;
+        }
+
+        const size_t space = std::min<size_t>(capacity - historyFrames, ChunkFrames);
+
+        // Pad past the end so the last frames still get a full filter
+        if (inputEnded) {
+            const size_t padding = std::min(space, frameCount - historyFrames);
+            for (ma_uint32 c = 0; c < channels; c++) {
+                std::fill_n(&history[c * capacity + historyFrames], padding, 0.0f);
+            }
+            historyFrames += padding;
+            continue;
+        }
+
+        ma_uint64 framesRead = 0;
+        ma_result result = ma_data_source_read_pcm_frames(source, interleaved.data(), space, &framesRead);
+        for (ma_uint32 c = 0; c < channels; c++) {
+            float* pChannel = &history[c * capacity + historyFrames];
+            for (ma_uint64 f = 0; f < framesRead; f++) {
+                pChannel[f] = interleaved[f * channels + c];
+            }
+        }
+        historyFrames += static_cast<size_t>(framesRead);
+
+        if (result == MA_AT_END || (result == MA_SUCCESS && framesRead == 0)) {
+            inputEnded = true;
+            endFrame = historyFrames;
+        }
+        else if (framesRead == 0) {
+            return false;   // Stream not ready; try again next block
+        }
+    }
+    return true;
+}
+
+ma_result ResamplingSource::Read(float* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+    const size_t capacity = SincTaps + ChunkFrames;
+
+    // Loops are played by the wrapped source so the filter runs straight across them
+    ma_data_source_set_looping(source, ma_data_source_is_looping(&base));
+
+    // Capped so a single step never skips past the buffered history
+    const float doppler = dopplerPitch ? *dopplerPitch : 1.0f;
+    const double step = std::min(static_cast<double>(pitch.load(std::memory_order_relaxed)) * doppler * inputSampleRate / outputSampleRate,
+        static_cast<double>(g_sincReach));
+    const bool sinc = (quality.load(std::memory_order_relaxed) == ResamplerQuality::Sinc);
+    const size_t reach = sinc ? g_sincReach : 1;
+
+    // Narrower filters for faster steps, so pitching up doesn't fold highs back down
+    size_t band = 0;
+    if (step > 1.0) {
+        band = std::min<size_t>(g_sincBands - 1, static_cast<size_t>(std::ceil((step - 1.0) / g_sincBandWidth)));
+    }
+    const float* pBank = &GetSincFilterBank()[band * (g_sincPhases + 1) * SincTaps];
+
+    ma_uint64 framesWritten = 0;
+    ma_result result = MA_SUCCESS;
+
+    while (framesWritten < frameCount) {
+        const size_t index = static_cast<size_t>(position);
+        const double fraction = position - index;
+
+        if (inputEnded && index >= endFrame) {
+            result = MA_AT_END;
+            break;
+        }
+
+        // Unpitched and on a frame boundary: copy as many frames as are buffered
+        if (step == 1.0 && fraction == 0.0) {
+            if (!Fill(index + 1)) {
+                result = MA_BUSY;
+                break;
+            }
+
+            // Fill() may have moved the history down
+            const size_t current = static_cast<size_t>(position);
+            size_t available = historyFrames - current;
+            if (inputEnded) {
+                available = std::min(available, endFrame - current);
+            }
+            const size_t count = static_cast<size_t>(std::min<ma_uint64>(available, frameCount - framesWritten));
+            for (ma_uint32 c = 0; c < channels; c++) {
+                const float* pChannel = &history[c * capacity + current];
+                float* pOut = &pFramesOut[framesWritten * channels + c];
+                for (size_t f = 0; f < count; f++) {
+                    pOut[f * channels] = pChannel[f];
+                }
+            }
+            framesWritten += count;
+            position += static_cast<double>(count);
+            continue;
+        }
+
+        if (!Fill(index + reach + 1)) {
+            result = MA_BUSY;
+            break;
+        }
+
+        // Fill() may have moved the history down
+        const size_t current = static_cast<size_t>(position);
+        float* pOut = &pFramesOut[framesWritten * channels];
+
+        if (sinc) {
+            const double scaled = fraction * g_sincPhases;
+            const size_t phase = std::min<size_t>(static_cast<size_t>(scaled), g_sincPhases - 1);
+            const float* pTaps = &pBank[phase * SincTaps];
+            AudioSIMD::Lerp(coefficients.data(), pTaps, pTaps + SincTaps, static_cast<float>(scaled - phase), SincTaps);
+
+            for (ma_uint32 c = 0; c < channels; c++) {
+                const float* pWindow = &history[c * capacity + current - (g_sincReach - 1)];
+                pOut[c] = AudioSIMD::DotProduct(pWindow, coefficients.data(), SincTaps);
+            }
+        }
+        else {
+            const float t = static_cast<float>(fraction);
+            for (ma_uint32 c = 0; c < channels; c++) {
+                const float* pChannel = &history[c * capacity + current];
+                pOut[c] = pChannel[0] + (pChannel[1] - pChannel[0]) * t;
+            }
+        }
+
+        framesWritten++;
+        position += step;
+    }
+
+    PublishCursor();
+
+    *pFramesRead = framesWritten;
+    if (framesWritten > 0 && result == MA_BUSY) {
+        result = MA_SUCCESS;
+    }
+    return result;
+}
+
+void ResamplingSource::PublishCursor() {
+    // Where the wrapped source is, minus what is buffered ahead of the read position
+    ma_uint64 inputCursor = 0;
+    ma_data_source_get_cursor_in_pcm_frames(source, &inputCursor);
+
+    size_t buffered = inputEnded ? std::min(historyFrames, endFrame) : historyFrames;
+    double ahead = std::max(0.0, static_cast<double>(buffered) - position);
+    double inputPosition = static_cast<double>(inputCursor) - ahead;
+    if (inputPosition < 0.0) {
+        inputPosition += static_cast<double>(inputLength);     // Wrapped round a loop
+    }
+    inputPosition = std::max(0.0, inputPosition);
+
+    const double outputPosition = inputPosition * outputSampleRate / inputSampleRate;
+    cursor.store(static_cast<ma_uint64>(outputPosition + 0.5), std::memory_order_relaxed);
+}
+
+ma_result ResamplingSource::OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead) {
+    ResamplingSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+    return self->Read(static_cast<float*>(pFramesOut), frameCount, pFramesRead);
+}
+
+ma_result ResamplingSource::OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex) {
+    ResamplingSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    ma_uint64 inputFrame = frameIndex * self->inputSampleRate / self->outputSampleRate;
+    ma_result result = ma_data_source_seek_to_pcm_frame(self->source, inputFrame);
+    if (result == MA_SUCCESS) {
+        self->Reset(inputFrame);
+        self->cursor.store(frameIndex);
+    }
+    return result;
+}
+
+ma_result ResamplingSource::OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+    ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap) {
+    ResamplingSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    ma_result result = ma_data_source_get_data_format(self->source, pFormat, pChannels, NULL, pChannelMap, channelMapCap);
+    *pSampleRate = self->outputSampleRate;
+    return result;
+}
+
+ma_result ResamplingSource::OnGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor) {
+    ResamplingSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    *pCursor = self->cursor.load(std::memory_order_relaxed);
+    return MA_SUCCESS;
+}
+
+ma_result ResamplingSource::OnGetLength(ma_data_source* pDataSource, ma_uint64* pLength) {
+    ResamplingSource* self = static_cast<SourceBase*>(pDataSource)->owner;
+
+    if (self->inputLength == 0) {
+        *pLength = 0;
+        return MA_NOT_IMPLEMENTED;
+    }
+    *pLength = self->inputLength * self->outputSampleRate / self->inputSampleRate;
+    return MA_SUCCESS;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "miniaudio.h"
+#include "AudioEngine.h"
+
+#include <atomic>
+#include <vector>
+
+// Data source that plays another f32 source at the engine rate, applying pitch and
+// doppler with a choice of interpolation. Sounds read through it with miniaudio's
+// own pitch stage disabled, so an unpitched voice whose data is already at the
+// engine rate is a straight copy.
+//
+// Looping is forwarded to the wrapped source so loops play without a seam, and
+// cursor and length are reported in engine-rate frames.
+class ResamplingSource {
+public:
+    static const ma_uint32 SincTaps = 32;
+
+    ResamplingSource(ma_data_source* source, ma_uint32 outputSampleRate);
+    ~ResamplingSource();
+
+    bool IsInitialized() const;
+    ma_data_source* GetDataSource();
+
+    // Picked up at the next read
+    void SetPitch(float pitch);
+    float GetPitch() const;
+    void SetQuality(ResamplerQuality quality);      // Linear or Sinc; Default means Linear
+    ResamplerQuality GetQuality() const;
+
+    // Doppler ratio to apply on top of the pitch, read on the audio thread. Point it
+    // at the voice's ma_spatializer::dopplerPitch, which is updated on that thread.
+    void SetDopplerSource(const float* dopplerPitch);
+
+private:
+    ResamplingSource(const ResamplingSource&) = delete;
+    ResamplingSource& operator=(const ResamplingSource&) = delete;
+
+    static const ma_uint32 ChunkFrames = 512;
+
+    struct SourceBase {
+        ma_data_source_base base;
+        ResamplingSource* owner;
+    };
+
+    static ma_result OnRead(ma_data_source* pDataSource, void* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+    static ma_result OnSeek(ma_data_source* pDataSource, ma_uint64 frameIndex);
+    static ma_result OnGetDataFormat(ma_data_source* pDataSource, ma_format* pFormat, ma_uint32* pChannels,
+        ma_uint32* pSampleRate, ma_channel* pChannelMap, size_t channelMapCap);
+    static ma_result OnGetCursor(ma_data_source* pDataSource, ma_uint64* pCursor);
+    static ma_result OnGetLength(ma_data_source* pDataSource, ma_uint64* pLength);
+    static const ma_data_source_vtable SourceVTable;
+
+    // Audio thread
+    ma_result Read(float* pFramesOut, ma_uint64 frameCount, ma_uint64* pFramesRead);
+    void Reset(ma_uint64 inputFrame);
+    bool Fill(size_t frameCount);
+    void PublishCursor();
+
+    SourceBase base;
+    ma_data_source* source;
+    ma_uint32 channels;
+    ma_uint32 inputSampleRate;
+    ma_uint32 outputSampleRate;
+    ma_uint64 inputLength;      // 0 if unknown
+    bool initialized;
+
+    std::atomic<float> pitch;
+    std::atomic<ResamplerQuality> quality;
+    const float* dopplerPitch;
+    std::atomic<ma_uint64> cursor;     // Output frames
+
+    // Input history, planar so each channel's filter taps are contiguous. The
+    // filter reaches SincTaps / 2 - 1 frames behind and SincTaps / 2 ahead of the
+    // read position.
+    std::vector<float> history;
+    std::vector<float> interleaved;
+    std::vector<float> coefficients;
+    size_t historyFrames;
+    double position;            // Read position in input frames, relative to the history start
+    bool inputEnded;
+    size_t endFrame;            // One past the last real input frame once inputEnded
+};
@@ -1,22 +1,141 @@
 #include "miniaudio.h"
 #include "Sound.h"
 #include "AudioEngine.h"
+#include "Hrtf.h"
+#include "Attenuation.h"
+#include "PcmCache.h"
+#include "Resampler.h"
+#include "Procedural.h"
 
-Sound::Sound(const std::string& filePath)
-    : filePath(filePath)
+#include <atomic>
+
+static std::atomic<ma_uint64> g_nextSoundId(1);
+
+Sound::Sound(const std::string& filePath, LoadPolicy policy)
+    : id(g_nextSoundId.fetch_add(1))
+    , filePath(filePath)
+    , loadPolicy(policy)
     , loaded(false)
     , volume(1.0f)
+    , loudness(0.0f)
+    , hasLoudness(false)
     , category(AudioCategory::SFX)
+    , resamplerQuality(ResamplerQuality::Default)
+    , spatializationMode(SpatializationMode::Default)
+    , spatializationEnabled(true)
+    , attenuationModel(ma_attenuation_model_inverse)
+    , occlusion(0.0f)
+    , obstruction(0.0f)
+    , listenerIndex(MA_LISTENER_INDEX_CLOSEST)
     , playing(false)
     , paused(false)
 {
     engine = AudioEngine::Instance().GetEngine();
 
-    // Initialize the sound
-    ma_result result = ma_sound_init_from_file(engine, filePath.c_str(), 0, NULL, NULL, &sound);
+    if (loadPolicy == LoadPolicy::Auto) {
+        loadPolicy = AudioEngine::Instance().ChooseLoadPolicy(filePath);
+    }
+
+    // Decoded sounds read the PCM cache, falling back to the file if that fails
+    ma_data_source* source = nullptr;
+    PcmCache* cache = AudioEngine::Instance().GetPcmCache();
+    if (loadPolicy == LoadPolicy::Decode && cache) {
+        cachedSource = std::make_unique<CachedSoundSource>(*cache, filePath);
+        if (cachedSource->IsInitialized()) {
+            source = cachedSource->GetDataSource();
+        }
+        else {
+            cachedSource.reset();
+        }
+    }
+    if (!source) {
+        if (loadPolicy == LoadPolicy::Decode) {
+            loadPolicy = LoadPolicy::CompressedInMemory;
+        }
+        ma_uint32 flags = (loadPolicy == LoadPolicy::Stream) ? MA_RESOURCE_MANAGER_DATA_SOURCE_FLAG_STREAM : 0;
+        fileSource = std::make_unique<ma_resource_manager_data_source>();
+        if (ma_resource_manager_data_source_init(ma_engine_get_resource_manager(engine), filePath.c_str(), flags, NULL, fileSource.get()) == MA_SUCCESS) {
+            source = fileSource.get();
+        }
+        else {
+            fileSource.reset();
+        }
+    }
+
+    InitVoice(source);
+
+    if (!loaded) {
+        if (fileSource) {
+            ma_resource_manager_data_source_uninit(fileSource.get());
+            fileSource.reset();
+        }
+        cachedSource.reset();
+    }
+}
+
+Sound::Sound(const std::string& name, std::shared_ptr<ProceduralSource> source)
+    : id(g_nextSoundId.fetch_add(1))
+    , filePath(name)
+    , loadPolicy(LoadPolicy::Procedural)
+    , loaded(false)
+    , volume(1.0f)
+    , loudness(0.0f)
+    , hasLoudness(false)
+    , category(AudioCategory::SFX)
+    , resamplerQuality(ResamplerQuality::Default)
+    , spatializationMode(SpatializationMode::Default)
+    , spatializationEnabled(true)
+    , attenuationModel(ma_attenuation_model_inverse)
+    , occlusion(0.0f)
+    , obstruction(0.0f)
+    , listenerIndex(MA_LISTENER_INDEX_CLOSEST)
+    , playing(false)
+    , paused(false)
+{
+    engine = AudioEngine::Instance().GetEngine();
+
+    if (source && source->IsInitialized()) {
+        procedural = source;
+        InitVoice(procedural->GetDataSource());
+    }
+    if (!loaded) {
+        procedural.reset();
+    }
+}
+
+void Sound::InitVoice(ma_data_source* source) {
+    // Pitch and rate conversion happen in the resampler, so the voice's own pitch stage is off
+    ma_result result = MA_ERROR;
+    if (source) {
+        resampler = std::make_unique<ResamplingSource>(source, ma_engine_get_sample_rate(engine));
+        if (resampler->IsInitialized()) {
+            result = ma_sound_init_from_data_source(engine, resampler->GetDataSource(), MA_SOUND_FLAG_NO_PITCH,
+                AudioEngine::Instance().GetCategoryGroup(category), &sound);
+        }
+        else {
+            resampler.reset();
+            result = ma_sound_init_from_data_source(engine, source, 0,
+                AudioEngine::Instance().GetCategoryGroup(category), &sound);
+        }
+    }
     loaded = (result == MA_SUCCESS);
 
-    if (loaded) {
+    if (!loaded) {
+        resampler.reset();
+    }
+    else {
+        // Doppler is worked out by the voice's spatializer but applied by the resampler
+        if (resampler) {
+            resampler->SetDopplerSource(&sound.engineNode.spatializer.dopplerPitch);
+        }
+        UpdateResampler();
+
+        // Voice effects sit between the sound and its category bus
+        voiceEffects.Connect(&sound, AudioEngine::Instance().GetCategoryGroup(category));
+        attenuationModel = ma_sound_get_attenuation_model(&sound);
+        UpdateSpatializer();
+        UpdateAttenuation();
+
         // Register with the audio engine
         AudioEngine::Instance().RegisterSound(this);
     }
@@ -25,7 +144,17 @@ Sound::Sound(const std::string& filePath)
 Sound::~Sound() {
     if (loaded) {
         Stop(); // Ensure the sound is stopped
+        voiceEffects.Disconnect();
+        hrtfSpatializer.reset();
+        occlusionFilter.reset();
+        attenuationEffect.reset();
         ma_sound_uninit(&sound);
+        resampler.reset();
+        if (fileSource) {
+            ma_resource_manager_data_source_uninit(fileSource.get());
+        }
+        cachedSource.reset();
+        procedural.reset();
         AudioEngine::Instance().UnregisterSound(this);
     }
 }
@@ -33,6 +162,18 @@ Sound::~Sound() {
 bool Sound::Play() {
     if (!loaded) return false;
 
+    // Finished sounds drop out of the engine's list, so rejoin it and pick up
+    // category changes made in the meantime
+    AudioEngine::Instance().RegisterSound(this);
+    UpdateSpatializer();
+    UpdateAttenuation();
+    UpdateResampler();
+
+    // Pins the cached PCM, or opens a stream if it was evicted
+    if (cachedSource) {
+        cachedSource->BeginPlayback();
+    }
+
     ma_result result = ma_sound_start(&sound);
     if (result == MA_SUCCESS) {
         playing = true;
@@ -49,6 +190,10 @@ void Sound::Stop() {
     ma_sound_seek_to_pcm_frame(&sound, 0); // Reset position
     playing = false;
     paused = false;
+
+    if (cachedSource) {
+        cachedSource->EndPlayback();
+    }
 }
 
 void Sound::Pause() {
@@ -79,13 +224,27 @@ void Sound::SetPitch(float pitch) {
 
     // Clamp pitch to reasonable values
     pitch = std::max(0.5f, std::min(pitch, 2.0f));
-    ma_sound_set_pitch(&sound, pitch);
+    if (resampler) {
+        resampler->SetPitch(pitch);
+    }
+    else {
+        ma_sound_set_pitch(&sound, pitch);
+    }
 }
 
 float Sound::GetPitch() const {
     if (!loaded) return 1.0f;
 
-    return ma_sound_get_pitch(&sound);
+    return resampler ? resampler->GetPitch() : ma_sound_get_pitch(&sound);
+}
+
+void Sound::SetResamplerQuality(ResamplerQuality quality) {
+    resamplerQuality = quality;
+    UpdateResampler();
+}
+
+ResamplerQuality Sound::GetResamplerQuality() const {
+    return resamplerQuality;
 }
 
 void Sound::SetPan(float pan) {
@@ -126,19 +285,99 @@ void Sound::SetVelocity(float x, float y, float z) {
     ma_sound_set_velocity(&sound, x, y, z);
 }
 
+void Sound::SetListener(ma_uint32 index) {
+    if (index != MA_LISTENER_INDEX_CLOSEST && index >= ma_engine_get_listener_count(engine)) return;
+
+    listenerIndex = index;
+    if (!loaded) return;
+
+    // Automatic sounds are re-pinned by the engine's next Update()
+    ma_sound_set_pinned_listener_index(&sound, listenerIndex);
+}
+
+ma_uint32 Sound::GetListener() const {
+    return listenerIndex;
+}
+
 void Sound::SetAttenuationRange(float minDistance, float maxDistance) {
     if (!loaded) return;
 
-    ma_sound_set_spatialization_enabled(&sound, MA_TRUE);
-    ma_sound_set_attenuation_model(&sound, ma_attenuation_model_linear);
+    // The HRTF spatializer takes over from the panner but reads the same settings
+    if (hrtfSpatializer) {
+        spatializationEnabled = true;
+    }
+    else {
+        ma_sound_set_spatialization_enabled(&sound, MA_TRUE);
+    }
+    attenuationModel = ma_attenuation_model_linear;
     ma_sound_set_min_distance(&sound, minDistance);
     ma_sound_set_max_distance(&sound, maxDistance);
 
-    if (ma_sound_is_spatialization_enabled(&sound)) {
-        std::cout << "Spatialization enabled\n";
+    // A curve, if any, keeps owning the falloff
+    if (!attenuationEffect) {
+        ma_sound_set_attenuation_model(&sound, attenuationModel);
     }
 }
 
+void Sound::SetAttenuationCurve(std::shared_ptr<const AttenuationCurve> curve) {
+    attenuationCurve = curve;
+    UpdateAttenuation();
+}
+
+std::shared_ptr<const AttenuationCurve> Sound::GetAttenuationCurve() const {
+    return attenuationCurve;
+}
+
+void Sound::SetSpatializationMode(SpatializationMode mode) {
+    spatializationMode = mode;
+    UpdateSpatializer();
+}
+
+SpatializationMode Sound::GetSpatializationMode() const {
+    return spatializationMode;
+}
+
+bool Sound::IsUsingHrtf() const {
+    return hrtfSpatializer != nullptr;
+}
+
+void Sound::SetOcclusion(float occlusionAmount, float obstructionAmount) {
+    occlusion = std::max(0.0f, std::min(occlusionAmount, 1.0f));
+    obstruction = std::max(0.0f, std::min(obstructionAmount, 1.0f));
+    if (!loaded) return;
+
+    // Unoccluded sounds don't pay for the filter until they first need it
+    if (!occlusionFilter) {
+        if (occlusion == 0.0f && obstruction == 0.0f) return;
+
+        auto filter = std::make_shared<OcclusionEffect>(AudioEngine::Instance().GetOcclusionSettings());
+        filter->SetOcclusion(occlusion);
+        filter->SetObstruction(obstruction);
+        if (!voiceEffects.AddEffect(filter)) return;
+        occlusionFilter = filter;
+        return;
+    }
+
+    occlusionFilter->SetOcclusion(occlusion);
+    occlusionFilter->SetObstruction(obstruction);
+}
+
+float Sound::GetOcclusion() const {
+    return occlusion;
+}
+
+float Sound::GetObstruction() const {
+    return obstruction;
+}
+
+ma_uint64 Sound::GetId() const {
+    return id;
+}
+
+EffectChain& Sound::GetVoiceEffects() {
+    return voiceEffects;
+}
+
 bool Sound::IsPlaying() {
     if (!loaded) return false;
 
@@ -151,6 +390,9 @@ bool Sound::IsPlaying() {
     if (isPlaying == MA_FALSE && playing) {
         // Sound has finished playing
         playing = false;
+        if (cachedSource) {
+            cachedSource->EndPlayback();
+        }
         if (finishedCallback) {
             finishedCallback();
         }
@@ -167,6 +409,10 @@ bool Sound::IsLoaded() const {
     return loaded;
 }
 
+LoadPolicy Sound::GetLoadPolicy() const {
+    return loadPolicy;
+}
+
 float Sound::GetDuration() const {
     if (!loaded) return 0.0f;
 
@@ -199,6 +445,18 @@ void Sound::SetPlaybackPosition(float positionInSeconds) {
 
 void Sound::SetCategory(AudioCategory cat) {
     category = cat;
+
+    // Route the voice chain into the category's bus
+    if (loaded) {
+        ma_sound_group* group = AudioEngine::Instance().GetCategoryGroup(category);
+        if (group) {
+            voiceEffects.SetDestination(group);
+        }
+    }
+
+    UpdateSpatializer();
+    UpdateAttenuation();
+    UpdateResampler();
     UpdateVolume();
 }
 
@@ -206,11 +464,30 @@ AudioCategory Sound::GetCategory() const {
     return category;
 }
 
+void Sound::SetLoudness(float lufs) {
+    loudness = lufs;
+    hasLoudness = true;
+    UpdateVolume();
+}
+
+float Sound::GetLoudness() const {
+    return loudness;
+}
+
+bool Sound::HasLoudness() const {
+    return hasLoudness;
+}
+
 void Sound::UpdateVolume() {
     if (!loaded) return;
 
     float effectiveVolume = volume;
 
+    // Apply loudness normalization
+    if (hasLoudness) {
+        effectiveVolume *= AudioEngine::Instance().GetLoudnessGain(loudness);
+    }
+
     // Apply category volume
     effectiveVolume *= AudioEngine::Instance().GetCategoryVolume(category);
 
@@ -224,4 +501,77 @@ void Sound::UpdateVolume() {
 
 void Sound::SetFinishedCallback(std::function<void()> callback) {
     finishedCallback = callback;
+}
+
+void Sound::UpdateResampler() {
+    if (!resampler) return;
+
+    ResamplerQuality quality = resamplerQuality;
+    if (quality == ResamplerQuality::Default) {
+        quality = AudioEngine::Instance().GetCategoryResamplerQuality(category);
+    }
+    resampler->SetQuality(quality);
+}
+
+void Sound::UpdateSpatializer() {
+    if (!loaded) return;
+
+    SpatializationMode mode = spatializationMode;
+    if (mode == SpatializationMode::Default) {
+        mode = AudioEngine::Instance().GetCategorySpatialization(category);
+    }
+
+    bool useHrtf = (mode == SpatializationMode::Hrtf);
+    if (useHrtf == (hrtfSpatializer != nullptr)) return;
+
+    if (useHrtf) {
+        std::shared_ptr<HrtfDataset> dataset = AudioEngine::Instance().GetHrtfDataset();
+        if (!dataset) return;
+
+        // First in the chain so voice effects see the binaural signal
+        auto spatializer = std::make_shared<HrtfSpatializer>(dataset, &sound);
+        if (!voiceEffects.InsertEffect(0, spatializer)) return;
+
+        hrtfSpatializer = spatializer;
+        spatializationEnabled = ma_sound_is_spatialization_enabled(&sound) == MA_TRUE;
+        ma_sound_set_spatialization_enabled(&sound, MA_FALSE);
+    }
+    else {
+        voiceEffects.RemoveEffect(hrtfSpatializer);
+        hrtfSpatializer.reset();
+
+        // Back to whatever the sound had before, so 2D sounds stay 2D
+        ma_sound_set_spatialization_enabled(&sound, spatializationEnabled ? MA_TRUE : MA_FALSE);
+    }
+}
+
+void Sound::UpdateAttenuation() {
+    if (!loaded) return;
+
+    std::shared_ptr<const AttenuationCurve> curve = attenuationCurve;
+    if (!curve) {
+        curve = AudioEngine::Instance().GetCategoryAttenuationCurve(category);
+    }
+
+    if (attenuationEffect ? attenuationEffect->GetCurve() == curve : !curve) return;
+
+    if (attenuationEffect && curve) {
+        // Swapped inside the node, so there is never a block with both curves or neither
+        attenuationEffect->SetCurve(curve);
+        return;
+    }
+
+    if (attenuationEffect) {
+        voiceEffects.RemoveEffect(attenuationEffect);
+        attenuationEffect.reset();
+    }
+    else {
+        auto effect = std::make_shared<AttenuationEffect>(curve, &sound);
+        if (voiceEffects.AddEffect(effect)) {
+            attenuationEffect = effect;
+        }
+    }
+
+    // Either the curve or miniaudio's model, never both
+    ma_sound_set_attenuation_model(&sound, attenuationEffect ? ma_attenuation_model_none : attenuationModel);
 }
\ No newline at end of file
@@ -2,9 +2,18 @@
 
 #include <iostream>
 #include "AudioEngine.h"
+#include "EffectChain.h"
 #include <algorithm>
 #include <string>
 #include <functional>
+#include <memory>
+
+class HrtfSpatializer;
+class AttenuationCurve;
+class AttenuationEffect;
+class CachedSoundSource;
+class ResamplingSource;
+class ProceduralSource;
 
 // On Windows, prevent macros from colliding
 #ifdef max
@@ -17,7 +26,11 @@
 // Sound class for managing individual sound effects
 class Sound {
 public:
-    Sound(const std::string& filePath);
+    Sound(const std::string& filePath, LoadPolicy policy = LoadPolicy::Auto);
+
+    // Synthesized sound; name stands in for the file path. Endless sources play
+    // until stopped, finite ones end (or loop) like a file would.
+    Sound(const std::string& name, std::shared_ptr<ProceduralSource> source);
     virtual ~Sound();
 
     // Basic operations
@@ -33,6 +46,11 @@ public:
     // Playback control
     void SetPitch(float pitch);
     float GetPitch() const;
+
+    // Linear or windowed-sinc interpolation for pitch and rate conversion; Default
+    // follows the category setting
+    void SetResamplerQuality(ResamplerQuality quality);
+    ResamplerQuality GetResamplerQuality() const;
     void SetPan(float pan); // -1.0 (left) to 1.0 (right)
     float GetPan() const;
 
@@ -44,14 +62,44 @@ public:
     void SetPosition(float x, float y, float z = 0.0f);
     void SetVelocity(float x, float y, float z = 0.0f);
 
+    // Listener this sound is heard through, e.g. a player's own footsteps in
+    // split-screen. MA_LISTENER_INDEX_CLOSEST (the default) follows the nearest one.
+    void SetListener(ma_uint32 listenerIndex);
+    ma_uint32 GetListener() const;
+
     // Set the min/max distance for attenuation
     void SetAttenuationRange(float minDistance, float maxDistance);
 
+    // Custom distance falloff, replacing the attenuation model and range above.
+    // nullptr falls back to the category's curve, if any.
+    void SetAttenuationCurve(std::shared_ptr<const AttenuationCurve> curve);
+    std::shared_ptr<const AttenuationCurve> GetAttenuationCurve() const;
+
+    // Panner or HRTF; Default follows the category setting
+    void SetSpatializationMode(SpatializationMode mode);
+    SpatializationMode GetSpatializationMode() const;
+    bool IsUsingHrtf() const;
+
+    // Occlusion (wall in the way) and obstruction (direct path blocked), 0.0 to 1.0.
+    // Usually driven by AudioEngine::SetOcclusionCallback rather than set by hand.
+    void SetOcclusion(float occlusion, float obstruction = 0.0f);
+    float GetOcclusion() const;
+    float GetObstruction() const;
+
+    // Unique for the life of the process; unlike the address, never reused
+    ma_uint64 GetId() const;
+
+    // Insert effects applied to this sound only, before its category bus
+    EffectChain& GetVoiceEffects();
+
     // Status checks
     bool IsPlaying();
     bool IsPaused() const;
     bool IsLoaded() const;
 
+    // How the audio data is held; never Auto once loaded
+    LoadPolicy GetLoadPolicy() const;
+
     // Get the duration of the sound in seconds
     float GetDuration() const;
 
@@ -65,23 +113,57 @@ public:
     void SetCategory(AudioCategory category);
     AudioCategory GetCategory() const;
 
+    // Measured integrated loudness in LUFS, used by loudness normalization
+    void SetLoudness(float lufs);
+    float GetLoudness() const;
+    bool HasLoudness() const;
+
     // Called when the audio engine changes volumes
     void UpdateVolume();
 
+    // Called when the audio engine changes spatialization, attenuation or resampler settings
+    void UpdateSpatializer();
+    void UpdateAttenuation();
+    void UpdateResampler();
+
     // Set a callback to be called when the sound finishes playing
     void SetFinishedCallback(std::function<void()> callback);
 
 private:
     friend class AudioEngine;
 
+    // Wraps the source in the resampler and joins the category bus; sets loaded
+    void InitVoice(ma_data_source* source);
+
     ma_sound sound;
+    ma_uint64 id;
+    std::unique_ptr<CachedSoundSource> cachedSource;   // Null when loaded straight from the file
+    std::unique_ptr<ma_resource_manager_data_source> fileSource;   // Otherwise this is
+    std::shared_ptr<ProceduralSource> procedural;      // Or, for synthesized sounds, this
+    std::unique_ptr<ResamplingSource> resampler;       // Reads one of the above
     ma_engine* engine;
     std::string filePath;
+    LoadPolicy loadPolicy;
     bool loaded;
     float volume;
+    float loudness;
+    bool hasLoudness;
     AudioCategory category;
+    ResamplerQuality resamplerQuality;
     std::function<void()> finishedCallback;
 
+    EffectChain voiceEffects;
+    SpatializationMode spatializationMode;
+    std::shared_ptr<HrtfSpatializer> hrtfSpatializer;
+    bool spatializationEnabled;                // miniaudio's panner, restored when the HRTF node goes
+    std::shared_ptr<OcclusionEffect> occlusionFilter;
+    std::shared_ptr<const AttenuationCurve> attenuationCurve;
+    std::shared_ptr<AttenuationEffect> attenuationEffect;
+    ma_attenuation_model attenuationModel;     // Restored when no curve applies
+    float occlusion;
+    float obstruction;
+    ma_uint32 listenerIndex;    // Requested; the pinned index is kept by AudioEngine when automatic
+
     // Internal state tracking
     bool playing;
     bool paused;
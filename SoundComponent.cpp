@@ -24,24 +24,37 @@ SoundComponent::~SoundComponent() {
     StopAllMusic();
 }
 
-void SoundComponent::AddSound(const std::string& name, const std::string& filePath, AudioCategory category) {
+void SoundComponent::AddSound(const std::string& name, const std::string& filePath, AudioCategory category, LoadPolicy policy) {
     // Load the sound through the audio engine
-    std::shared_ptr<Sound> sound = AudioEngine::Instance().LoadSound(filePath);
+    std::shared_ptr<Sound> sound = AudioEngine::Instance().LoadSound(filePath, policy);
     if (sound) {
         sound->SetCategory(category);
         sounds[name] = sound;
     }
 }
 
-void SoundComponent::AddMusic(const std::string& name, const std::string& filePath, AudioCategory category) {
+void SoundComponent::AddSound(const std::string& name, std::shared_ptr<ProceduralSource> source, AudioCategory category) {
+    std::shared_ptr<Sound> sound = AudioEngine::Instance().CreateSound(name, source);
+    if (sound) {
+        sound->SetCategory(category);
+        sounds[name] = sound;
+    }
+}
+
+void SoundComponent::AddMusic(const std::string& name, const std::string& filePath, AudioCategory category, LoadPolicy policy) {
     // Load the music through the audio engine
-    std::shared_ptr<Music> musicTrack = AudioEngine::Instance().LoadMusic(filePath);
+    std::shared_ptr<Music> musicTrack = AudioEngine::Instance().LoadMusic(filePath, policy);
     if (musicTrack) {
         musicTrack->SetCategory(category);
         music[name] = musicTrack;
     }
 }
 
+void SoundComponent::RemoveSound(const std::string& name) {
+    // The sound is unloaded once nothing else holds it
+    sounds.erase(name);
+}
+
 bool SoundComponent::PlaySound(const std::string& name, bool loop) {
     auto it = sounds.find(name);
     if (it != sounds.end()) {
@@ -22,8 +22,12 @@ public:
     ~SoundComponent();
 
     // Load sounds and music
-    static void AddSound(const std::string& name, const std::string& filePath, AudioCategory category = AudioCategory::SFX);
-    static void AddMusic(const std::string& name, const std::string& filePath, AudioCategory category = AudioCategory::MUSIC);
+    static void AddSound(const std::string& name, const std::string& filePath, AudioCategory category = AudioCategory::SFX,
+        LoadPolicy policy = LoadPolicy::Auto);
+    static void AddSound(const std::string& name, std::shared_ptr<ProceduralSource> source, AudioCategory category = AudioCategory::SFX);
+    static void AddMusic(const std::string& name, const std::string& filePath, AudioCategory category = AudioCategory::MUSIC,
+        LoadPolicy policy = LoadPolicy::Stream);
+    static void RemoveSound(const std::string& name);
 
     // Play sounds
     bool PlaySound(const std::string& name, bool loop = false);
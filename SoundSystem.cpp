@@ -1,20 +1,30 @@
 #include "SoundSystem.h"
 
-SoundSystem::SoundSystem()
+SoundSystem::SoundSystem(const AudioEngineConfig& config)
 {
-    Initialize();
+    Initialize(config);
 }
 
 SoundSystem::~SoundSystem()
 {
+    jobsRunning = false;
+    if (jobThread.joinable()) {
+        jobThread.join();
+    }
     AudioEngine::Instance().Shutdown();
 }
 
-void SoundSystem::Initialize()
+void SoundSystem::Initialize(const AudioEngineConfig& config)
 {
-    if (!AudioEngine::Instance().Initialize()) {
+    if (!AudioEngine::Instance().Initialize(config)) {
         std::cerr << "Failed to initialize audio!\n";
         // handle error...
+        return;
+    }
+
+    if (AudioEngine::Instance().IsHostingResourceJobs() && !jobThread.joinable()) {
+        jobsRunning = true;
+        jobThread = std::thread(&SoundSystem::JobLoop, this);
     }
 }
 
@@ -22,3 +32,13 @@ void SoundSystem::Update()
 {
     AudioEngine::Instance().Update(0.016);
 }
+
+void SoundSystem::JobLoop()
+{
+    // Games with a job system should call ProcessJobs() from there instead
+    while (jobsRunning) {
+        if (AudioEngine::Instance().ProcessJobs() == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
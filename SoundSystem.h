@@ -2,15 +2,26 @@
 
 #include "AudioEngine.h"
 #include "SoundComponent.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
 
 class SoundSystem
 {
 public:
-	SoundSystem();
+	explicit SoundSystem(const AudioEngineConfig& config = AudioEngineConfig());
 	~SoundSystem();
 
-	void Initialize();
+	void Initialize(const AudioEngineConfig& config = AudioEngineConfig());
 
 	void Update();
+
+private:
+	// Stands in for a game job system when the engine hosts resource jobs: streams
+	// block on ProcessJobs() while opening, so it can't run on the thread calling Update()
+	void JobLoop();
+
+	std::thread jobThread;
+	std::atomic<bool> jobsRunning{ false };
 };
 